@@ -0,0 +1,476 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional> // std::less
+#include <new>
+#include <utility> // std::pair
+
+/*
+    B-tree with the same interface as BinarySearchTree so code templated
+    on the container can swap one for the other:
+
+        template <typename Tree> void load( Tree & t );
+        load( BinarySearchTree<int, int>{} );
+        load( BTree<int, int>{} );
+
+    Every node stores up to MAX_KEYS pairs contiguously in a block sized
+    to NodeBytes (a multiple of the 64-byte cache line), so a lookup
+    touches one or two lines per level instead of one line per key.
+    Internal nodes append their child pointers after the key block.
+*/
+template <typename K, typename V, typename Comparator = std::less<K>, size_t NodeBytes = 128>
+class BTree
+{
+  public:
+    using key_type        = K;
+    using value_type      = V;
+    using key_compare     = Comparator;
+    using pair            = std::pair<key_type, value_type>;
+    using pointer         = pair*;
+    using const_pointer   = const pair*;
+    using reference       = pair&;
+    using const_reference = const pair&;
+    using difference_type = ptrdiff_t;
+    using size_type       = size_t;
+
+    static constexpr size_type CACHE_LINE = 64;
+    static_assert(NodeBytes % CACHE_LINE == 0, "NodeBytes must be a multiple of the cache line");
+
+  private:
+    static constexpr size_type HEADER = std::max(alignof(pair), sizeof(uint32_t));
+    static constexpr size_type FIT = (NodeBytes - HEADER) / sizeof(pair);
+
+  public:
+    // Keys per node: as many as fit in NodeBytes, rounded down to an odd
+    // count so a full node splits evenly, and never fewer than three
+    static constexpr size_type MAX_KEYS = FIT < 3 ? 3 : (FIT % 2 ? FIT : FIT - 1);
+    // Every node except the root holds at least MIN_KEYS keys
+    static constexpr size_type MIN_KEYS = MAX_KEYS / 2;
+
+  private:
+    // Nodes are at least half full, so even a tree of SIZE_MAX keys is
+    // shorter than this
+    static constexpr size_type MAX_HEIGHT = 64;
+
+    struct alignas(CACHE_LINE) LeafNode
+    {
+        uint16_t count;
+        bool leaf;
+        alignas(pair) unsigned char slots[MAX_KEYS * sizeof(pair)];
+
+        explicit LeafNode( bool is_leaf = true ) : count{ 0 }, leaf{ is_leaf } { }
+    };
+
+    struct InternalNode : LeafNode
+    {
+        LeafNode *children[MAX_KEYS + 1];
+
+        InternalNode() : LeafNode{ false } { }
+    };
+
+    using node_ptr       = LeafNode*;
+    using const_node_ptr = const LeafNode*;
+
+    node_ptr _root;
+    size_type _size;
+    key_compare comp;
+
+  public:
+    BTree() : _root{nullptr}, _size{0}, comp{} { }
+
+    BTree( const BTree & rhs ) : _root{clone(rhs._root)}, _size{rhs._size}, comp{rhs.comp} { }
+
+    BTree( BTree && rhs ) : _root{rhs._root}, _size{rhs._size}, comp{rhs.comp} {
+        rhs._root = nullptr;
+        rhs._size = 0;
+    }
+
+    ~BTree() {
+        clear();
+    }
+
+    BTree & operator=( const BTree & rhs ) {
+        if (&rhs == this) return *this;
+        clear();
+        _root = clone(rhs._root);
+        _size = rhs._size;
+        return *this;
+    }
+
+    BTree & operator=( BTree && rhs ) {
+        if (&rhs == this) return *this;
+        clear();
+        _root = rhs._root;
+        _size = rhs._size;
+        rhs._root = nullptr;
+        rhs._size = 0;
+        return *this;
+    }
+
+    const_reference min() const {
+        const_node_ptr t = _root;
+        while (!t->leaf)
+            t = child(t, 0);
+        return *slot(t, 0);
+    }
+    const_reference max() const {
+        const_node_ptr t = _root;
+        while (!t->leaf)
+            t = child(t, t->count);
+        return *slot(t, t->count - 1);
+    }
+
+    bool contains( const key_type & x ) const { return find_slot( x ) != nullptr; }
+    value_type & find( const key_type & key ) { return const_cast<pointer>(find_slot( key ))->second; }
+    const value_type & find( const key_type & key ) const { return find_slot( key )->second; }
+
+    bool empty() const {
+        return _size == 0;
+    }
+    size_type size() const {
+        return _size;
+    }
+    // Number of nodes on every root-to-leaf path
+    size_type height() const {
+        size_type h = 0;
+        for (const_node_ptr t = _root; t != nullptr; t = t->leaf ? nullptr : child(t, 0))
+            h++;
+        return h;
+    }
+
+    void clear() {
+        clear( _root );
+        _root = nullptr;
+        _size = 0;
+    }
+
+    void insert( const_reference x ) { insert_pair( x ); }
+    void insert( pair && x ) { insert_pair( std::move( x ) ); }
+    void erase( const key_type & x );
+
+  private:
+    static pointer slot( node_ptr t, size_type i ) {
+        return std::launder(reinterpret_cast<pointer>(t->slots)) + i;
+    }
+    static const_pointer slot( const_node_ptr t, size_type i ) {
+        return std::launder(reinterpret_cast<const_pointer>(t->slots)) + i;
+    }
+    static node_ptr & child( node_ptr t, size_type i ) {
+        return static_cast<InternalNode *>(t)->children[i];
+    }
+    static const_node_ptr child( const_node_ptr t, size_type i ) {
+        return static_cast<const InternalNode *>(t)->children[i];
+    }
+
+    static node_ptr make_node( bool leaf ) {
+        if (leaf)
+            return new LeafNode;
+        return new InternalNode;
+    }
+    static void free_node( node_ptr t ) {
+        for (size_type i = 0; i < t->count; i++)
+            slot(t, i)->~pair();
+        if (t->leaf)
+            delete t;
+        else
+            delete static_cast<InternalNode *>(t);
+    }
+
+    // Moves the pair in src into the uninitialized slot dst
+    static void relocate( pointer dst, pointer src ) {
+        new (dst) pair(std::move(*src));
+        src->~pair();
+    }
+
+    // Index of the first key in t which is not less than key. Nodes are
+    // only a few lines long, so counting the smaller keys without early
+    // exit beats binary search: there are no mispredicted branches and
+    // every line of the node is requested at once.
+    size_type search( const_node_ptr t, const key_type & key ) const {
+        const_pointer slots = slot(t, 0);
+        size_type lo = 0;
+        for (size_type i = 0; i < t->count; i++)
+            lo += comp(slots[i].first, key);
+        return lo;
+    }
+
+    bool matches( const_node_ptr t, size_type i, const key_type & key ) const {
+        return i < t->count && !comp(key, slot(t, i)->first);
+    }
+
+    const_pointer find_slot( const key_type & key ) const {
+        const_node_ptr t = _root;
+        while (t != nullptr) {
+            size_type i = search(t, key);
+            if (matches(t, i, key))
+                return slot(t, i);
+            t = t->leaf ? nullptr : child(t, i);
+        }
+        return nullptr;
+    }
+
+    // Inserts x before position i of a node with room, with right (if
+    // internal) becoming the child after it
+    static void insert_at( node_ptr t, size_type i, pair && x, node_ptr right ) {
+        for (size_type j = t->count; j > i; j--)
+            relocate(slot(t, j), slot(t, j - 1));
+        new (slot(t, i)) pair(std::move(x));
+
+        if (!t->leaf) {
+            for (size_type j = t->count + 1; j > i + 1; j--)
+                child(t, j) = child(t, j - 1);
+            child(t, i + 1) = right;
+        }
+        t->count++;
+    }
+
+    // Removes the pair (and the child after it) at position i
+    static void remove_at( node_ptr t, size_type i ) {
+        slot(t, i)->~pair();
+        for (size_type j = i; j + 1 < t->count; j++)
+            relocate(slot(t, j), slot(t, j + 1));
+
+        if (!t->leaf) {
+            for (size_type j = i + 1; j < t->count; j++)
+                child(t, j) = child(t, j + 1);
+        }
+        t->count--;
+    }
+
+    // Moves the keys [from, to) of src to dst starting at position at
+    static void move_keys( node_ptr src, size_type from, size_type to, node_ptr dst, size_type at ) {
+        for (size_type j = from; j < to; j++)
+            relocate(slot(dst, at++), slot(src, j));
+    }
+    static void move_children( node_ptr src, size_type from, size_type to, node_ptr dst, size_type at ) {
+        for (size_type j = from; j < to; j++)
+            child(dst, at++) = child(src, j);
+    }
+
+    static pair take( node_ptr t, size_type i ) {
+        pair p = std::move(*slot(t, i));
+        slot(t, i)->~pair();
+        return p;
+    }
+
+    /*
+        Inserting carry (with carry_right after it) at position i of the
+        full node t. The node is split around the median of its MAX_KEYS
+        keys plus carry: the lower half stays in t, the upper half moves
+        to a new sibling, and on return carry / carry_right hold the
+        median and the sibling to insert into the parent.
+    */
+    static void split_insert( node_ptr t, size_type i, pair & carry, node_ptr & carry_right ) {
+        constexpr size_type half = (MAX_KEYS + 1) / 2;
+        node_ptr r = make_node(t->leaf);
+
+        if (i < half) {
+            move_keys(t, half, MAX_KEYS, r, 0);
+            if (!t->leaf)
+                move_children(t, half, MAX_KEYS + 1, r, 0);
+            r->count = MAX_KEYS - half;
+            pair median = take(t, half - 1);
+            t->count = half - 1;
+            insert_at(t, i, std::move(carry), carry_right);
+            carry = std::move(median);
+        } else if (i == half) {
+            move_keys(t, half, MAX_KEYS, r, 0);
+            if (!t->leaf) {
+                child(r, 0) = carry_right;
+                move_children(t, half + 1, MAX_KEYS + 1, r, 1);
+            }
+            r->count = MAX_KEYS - half;
+            t->count = half;
+        } else {
+            move_keys(t, half + 1, MAX_KEYS, r, 0);
+            if (!t->leaf)
+                move_children(t, half + 1, MAX_KEYS + 1, r, 0);
+            r->count = MAX_KEYS - half - 1;
+            pair median = take(t, half);
+            t->count = half;
+            insert_at(r, i - half - 1, std::move(carry), carry_right);
+            carry = std::move(median);
+        }
+
+        carry_right = r;
+    }
+
+    template <typename P>
+    void insert_pair( P && x ) {
+        node_ptr nodes[MAX_HEIGHT];
+        size_type index[MAX_HEIGHT];
+        size_type depth = 0;
+
+        for (node_ptr t = _root; t != nullptr; t = t->leaf ? nullptr : child(t, index[depth - 1])) {
+            size_type i = search(t, x.first);
+            if (matches(t, i, x.first)) {
+                slot(t, i)->second = std::forward<P>(x).second;
+                return;
+            }
+            nodes[depth] = t;
+            index[depth++] = i;
+        }
+
+        pair carry { std::forward<P>(x) };
+        node_ptr carry_right = nullptr;
+        _size++;
+
+        // Split full nodes from the leaf upwards until one has room
+        while (depth-- > 0) {
+            node_ptr t = nodes[depth];
+            if (t->count < MAX_KEYS) {
+                insert_at(t, index[depth], std::move(carry), carry_right);
+                return;
+            }
+            split_insert(t, index[depth], carry, carry_right);
+        }
+
+        node_ptr root = make_node(_root == nullptr);
+        new (slot(root, 0)) pair(std::move(carry));
+        root->count = 1;
+        if (!root->leaf) {
+            child(root, 0) = _root;
+            child(root, 1) = carry_right;
+        }
+        _root = root;
+    }
+
+    // Merges the children on either side of key k of t, pulling the key
+    // down between them
+    static void merge( node_ptr t, size_type k ) {
+        node_ptr left = child(t, k);
+        node_ptr right = child(t, k + 1);
+
+        relocate(slot(left, left->count), slot(t, k));
+        move_keys(right, 0, right->count, left, left->count + 1);
+        if (!left->leaf)
+            move_children(right, 0, right->count + 1, left, left->count + 1);
+        left->count += right->count + 1;
+        right->count = 0;
+        free_node(right);
+
+        for (size_type j = k; j + 1 < t->count; j++)
+            relocate(slot(t, j), slot(t, j + 1));
+        for (size_type j = k + 1; j < t->count; j++)
+            child(t, j) = child(t, j + 1);
+        t->count--;
+    }
+
+    // Refills the underfull child i of t from a sibling, merging the two
+    // when neither sibling can spare a key. Returns true on a merge since
+    // t then lost a key itself.
+    static bool refill( node_ptr t, size_type i ) {
+        node_ptr c = child(t, i);
+
+        if (i > 0 && child(t, i - 1)->count > MIN_KEYS) {
+            node_ptr left = child(t, i - 1);
+            for (size_type j = c->count; j > 0; j--)
+                relocate(slot(c, j), slot(c, j - 1));
+            relocate(slot(c, 0), slot(t, i - 1));
+            relocate(slot(t, i - 1), slot(left, left->count - 1));
+            if (!c->leaf) {
+                for (size_type j = c->count + 1; j > 0; j--)
+                    child(c, j) = child(c, j - 1);
+                child(c, 0) = child(left, left->count);
+            }
+            c->count++;
+            left->count--;
+            return false;
+        }
+
+        if (i < t->count && child(t, i + 1)->count > MIN_KEYS) {
+            node_ptr right = child(t, i + 1);
+            relocate(slot(c, c->count), slot(t, i));
+            relocate(slot(t, i), slot(right, 0));
+            for (size_type j = 0; j + 1 < right->count; j++)
+                relocate(slot(right, j), slot(right, j + 1));
+            if (!c->leaf) {
+                child(c, c->count + 1) = child(right, 0);
+                for (size_type j = 0; j < right->count; j++)
+                    child(right, j) = child(right, j + 1);
+            }
+            c->count++;
+            right->count--;
+            return false;
+        }
+
+        merge(t, i > 0 ? i - 1 : i);
+        return true;
+    }
+
+    static void clear( node_ptr t ) {
+        if (t == nullptr)
+            return;
+        if (!t->leaf)
+            for (size_type i = 0; i <= t->count; i++)
+                clear(child(t, i));
+        free_node(t);
+    }
+
+    static node_ptr clone( const_node_ptr t ) {
+        if (t == nullptr)
+            return nullptr;
+
+        node_ptr c = make_node(t->leaf);
+        for (size_type i = 0; i < t->count; i++) {
+            new (slot(c, i)) pair(*slot(t, i));
+            c->count++;
+        }
+        if (!t->leaf)
+            for (size_type i = 0; i <= t->count; i++)
+                child(c, i) = clone(child(t, i));
+        return c;
+    }
+};
+
+template <typename K, typename V, typename Comparator, size_t NodeBytes>
+void BTree<K, V, Comparator, NodeBytes>::erase( const key_type & x ) {
+    node_ptr nodes[MAX_HEIGHT];
+    size_type index[MAX_HEIGHT];
+    size_type depth = 0;
+
+    node_ptr t = _root;
+    size_type i = 0;
+    while (true) {
+        if (t == nullptr)
+            return;
+        i = search(t, x);
+        nodes[depth] = t;
+        index[depth++] = i;
+        if (matches(t, i, x))
+            break;
+        t = t->leaf ? nullptr : child(t, i);
+    }
+
+    // A key in an internal node trades places with its predecessor, the
+    // last key of the rightmost leaf in the subtree to its left
+    if (!t->leaf) {
+        node_ptr leaf = child(t, i);
+        while (!leaf->leaf) {
+            nodes[depth] = leaf;
+            index[depth++] = leaf->count;
+            leaf = child(leaf, leaf->count);
+        }
+        nodes[depth] = leaf;
+        index[depth++] = leaf->count - 1;
+        std::swap(*slot(t, i), *slot(leaf, leaf->count - 1));
+        t = leaf;
+        i = leaf->count - 1;
+    }
+
+    remove_at(t, i);
+    _size--;
+
+    // Restore the minimum occupancy from the leaf upwards
+    for (size_type d = depth - 1; d > 0 && nodes[d]->count < MIN_KEYS; d--) {
+        if (!refill(nodes[d - 1], index[d - 1]))
+            break;
+    }
+
+    if (_root->count == 0) {
+        node_ptr old = _root;
+        _root = old->leaf ? nullptr : child(old, 0);
+        free_node(old);
+    }
+}
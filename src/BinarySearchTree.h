@@ -5,10 +5,237 @@
 #include <queue> // std::queue
 #include <utility> // std::pair
 #include <iostream> 
+#include <memory> // std::allocator_traits
+#include <memory_resource> // std::pmr
+#include "FrozenSearchTree.h"
+#include "StaticSearchTree.h"
+#include "NodePool.h"
+#include "PersistentSearchTree.h"
+#include "ConcurrentSearchTree.h"
+#include "ThreadPool.h" // parallel set algebra
 using std::cout, std::endl; 
 
-template <typename K, typename V, typename Comparator = std::less<K>>
-class BinarySearchTree
+// Test hook, called for every step down the right spine when the tree
+// looks for its largest node. Tests define it before the include to
+// count the steps; otherwise it does nothing.
+#ifndef BINARY_SEARCH_TREE_SPINE_STEP
+#define BINARY_SEARCH_TREE_SPINE_STEP()
+#endif
+
+// Balancing policies selectable through the fourth template parameter
+// of BinarySearchTree. Each policy decides what (if any) bookkeeping a
+// node carries and how insert and erase restore the shape of the tree.
+namespace balance {
+    // No rebalancing; the shape of the tree depends on insertion order.
+    struct none { };
+    // Red-black tree; the height never exceeds 2 * log2(n + 1).
+    struct red_black { };
+    // AVL tree; the height never exceeds 1.44 * log2(n + 2), so lookups
+    // make fewer comparisons than red-black at the cost of more
+    // rotations on update. Suited to read-heavy workloads.
+    struct avl { };
+    // Randomized treap; nodes are heap-ordered by random priorities drawn
+    // from the tree's splitmix64 generator, giving O(log n) expected
+    // height for any insertion order. Runs are reproducible from a seed.
+    struct treap { };
+    // Splay tree; every non-const access moves the node to the root, so
+    // recently used keys are found in a handful of comparisons and any
+    // sequence of operations costs O(log n) amortized. Const lookups
+    // take a non-splaying path and leave the shape untouched.
+    struct splay { };
+    // Scapegoat tree; nodes carry no bookkeeping at all. When an insert
+    // lands deeper than log_{3/2}(n) the unbalanced subtree above it is
+    // rebuilt into a perfectly balanced one, keeping the height
+    // O(log n) and updates O(log n) amortized.
+    struct scapegoat { };
+}
+
+// Per-node bookkeeping required by a balancing policy. Policies which
+// need nothing use the empty primary template so BinaryNode keeps its
+// plain layout.
+template <typename Balance>
+struct node_metadata { };
+
+template <>
+struct node_metadata<balance::red_black> {
+    bool red = true;
+};
+
+// Height of the subtree rooted at the node; the balance factor is the
+// difference of the children's heights. AVL heights stay below 100 for
+// any tree that fits in memory, so one byte suffices.
+template <>
+struct node_metadata<balance::avl> {
+    unsigned char height = 1;
+};
+
+template <>
+struct node_metadata<balance::treap> {
+    uint32_t priority = 0;
+};
+
+// Per-tree state required by a balancing policy. BinarySearchTree
+// inherits from it so policies which need nothing cost nothing.
+template <typename Balance>
+struct tree_metadata { };
+
+// Largest size reached since the whole tree was last rebuilt
+template <>
+struct tree_metadata<balance::scapegoat> {
+    size_t max_size = 0;
+};
+
+// Vigna's splitmix64: one word of state and a few multiplies per draw,
+// which is plenty for treap priorities
+class splitmix64
+{
+    uint64_t state;
+
+  public:
+    explicit splitmix64( uint64_t s ) : state{s} { }
+
+    void seed( uint64_t s ) { state = s; }
+
+    uint64_t operator()() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+template <>
+struct tree_metadata<balance::treap> {
+    static constexpr uint64_t default_seed = 0x12345678;
+    splitmix64 rng { default_seed };
+};
+
+// Optional per-node augmentations, selected through the seventh template
+// parameter of BinarySearchTree.
+namespace augment {
+    // Nothing beyond what the balancing policy needs.
+    struct none { };
+    // Every node counts the nodes in its subtree, which insert, erase
+    // and every rotation keep current. Enables rank, select, nth and
+    // count_range in time proportional to the height of the tree.
+    struct order_statistics { };
+}
+
+// Per-node fields required by an augmentation; empty (and so free, as a
+// base of BinaryNode) for augment::none
+template <typename Augment>
+struct node_augment { };
+
+template <>
+struct node_augment<augment::order_statistics> {
+    size_t count = 1;
+};
+
+// Whether the nodes of a tree with this balancing policy point at their
+// parents. The parent pointer makes iterator steps, hinted inserts and
+// batched updates O(1) amortized, at one pointer per node; without it
+// they search from the root, so an iterator step costs O(log n).
+// Scapegoat trees go without, so a node is its element and two child
+// pointers. Red-black and AVL trees may be specialized to
+// std::false_type as well; other policies keep the pointer, since the
+// traversals of a tree without one use a stack as deep as the height,
+// which only these policies bound. Order statistics update counts
+// through the parents, so augmented trees keep them regardless.
+template <typename Balance>
+struct parent_links : std::true_type { };
+
+template <>
+struct parent_links<balance::scapegoat> : std::false_type { };
+
+// The element and links of a node, with a parent pointer only where the
+// tree keeps one (see parent_links)
+template <typename Pair, typename Node, bool Linked>
+struct node_fields {
+    Pair element;
+    Node *left;
+    Node *right;
+    Node *parent = nullptr; // nullptr at the root
+};
+
+template <typename Pair, typename Node>
+struct node_fields<Pair, Node, false> {
+    Pair element;
+    Node *left;
+    Node *right;
+};
+
+// Where a tree gets the memory for its nodes, selected through the fifth
+// template parameter of BinarySearchTree.
+namespace storage {
+    // Every node is a separate new and delete.
+    struct heap { };
+    // Nodes are carved from slabs owned by the tree (see NodePool.h).
+    // Erased nodes are reused through a per-tree free list, and clear()
+    // frees whole slabs instead of one node at a time.
+    struct pool { };
+}
+
+template <typename Storage, typename Node, typename Allocator>
+class node_storage;
+
+// The allocator is a private base so the stateless std::allocator takes
+// no space
+template <typename Node, typename Allocator>
+class node_storage<storage::heap, Node, Allocator>
+  : private std::allocator_traits<Allocator>::template rebind_alloc<Node>
+{
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_traits    = std::allocator_traits<node_allocator>;
+
+    node_allocator & alloc() { return *this; }
+
+  public:
+    using allocator_type = Allocator;
+
+    node_storage() : node_storage(Allocator{}) { }
+    explicit node_storage( const Allocator & a ) : node_allocator(a) { }
+    node_storage( node_storage && rhs ) = default;
+
+    // Unless the allocator propagates on move assignment, the two
+    // allocators must compare equal
+    node_storage & operator=( node_storage && rhs ) {
+        if constexpr (node_traits::propagate_on_container_move_assignment::value)
+            alloc() = std::move(rhs.alloc());
+        return *this;
+    }
+
+    template <typename... Args>
+    Node * create( Args &&... args ) {
+        Node * n = node_traits::allocate(alloc(), 1);
+        try {
+            node_traits::construct(alloc(), n, std::forward<Args>(args)...);
+        } catch (...) {
+            node_traits::deallocate(alloc(), n, 1);
+            throw;
+        }
+        return n;
+    }
+    void destroy( Node * n ) {
+        node_traits::destroy(alloc(), n);
+        node_traits::deallocate(alloc(), n, 1);
+    }
+    void release() { }
+
+    allocator_type get_allocator() const { return allocator_type(static_cast<const node_allocator &>(*this)); }
+    // Replaces the allocator; no nodes may be outstanding
+    void set_allocator( const allocator_type & a ) { alloc() = node_allocator(a); }
+};
+
+template <typename Node, typename Allocator>
+class node_storage<storage::pool, Node, Allocator> : public NodePool<Node, Allocator> {
+  public:
+    using NodePool<Node, Allocator>::NodePool;
+};
+
+template <typename K, typename V, typename Comparator = std::less<K>, typename Balance = balance::none,
+          typename Storage = storage::heap, typename Allocator = std::allocator<std::pair<K, V>>,
+          typename Augment = augment::none>
+class BinarySearchTree : private tree_metadata<Balance>
 {
   public:
     using key_type        = K;
@@ -21,352 +248,3322 @@ class BinarySearchTree
     using const_reference = const pair&;
     using difference_type = ptrdiff_t;
     using size_type       = size_t;
+    using balance_policy  = Balance;
+    using storage_policy  = Storage;
+    using allocator_type  = Allocator;
+    using augment_policy  = Augment;
+
+    // Whether nodes point at their parents (see parent_links)
+    static constexpr bool parent_linked = parent_links<Balance>::value
+        || std::is_same_v<Augment, augment::order_statistics>;
+    static_assert(parent_linked || std::is_same_v<Balance, balance::red_black>
+                  || std::is_same_v<Balance, balance::avl> || std::is_same_v<Balance, balance::scapegoat>,
+                  "only policies that bound the height can go without parent links");
+
+  private:
+    struct BinaryNode : node_fields<pair, BinaryNode, parent_linked>, node_metadata<Balance>, node_augment<Augment>
+    {
+        using fields = node_fields<pair, BinaryNode, parent_linked>;
+
+        BinaryNode( const_reference theElement, BinaryNode *lt, BinaryNode *rt, BinaryNode *p = nullptr )
+          : fields{ theElement, lt, rt } { set_parent(this, p); }
+        
+        BinaryNode( pair && theElement, BinaryNode *lt, BinaryNode *rt, BinaryNode *p = nullptr )
+          : fields{ std::move( theElement ), lt, rt } { set_parent(this, p); }
+
+        // Builds the element from the arguments of one of pair's constructors
+        template <typename... Args>
+        explicit BinaryNode( std::in_place_t, Args &&... args )
+          : fields{ pair( std::forward<Args>( args )... ), nullptr, nullptr } { }
+    };
+
+    using node           = BinaryNode;
+    using node_ptr       = node*;
+    using const_node_ptr = const node*;
+
+    using metadata       = node_metadata<Balance>;
+    using augmentation   = node_augment<Augment>;
+
+    static constexpr bool ranked = std::is_same_v<Augment, augment::order_statistics>;
+    // Without parent links, inserts that cannot go through insert_path
+    // record the path of their search for the fixup. Unbalanced and
+    // splay trees have no such fixup.
+    static constexpr bool searches_paths = !parent_linked && !std::is_same_v<Balance, balance::none>
+        && !std::is_same_v<Balance, balance::splay>;
+
+    // The parent of t, or nullptr in a tree without parent links. Only
+    // for callers with nothing to do there, such as add_to_counts.
+    template <typename N>
+    static N parent_of( N t ) {
+        if constexpr (parent_linked)
+            return t->parent;
+        else
+            return nullptr;
+    }
+    static void set_parent( node_ptr t, node_ptr p ) {
+        if constexpr (parent_linked)
+            t->parent = p;
+    }
+
+  public:
+    // Bytes occupied by one node of this tree
+    static constexpr size_type node_size = sizeof(BinaryNode);
+    // Copies of trees with at least twice this many nodes are made on
+    // several threads (see the copy constructor)
+    static constexpr size_type parallel_clone_grain = size_type(1) << 14;
+
+    /*
+        Bidirectional iterator over the elements in key order. Stepping
+        follows child and parent pointers, so a full scan visits each
+        edge twice (O(1) amortized per step) and never allocates. The
+        end iterator holds a null node; decrementing it needs the tree,
+        so iterators also carry a pointer to the tree they walk. In a
+        tree without parent links, a step that would climb searches
+        from the root for the neighbour instead, costing O(height).
+
+        Elements are reachable as mutable pairs through iterator, but
+        changing a key would break the order of the tree. Inserting or
+        erasing other keys invalidates every iterator.
+    */
+    template <bool Const>
+    class in_order_iterator
+    {
+        using tree_ptr     = std::conditional_t<Const, const BinarySearchTree *, BinarySearchTree *>;
+        using node_pointer = std::conditional_t<Const, const_node_ptr, node_ptr>;
+
+        node_pointer _node;
+        tree_ptr _tree;
+
+        in_order_iterator( node_pointer n, tree_ptr tree ) : _node{n}, _tree{tree} { }
+        friend class BinarySearchTree;
+
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = BinarySearchTree::pair;
+        using difference_type   = BinarySearchTree::difference_type;
+        using pointer           = std::conditional_t<Const, const_pointer, BinarySearchTree::pointer>;
+        using reference         = std::conditional_t<Const, const_reference, BinarySearchTree::reference>;
+
+        in_order_iterator() : _node{nullptr}, _tree{nullptr} { }
+        // iterator converts to const_iterator
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        in_order_iterator( const in_order_iterator<false> & it ) : _node{it._node}, _tree{it._tree} { }
+
+        reference operator*() const { return _node->element; }
+        pointer operator->() const { return &_node->element; }
+
+        in_order_iterator & operator++() {
+            if (_node->right != nullptr) {
+                _node = _node->right;
+                while (_node->left != nullptr)
+                    _node = _node->left;
+            } else if constexpr (!parent_linked) {
+                _node = const_cast<node_pointer>(_tree->template neighbour<true>(_node));
+            } else {
+                // climb until we arrive from a left child
+                node_pointer from = _node;
+                _node = _node->parent;
+                while (_node != nullptr && from == _node->right) {
+                    from = _node;
+                    _node = _node->parent;
+                }
+            }
+            return *this;
+        }
+        in_order_iterator & operator--() {
+            if (_node == nullptr) {
+                _node = _tree->max_node();
+            } else if (_node->left != nullptr) {
+                _node = _node->left;
+                while (_node->right != nullptr)
+                    _node = _node->right;
+            } else if constexpr (!parent_linked) {
+                _node = const_cast<node_pointer>(_tree->template neighbour<false>(_node));
+            } else {
+                node_pointer from = _node;
+                _node = _node->parent;
+                while (_node != nullptr && from == _node->left) {
+                    from = _node;
+                    _node = _node->parent;
+                }
+            }
+            return *this;
+        }
+        in_order_iterator operator++( int ) {
+            in_order_iterator old = *this;
+            ++*this;
+            return old;
+        }
+        in_order_iterator operator--( int ) {
+            in_order_iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        friend bool operator==( const in_order_iterator & a, const in_order_iterator & b ) { return a._node == b._node; }
+        friend bool operator!=( const in_order_iterator & a, const in_order_iterator & b ) { return a._node != b._node; }
+
+        template <bool> friend class in_order_iterator;
+    };
+
+    using iterator               = in_order_iterator<false>;
+    using const_iterator         = in_order_iterator<true>;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    // One mutation of a batch passed to apply_batch. An erase reads only
+    // the key of element.
+    struct op {
+        enum kind_type { insert, erase };
+        kind_type kind;
+        pair element;
+    };
+
+    /*
+        Owning handle to a node taken out of a tree by extract. The node
+        keeps its element and can be relinked into a tree with the same
+        allocator by insert, without allocating; a handle that still
+        holds its node when destroyed frees it. key() is mutable, so an
+        element can be re-keyed between trees.
+    */
+    class node_type
+    {
+        node_ptr _node = nullptr;
+        allocator_type _alloc;
+
+        node_type( node_ptr n, const allocator_type & a ) : _node{n}, _alloc{a} { }
+        friend class BinarySearchTree;
+
+        node_ptr release() { return std::exchange(_node, nullptr); }
+        void reset() {
+            if (_node != nullptr)
+                node_storage<storage::heap, BinaryNode, Allocator>(_alloc).destroy(release());
+        }
+
+      public:
+        node_type() = default;
+        node_type( node_type && rhs ) noexcept : _node{rhs.release()}, _alloc{std::move(rhs._alloc)} { }
+        node_type & operator=( node_type && rhs ) {
+            if (this != &rhs) {
+                reset();
+                _node = rhs.release();
+                _alloc = std::move(rhs._alloc);
+            }
+            return *this;
+        }
+        ~node_type() { reset(); }
+
+        bool empty() const { return _node == nullptr; }
+        explicit operator bool() const { return _node != nullptr; }
+        key_type & key() const { return _node->element.first; }
+        value_type & mapped() const { return _node->element.second; }
+        allocator_type get_allocator() const { return _alloc; }
+    };
+
+    // Result of inserting a node handle: where the key is, whether the
+    // handle's node went in, and otherwise the handle itself
+    struct insert_return_type {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
+
+  private:
+
+    // Upper bound on the height of a red-black tree holding at most
+    // SIZE_MAX nodes, plus room for the extra level the erase fixup
+    // temporarily introduces. AVL and scapegoat trees are shorter.
+    static constexpr size_type MAX_BALANCED_HEIGHT = 2 * 64 + 2;
+
+    node_ptr _root;
+    size_type _size;
+    // The node holding the largest key, kept by the leaf links and
+    // removals so that append_max need not walk the right spine. Null
+    // when not known; append then looks it up again.
+    node_ptr _rightmost = nullptr;
+    key_compare comp;
+    node_storage<Storage, BinaryNode, Allocator> _nodes;
+
+    using alloc_traits = std::allocator_traits<Allocator>;
+
+  public:
+    BinarySearchTree() : _root{nullptr}, _size{0}, comp{} { }
+    explicit BinarySearchTree( const allocator_type & a ) : _root{nullptr}, _size{0}, comp{}, _nodes{a} { }
+
+    BinarySearchTree( const BinarySearchTree & rhs )
+      : BinarySearchTree( rhs, alloc_traits::select_on_container_copy_construction(rhs.get_allocator()) ) { }
+    BinarySearchTree( const BinarySearchTree & rhs, const allocator_type & a )
+      : tree_metadata<Balance>(rhs), _root{nullptr}, _size{rhs._size}, comp{rhs.comp}, _nodes{a} {
+        _root = clone_parallel(rhs._root, rhs._size);
+    }
+    /*
+        Copies of large trees are made on several threads. The top levels
+        are copied node by node, each forking the copies of its two
+        subtrees onto a ThreadPool, down to where a subtree is expected
+        to hold fewer than 2 * parallel_clone_grain nodes; below that a
+        subtree is cloned on one thread. Idle threads steal the largest
+        queued subtree. The plain copy constructor and copy assignment
+        use ThreadPool::shared(); this one takes the pool and optionally
+        the grain. The copy has exactly the shape, balancing bookkeeping
+        and elements of rhs.
+        Only trees whose nodes come from std::allocator are copied in
+        parallel, since a node pool or another allocator need not be
+        thread-safe.
+    */
+    BinarySearchTree( const BinarySearchTree & rhs, ThreadPool & pool, size_type grain = parallel_clone_grain )
+      : tree_metadata<Balance>(rhs), _root{nullptr}, _size{rhs._size}, comp{rhs.comp},
+        _nodes{alloc_traits::select_on_container_copy_construction(rhs.get_allocator())} {
+        _root = clone(rhs._root, pool, clone_forks(rhs._size, grain, pool));
+    }
+
+    BinarySearchTree( BinarySearchTree && rhs ) : tree_metadata<Balance>(rhs), comp{rhs.comp}, _nodes{std::move(rhs._nodes)} {
+        _root = std::move(rhs._root); // move the root 
+        _size = rhs._size; // update the size 
+        _rightmost = rhs._rightmost;
+        rhs.disown(); // clear rhs 
+    }
+    // Takes over rhs's nodes if its allocator equals a, otherwise moves
+    // the elements one by one into nodes allocated from a
+    BinarySearchTree( BinarySearchTree && rhs, const allocator_type & a )
+      : tree_metadata<Balance>(rhs), _root{nullptr}, _size{rhs._size}, comp{rhs.comp}, _nodes{a} {
+        if (a == rhs.get_allocator()) {
+            _nodes = std::move(rhs._nodes);
+            _root = rhs._root;
+            _rightmost = rhs._rightmost;
+            rhs.disown();
+        } else {
+            _root = clone_moving(rhs._root);
+            rhs.clear();
+        }
+    }
+    // Builds the tree from [first, last), in any order; as with repeated
+    // insert, a later element replaces an earlier one with an equal key
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    BinarySearchTree( InputIt first, InputIt last, const allocator_type & a = allocator_type() )
+      : _root{nullptr}, _size{0}, comp{}, _nodes{a} {
+        assign( first, last );
+    }
+    ~BinarySearchTree() {
+        clear(); 
+    }
+
+    iterator begin() { return iterator( min_node(), this ); }
+    iterator end() { return iterator( nullptr, this ); }
+    const_iterator begin() const { return const_iterator( min_node(), this ); }
+    const_iterator end() const { return const_iterator( nullptr, this ); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    reverse_iterator rbegin() { return reverse_iterator( end() ); }
+    reverse_iterator rend() { return reverse_iterator( begin() ); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator( end() ); }
+    const_reverse_iterator rend() const { return const_reverse_iterator( begin() ); }
+    const_reverse_iterator crbegin() const { return rbegin(); }
+    const_reverse_iterator crend() const { return rend(); }
+
+    const_reference min() const { return min( _root )->element; }
+    const_reference max() const { return max( _root )->element; }
+    const_reference root() const { return _root->element; }
+
+    bool contains( const key_type & x ) const { return contains( x, _root ); }
+    bool contains( const key_type & x ) {
+        if constexpr (std::is_same_v<Balance, balance::splay>)
+            return splay_find( x ) != nullptr;
+        else
+            return contains( x, _root );
+    }
+    value_type & find( const key_type & key ) {
+        if constexpr (std::is_same_v<Balance, balance::splay>)
+            return splay_find( key )->element.second;
+        else
+            return find( key, _root )->element.second;
+    }
+    const value_type & find( const key_type & key ) const { return find( key, _root )->element.second; }
+
+    // First element whose key is not ordered before key, or end()
+    iterator lower_bound( const key_type & key ) { return iterator( lower_bound_node( key ), this ); }
+    const_iterator lower_bound( const key_type & key ) const { return const_iterator( lower_bound_node( key ), this ); }
+    // First element whose key is ordered after key, or end()
+    iterator upper_bound( const key_type & key ) { return iterator( upper_bound_node( key ), this ); }
+    const_iterator upper_bound( const key_type & key ) const { return const_iterator( upper_bound_node( key ), this ); }
+    // The (empty or single-element) range of elements with key
+    std::pair<iterator, iterator> equal_range( const key_type & key ) {
+        return { lower_bound( key ), upper_bound( key ) };
+    }
+    std::pair<const_iterator, const_iterator> equal_range( const key_type & key ) const {
+        return { lower_bound( key ), upper_bound( key ) };
+    }
+
+    /*
+        Heterogeneous lookup. As with std::map, when the comparator
+        declares is_transparent (e.g. std::less<>), these overloads take
+        any type the comparator can order against key_type, such as a
+        std::string_view or const char * for std::string keys, and no
+        key_type temporary is built. A key_type argument still selects
+        the plain overloads.
+    */
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    bool contains( const KeyLike & x ) const { return contains( x, _root ); }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    bool contains( const KeyLike & x ) {
+        if constexpr (std::is_same_v<Balance, balance::splay>)
+            return splay_find( x ) != nullptr;
+        else
+            return contains( x, _root );
+    }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    value_type & find( const KeyLike & key ) {
+        if constexpr (std::is_same_v<Balance, balance::splay>)
+            return splay_find( key )->element.second;
+        else
+            return find( key, _root )->element.second;
+    }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    const value_type & find( const KeyLike & key ) const { return find( key, _root )->element.second; }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    iterator lower_bound( const KeyLike & key ) { return iterator( lower_bound_node( key ), this ); }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    const_iterator lower_bound( const KeyLike & key ) const { return const_iterator( lower_bound_node( key ), this ); }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    iterator upper_bound( const KeyLike & key ) { return iterator( upper_bound_node( key ), this ); }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    const_iterator upper_bound( const KeyLike & key ) const { return const_iterator( upper_bound_node( key ), this ); }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range( const KeyLike & key ) {
+        return { lower_bound( key ), upper_bound( key ) };
+    }
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range( const KeyLike & key ) const {
+        return { lower_bound( key ), upper_bound( key ) };
+    }
+
+    // Calls visit on every element with a key in [lo, hi), in key order.
+    // One descent finds lo and the walk stops at the first key not before
+    // hi, so nothing outside the range is touched beyond the O(log n)
+    // nodes on the way in: O(log n + k) on a balanced tree.
+    template <typename F>
+    void for_each_in_range( const key_type & lo, const key_type & hi, F && visit ) {
+        for (iterator it = lower_bound( lo ); it != end() && comp( it->first, hi ); ++it)
+            visit( *it );
+    }
+    template <typename F>
+    void for_each_in_range( const key_type & lo, const key_type & hi, F && visit ) const {
+        for (const_iterator it = lower_bound( lo ); it != end() && comp( it->first, hi ); ++it)
+            visit( *it );
+    }
+
+    // Order statistics; these need augment::order_statistics and run in
+    // time proportional to the height of the tree. Keys are ranked from 0.
+
+    // Number of elements whose keys are ordered before key
+    size_type rank( const key_type & key ) const {
+        static_assert(ranked, "rank needs augment::order_statistics");
+        size_type r = 0;
+        for (const_node_ptr t = _root; t != nullptr; ) {
+            if (comp(t->element.first, key)) {
+                r += node_count(t->left) + 1;
+                t = t->right;
+            } else {
+                t = t->left;
+            }
+        }
+        return r;
+    }
+    // The element with rank i; i must be less than size()
+    const_reference select( size_type i ) const {
+        static_assert(ranked, "select needs augment::order_statistics");
+        return select_node( i )->element;
+    }
+    // Iterator to the element with rank i, or end() if i >= size()
+    iterator nth( size_type i ) {
+        static_assert(ranked, "nth needs augment::order_statistics");
+        return iterator( const_cast<node_ptr>(select_node( i )), this );
+    }
+    const_iterator nth( size_type i ) const {
+        static_assert(ranked, "nth needs augment::order_statistics");
+        return const_iterator( select_node( i ), this );
+    }
+    // Number of elements with keys in [lo, hi)
+    size_type count_range( const key_type & lo, const key_type & hi ) const {
+        static_assert(ranked, "count_range needs augment::order_statistics");
+        if (!comp(lo, hi))
+            return 0;
+        return rank( hi ) - rank( lo );
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+    size_type size() const {
+        return _size;
+    }
+
+    void clear() {
+        // Pooled nodes with nothing to destroy go when their slabs do
+        if constexpr (std::is_same_v<Storage, storage::pool> && std::is_trivially_destructible_v<BinaryNode>)
+            _root = nullptr;
+        else
+            clear( _root );
+        _nodes.release();
+        _size = 0;
+        _rightmost = nullptr;
+        if constexpr (std::is_same_v<Balance, balance::scapegoat>)
+            this->max_size = 0;
+    }
+    void insert( const_reference x ) {
+        if constexpr (std::is_same_v<Balance, balance::none>)
+            insert( x, _root );
+        else
+            insert_balanced( x );
+    }
+    void insert( pair && x ) {
+        if constexpr (std::is_same_v<Balance, balance::none>)
+            insert( std::move( x ), _root );
+        else
+            insert_balanced( std::move( x ) );
+    }
+
+    /*
+        Hinted inserts for keys arriving in (nearly) sorted order. Like
+        insert they overwrite the value of an equal key, and they return
+        an iterator to the element. When the key belongs right before or
+        right after hint, or is equal to one of them, insert(hint, x)
+        makes at most four comparisons and links the node next to the
+        hint without a search; otherwise it descends from the root. Pass
+        the returned iterator as the next hint. append_max(x) compares x
+        with the largest key only and, when x is larger, links it as the
+        new maximum; reaching the maximum follows right links but makes
+        no comparisons. Red-black, AVL and treap rebalancing then climbs
+        the parent pointers only as far as it has work to do, amortized
+        O(1). Splay trees ignore the hint: the previous key is at the
+        root, so a splay insert of the next one is already O(1) amortized.
+    */
+    iterator insert( const_iterator hint, const_reference x ) { return insert_hint(hint, x); }
+    iterator insert( const_iterator hint, pair && x ) { return insert_hint(hint, std::move(x)); }
+    iterator append_max( const_reference x ) { return append(x); }
+    iterator append_max( pair && x ) { return append(std::move(x)); }
+
+    /*
+        Unlike insert, emplace and try_emplace leave an existing element
+        with an equal key untouched. Both return an iterator to the
+        element with the key and whether it was inserted.
+
+        emplace builds the pair in a new node from the arguments of one
+        of pair's constructors, and frees the node again if the key turns
+        out to be present. try_emplace searches for the key first and
+        constructs the value from args only once an empty slot is found,
+        so a duplicate costs one descent and nothing else.
+    */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace( Args &&... args ) {
+        node_ptr n = _nodes.create(std::in_place, std::forward<Args>(args)...);
+        auto [t, inserted] = insert_unique(n->element.first, [n] { return n; });
+        if (!inserted)
+            _nodes.destroy(n);
+        return { iterator(t, this), inserted };
+    }
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace( const key_type & key, Args &&... args ) {
+        auto [t, inserted] = insert_unique(key, [&] {
+            return _nodes.create(std::in_place, std::piecewise_construct, std::forward_as_tuple(key),
+                                 std::forward_as_tuple(std::forward<Args>(args)...));
+        });
+        return { iterator(t, this), inserted };
+    }
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace( key_type && key, Args &&... args ) {
+        auto [t, inserted] = insert_unique(key, [&] {
+            return _nodes.create(std::in_place, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                 std::forward_as_tuple(std::forward<Args>(args)...));
+        });
+        return { iterator(t, this), inserted };
+    }
+    // Returns the number of elements erased (0 or 1), as std::map::erase
+    size_type erase( const key_type & x ) {
+        if constexpr (std::is_same_v<Balance, balance::none>)
+            return erase(x, _root);
+        else
+            return erase_balanced( x );
+    }
+    // With a transparent comparator, erases by any type it can order
+    // against key_type
+    template <typename KeyLike, typename C = Comparator, typename = typename C::is_transparent>
+    size_type erase( const KeyLike & x ) {
+        if constexpr (std::is_same_v<Balance, balance::none>)
+            return erase(x, _root);
+        else
+            return erase_balanced( x );
+    }
+
+    /*
+        Batched updates. The ops are stably sorted by key in place and
+        applied in increasing key order, with the same result as applying
+        them one by one in their original order: only the last op of each
+        key has any effect. Erasing an absent key is not an error.
+
+        A batch of at least one op per batch_density keys of the tree is
+        dense. Each of its searches starts from the node the previous key
+        left off at and climbs only as far as the first ancestor whose
+        subtree must hold the next key, so neighbouring keys share the top
+        of their paths and the batch makes O(k log(n/k + 1)) comparisons
+        on the red-black and AVL trees. Treaps and splay trees apply the
+        sorted ops one at a time; splaying keys in order is already cheap.
+        So do trees without parent links, which have no way to climb.
+
+        The keys of a sparse batch lie far apart, and their time goes to
+        the cache misses below the shared top of their paths. The batch
+        is applied batch_chunk ops at a time: warm_paths walks the paths
+        of a chunk with their misses overlapped, then the ops of the
+        chunk run one at a time from the root through nodes in cache.
+    */
+    template <typename RandomIt>
+    void apply_batch( RandomIt first, RandomIt last ) {
+        auto by_key = [this]( const op & a, const op & b ) { return comp( a.element.first, b.element.first ); };
+        std::stable_sort( first, last, by_key );
+
+        bool sparse = static_cast<size_type>( last - first ) * batch_density < _size;
+        RandomIt warmed = first;
+        node_ptr finger = nullptr;
+        for (RandomIt it = first; it != last; ++it) {
+            if (sparse && it == warmed) {
+                warmed = it + std::min<typename std::iterator_traits<RandomIt>::difference_type>( batch_chunk, last - it );
+                warm_paths( it, warmed );
+            }
+            if (std::next( it ) != last && !comp( it->element.first, std::next( it )->element.first ))
+                continue;
+
+            if (sparse || !parent_linked) {
+                if (it->kind == op::insert)
+                    insert( std::move( it->element ) );
+                else
+                    erase( it->element.first );
+            } else if constexpr (std::is_same_v<Balance, balance::treap> || std::is_same_v<Balance, balance::splay>) {
+                if (it->kind == op::insert)
+                    insert_balanced( std::move( it->element ) );
+                else
+                    erase_balanced( it->element.first );
+            } else if (it->kind == op::insert) {
+                finger = batch_insert( std::move( it->element ), finger );
+            } else {
+                finger = batch_erase( it->element.first, finger );
+            }
+        }
+    }
+    // Any container of ops, e.g. std::vector<op> or an array
+    template <typename Ops>
+    void apply_batch( Ops & ops ) {
+        apply_batch( std::begin( ops ), std::end( ops ) );
+    }
+
+    /*
+        Split and join relink the existing nodes: no element is copied or
+        moved and nothing is allocated. Both cost O(log n) on red-black
+        and AVL trees (expected on treaps, amortized on splay trees) and
+        O(height) on unbalanced and scapegoat trees, plus, without
+        augment::order_statistics, counting the smaller of the two parts
+        to keep size() exact. Pooled nodes belong to their tree's slabs,
+        so only heap storage can hand nodes to another tree.
+    */
+
+    // Moves the keys ordered before key into the first tree and the rest
+    // into the second, leaving this tree empty
+    std::pair<BinarySearchTree, BinarySearchTree> split( const key_type & key ) {
+        static_assert(std::is_same_v<Storage, storage::heap>, "only heap nodes can move between trees");
+        std::pair<BinarySearchTree, BinarySearchTree> parts( get_allocator(), get_allocator() );
+
+        node_ptr t = _root;
+        size_type n = _size;
+        disown();
+
+        subtree lt, ge;
+        node_ptr eq = split_nodes(whole(t), key, lt, ge);
+        if (eq != nullptr)
+            ge = join_with({}, eq, ge);
+        size_type n_lt = size_of_first(lt.root, ge.root, n);
+        parts.first.adopt(lt.root, n_lt, *this);
+        parts.second.adopt(ge.root, n - n_lt, *this);
+        return parts;
+    }
+
+    // Joins two trees where every key of left is ordered before every key
+    // of right, leaving both empty. Nodes of a right tree whose allocator
+    // differs from left's cannot be adopted; its elements are moved into
+    // new nodes instead.
+    static BinarySearchTree join( BinarySearchTree && left, BinarySearchTree && right ) {
+        static_assert(std::is_same_v<Storage, storage::heap>, "only heap nodes can move between trees");
+        BinarySearchTree joined( std::move( left ) );
+        if (joined.get_allocator() != right.get_allocator()) {
+            for (pair & element : right)
+                joined.insert( std::move( element ) );
+            right.clear();
+            return joined;
+        }
+
+        node_ptr l = joined._root;
+        node_ptr r = right._root;
+        size_type n = joined._size + right._size;
+        joined.disown();
+        right.disown();
+        joined.adopt(joined.join_nodes(whole(l), whole(r)).root, n, joined);
+        return joined;
+    }
+
+    /*
+        Node handles move elements between trees without copying them or
+        allocating. extract(key) unlinks the node holding key and returns
+        it as a node_type (empty if the key is absent); extract(position)
+        does the same without a search. As with erase, the tree may move
+        a neighbouring element into another node on the way, so all
+        iterators are invalidated. insert(node) relinks the node unless
+        the key is present, in which case the handle comes back in the
+        result. merge(other) moves every node of other whose key this
+        tree lacks, leaving the rest in other. Only heap storage can
+        hand nodes to another tree. A handle from a tree whose allocator
+        compares unequal is moved into a new node instead.
+    */
+    node_type extract( const key_type & key ) {
+        static_assert(std::is_same_v<Storage, storage::heap>, "only heap nodes can move between trees");
+        node_ptr t;
+        if constexpr (std::is_same_v<Balance, balance::splay>)
+            t = splay_find( key );
+        else
+            t = find( key, _root );
+        if (t == nullptr)
+            return node_type();
+        return node_type( remove_node(t), get_allocator() );
+    }
+    node_type extract( const_iterator position ) {
+        static_assert(std::is_same_v<Storage, storage::heap>, "only heap nodes can move between trees");
+        return node_type( remove_node(const_cast<node_ptr>(position._node)), get_allocator() );
+    }
+    insert_return_type insert( node_type && nh ) {
+        static_assert(std::is_same_v<Storage, storage::heap>, "only heap nodes can move between trees");
+        if (nh.empty())
+            return { end(), false, node_type() };
+        auto [t, inserted] = insert_unique(nh.key(), [&] { return adopt_node(nh); });
+        if (inserted)
+            return { iterator(t, this), true, node_type() };
+        return { iterator(t, this), false, std::move(nh) };
+    }
+    void merge( BinarySearchTree & other ) {
+        static_assert(std::is_same_v<Storage, storage::heap>, "only heap nodes can move between trees");
+        if (&other == this)
+            return;
+        node_ptr n = other.min_node();
+        while (n != nullptr) {
+            node_ptr next = (++iterator( n, &other ))._node;
+            insert_unique(n->element.first, [&] {
+                node_type nh( other.remove_node(n), other.get_allocator() );
+                // n took over its successor's element and stays behind
+                if (nh._node != n)
+                    next = n;
+                return adopt_node(nh);
+            });
+            n = next;
+        }
+    }
+    void merge( BinarySearchTree && other ) { merge( other ); }
+
+    /*
+        Set algebra. Each operation takes over the nodes of both trees and
+        leaves them empty. Where both trees hold a key, the element of a
+        is kept. Nodes are relinked rather than copied; the nodes that
+        drop out are destroyed at the end.
+
+        a is split at the key of b's root, the two sides are combined
+        recursively, and the results are joined around the root. For
+        trees of sizes m <= n this costs O(m log(n/m + 1)) on red-black
+        and AVL trees, expected on treaps. The two sides are forked onto
+        the pool near the top of the recursion, deep enough to keep every
+        thread busy. Unbalanced and splay trees are first rebuilt into a
+        balanced shape in O(n + m), so that the recursion stays shallow.
+    */
+
+    // Keys in either tree
+    static BinarySearchTree merge_union( BinarySearchTree && a, BinarySearchTree && b, ThreadPool & pool = ThreadPool::shared() ) {
+        return set_algebra<set_op::merge_union>( std::move( a ), std::move( b ), pool );
+    }
+    // Keys in both trees
+    static BinarySearchTree intersect( BinarySearchTree && a, BinarySearchTree && b, ThreadPool & pool = ThreadPool::shared() ) {
+        return set_algebra<set_op::intersect>( std::move( a ), std::move( b ), pool );
+    }
+    // Keys of a that are not in b
+    static BinarySearchTree difference( BinarySearchTree && a, BinarySearchTree && b, ThreadPool & pool = ThreadPool::shared() ) {
+        return set_algebra<set_op::difference>( std::move( a ), std::move( b ), pool );
+    }
+
+    /*
+        Bulk loading. Both replace the contents of the tree with a
+        perfectly balanced tree built in O(n): the nodes are created in
+        key order, one allocation each and nothing else, and linked
+        into place as they are made. The shape satisfies every balancing
+        policy, with colours, heights, priorities and counts filled in.
+    */
+
+    // [first, last) must be sorted by strictly increasing key; this is
+    // not checked
+    template <typename InputIt>
+    void assign_sorted( InputIt first, InputIt last ) {
+        clear();
+        if constexpr (is_forward_iterator<InputIt>) {
+            build_balanced( first, static_cast<size_type>(std::distance( first, last )) );
+        } else {
+            std::vector<pair> elements( first, last );
+            build_balanced( std::make_move_iterator( elements.begin() ), elements.size() );
+        }
+    }
+    // Checked variant for input in any order. Strictly increasing input
+    // costs one extra pass of comparisons; anything else is copied and
+    // sorted first, keeping the last element of each run of equal keys.
+    template <typename InputIt>
+    void assign( InputIt first, InputIt last ) {
+        if constexpr (is_forward_iterator<InputIt>) {
+            if (strictly_increasing( first, last )) {
+                assign_sorted( first, last );
+                return;
+            }
+        }
+
+        std::vector<pair> elements( first, last );
+        auto by_key = [this]( const pair & a, const pair & b ) { return comp( a.first, b.first ); };
+        std::stable_sort( elements.begin(), elements.end(), by_key );
+
+        auto out = elements.begin();
+        for (auto it = elements.begin(); it != elements.end(); ++it) {
+            if (std::next( it ) != elements.end() && !comp( it->first, std::next( it )->first ))
+                continue;
+            if (out != it)
+                *out = std::move( *it );
+            ++out;
+        }
+        elements.erase( out, elements.end() );
+
+        assign_sorted( std::make_move_iterator( elements.begin() ), std::make_move_iterator( elements.end() ) );
+    }
+
+    // Number of nodes on the longest root-to-leaf path. Walks the whole
+    // tree (see walk_in_order), so it is O(n) but allocates nothing.
+    size_type height() const {
+        size_type h = 0;
+        walk_in_order(_root, [&](const_node_ptr, size_type depth) { h = std::max(h, depth + 1); });
+        return h;
+    }
+
+    // Copies the elements into an immutable snapshot laid out for fast
+    // lookups. The tree is unchanged. Snapshot may also be
+    // StaticSearchTree<K, V> for integer keys, PersistentSearchTree for
+    // versions that keep taking updates, or ConcurrentSearchTree to hand
+    // the elements to reader threads.
+    template <typename Snapshot = FrozenSearchTree<K, V, Comparator>>
+    Snapshot freeze() const & {
+        std::vector<pair> sorted;
+        sorted.reserve(_size);
+        in_order(_root, [&](node_ptr t) { sorted.push_back(t->element); });
+        return Snapshot(std::move(sorted), comp);
+    }
+    // Moves the elements into an immutable snapshot, leaving the tree empty
+    template <typename Snapshot = FrozenSearchTree<K, V, Comparator>>
+    Snapshot freeze() && {
+        std::vector<pair> sorted;
+        sorted.reserve(_size);
+        in_order(_root, [&](node_ptr t) { sorted.push_back(std::move(t->element)); });
+        clear();
+        return Snapshot(std::move(sorted), comp);
+    }
+
+    // Backs the node pool's future slabs with transparent huge pages
+    void use_huge_pages( bool on = true ) {
+        static_assert(std::is_same_v<Storage, storage::pool>, "only pooled trees have slabs");
+        _nodes.huge_pages(on);
+    }
+
+    // Reseeds the generator drawing treap priorities. Trees built from
+    // the same seed and the same operations have identical shapes.
+    void seed( uint64_t s ) {
+        static_assert(std::is_same_v<Balance, balance::treap>, "only treaps are seeded");
+        this->rng.seed(s);
+    }
+
+    allocator_type get_allocator() const { return _nodes.get_allocator(); }
+
+    BinarySearchTree & operator=( const BinarySearchTree & rhs ) {
+        if (&rhs == this) return *this; 
+        this->clear();
+        if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+            _nodes.set_allocator(rhs.get_allocator());
+        this->_size = rhs._size; 
+        this->_root = clone_parallel(rhs._root, rhs._size);
+        static_cast<tree_metadata<Balance> &>(*this) = rhs;
+        return *this;  
+    }
+    BinarySearchTree & operator=( BinarySearchTree && rhs ) {
+        if (&rhs == this) return *this; 
+        this->clear();
+        if constexpr (!alloc_traits::propagate_on_container_move_assignment::value) {
+            // Nodes from an unequal allocator cannot be adopted; move the
+            // elements into nodes of our own instead
+            if (get_allocator() != rhs.get_allocator()) {
+                this->_root = clone_moving(rhs._root);
+                this->_size = rhs._size;
+                static_cast<tree_metadata<Balance> &>(*this) = rhs;
+                rhs.clear();
+                return *this;
+            }
+        }
+        this->_size = rhs._size; 
+        this->_root = std::move(rhs._root);
+        this->_rightmost = rhs._rightmost;
+        this->_nodes = std::move(rhs._nodes);
+        static_cast<tree_metadata<Balance> &>(*this) = rhs;
+        rhs.disown();
+        return *this;  
+    }
+
+  private:
+    /*
+        Unbalanced insert, erase and lookups descend with a loop rather
+        than recursion, so a degenerate tree (e.g. one built from sorted
+        input) costs time proportional to its height but no stack.
+    */
+
+    template <typename P>
+    void insert( P && x, node_ptr & root ) {
+        node_ptr * link = &root;
+        node_ptr parent = nullptr;
+
+        while (*link != nullptr) {
+            node_ptr t = *link;
+            parent = t;
+            if (comp(x.first, t->element.first))
+                link = &t->left;
+            else if (comp(t->element.first, x.first))
+                link = &t->right;
+            else {
+                // equal key --> update the element
+                t->element = std::forward<P>(x);
+                return;
+            }
+        }
+
+        *link = _nodes.create(std::forward<P>(x), nullptr, nullptr, parent);
+        track_rightmost(*link, link, parent);
+        _size++;
+        add_to_counts(parent, 1);
+    }
+
+    // Returns false if the key is not present
+    template <typename Key>
+    bool erase( const Key & x, node_ptr & root ) {
+        node_ptr * link = &root;
+
+        while (*link != nullptr && !equal_keys(x, (*link)->element.first))
+            link = comp(x, (*link)->element.first) ? &(*link)->left : &(*link)->right;
+
+        if (*link == nullptr)
+            return false;
+        unlink(link);
+        return true;
+    }
+
+    /* Unique inserts */
+
+    // Finds key, or else links the node returned by make() (which holds
+    // key and has no children) where the key belongs. make is called
+    // only in the second case, and key is not read after it, so make
+    // may free the object key refers to. Returns the node holding the
+    // key and whether it is the new one.
+    template <typename Make>
+    std::pair<node_ptr, bool> insert_unique( const key_type & key, Make && make ) {
+        if constexpr (std::is_same_v<Balance, balance::treap>) {
+            uint32_t priority = static_cast<uint32_t>(this->rng() >> 32);
+            node_ptr * link = &_root;
+            node_ptr parent = nullptr;
+            while (*link != nullptr && (*link)->priority >= priority) {
+                node_ptr t = *link;
+                if (comp(key, t->element.first))
+                    link = &t->left;
+                else if (comp(t->element.first, key))
+                    link = &t->right;
+                else
+                    return { t, false };
+                parent = t;
+            }
+            if (node_ptr t = find(key, *link))
+                return { t, false };
+
+            node_ptr n = make();
+            treap_split(*link, n->element.first, n->left, n->right);
+            if (n->left != nullptr)
+                set_parent(n->left, n);
+            if (n->right != nullptr)
+                set_parent(n->right, n);
+            n->priority = priority;
+            set_parent(n, parent);
+            *link = n;
+            forget_rightmost_above(n);
+            update_count(n);
+            add_to_counts(parent, 1);
+            _size++;
+            return { n, true };
+        } else if constexpr (std::is_same_v<Balance, balance::splay>) {
+            bool found;
+            _root = splay(key, _root, found);
+            if (found)
+                return { _root, false };
+
+            node_ptr n = make();
+            if (_root != nullptr) {
+                if (comp(n->element.first, _root->element.first)) {
+                    n->left = _root->left;
+                    n->right = _root;
+                    _root->left = nullptr;
+                } else {
+                    n->left = _root;
+                    n->right = _root->right;
+                    _root->right = nullptr;
+                }
+                if (n->left != nullptr)
+                    set_parent(n->left, n);
+                if (n->right != nullptr)
+                    set_parent(n->right, n);
+                update_count(_root);
+                update_count(n);
+            }
+            _root = n;
+            _size++;
+            return { n, true };
+        } else if constexpr (searches_paths) {
+            node_ptr * path[MAX_BALANCED_HEIGHT];
+            size_type depth;
+            search_path(key, path, depth);
+            if (*path[depth] != nullptr)
+                return { *path[depth], false };
+
+            return { link_leaf(make(), path, depth), true };
+        } else {
+            node_ptr parent;
+            node_ptr * link = finger_search(key, nullptr, parent);
+            if (*link != nullptr)
+                return { *link, false };
+
+            return { link_leaf(make(), link, parent), true };
+        }
+    }
+
+    // Links the childless node n at link, an empty slot below parent,
+    // and restores the balance: a treap rotates n up to its priority,
+    // other policies run their insert fixup on the path rebuilt from
+    // the parent pointers. Without parent links every policy runs
+    // insert_fixup on the path searched for from the root. Splay trees
+    // are left unsplayed. Returns n.
+    node_ptr link_leaf( node_ptr n, node_ptr * link, node_ptr parent ) {
+        set_parent(n, parent);
+        *link = n;
+        track_rightmost(n, link, parent);
+        _size++;
+        add_to_counts(parent, 1);
+        if constexpr (std::is_same_v<Balance, balance::treap>)
+            n->priority = static_cast<uint32_t>(this->rng() >> 32);
+
+        if constexpr (!parent_linked) {
+            if constexpr (!std::is_same_v<Balance, balance::none> && !std::is_same_v<Balance, balance::splay>) {
+                node_ptr * path[MAX_BALANCED_HEIGHT];
+                size_type depth;
+                node_ptr ** first = path_to(n, path, depth);
+                insert_fixup(first, depth);
+            }
+        } else if constexpr (std::is_same_v<Balance, balance::treap>) {
+            while (n->parent != nullptr && n->priority > n->parent->priority) {
+                node_ptr p = n->parent;
+                if (n == p->left)
+                    rotate_right(*link_to(p));
+                else
+                    rotate_left(*link_to(p));
+            }
+        } else if constexpr (std::is_same_v<Balance, balance::red_black>) {
+            rb_insert_fixup_up(n);
+        } else if constexpr (std::is_same_v<Balance, balance::avl>) {
+            avl_fixup_up(n->parent);
+        } else if constexpr (std::is_same_v<Balance, balance::scapegoat>) {
+            node_ptr * path[MAX_BALANCED_HEIGHT];
+            size_type depth;
+            node_ptr ** first = path_to(n, path, depth);
+            insert_fixup(first, depth);
+        }
+        return n;
+    }
+
+    // link_leaf for trees that search paths: n goes in at the empty link
+    // path[depth] and the fixup runs on the path
+    node_ptr link_leaf( node_ptr n, node_ptr ** path, size_type depth ) {
+        *path[depth] = n;
+        track_rightmost(n, path[depth], depth == 0 ? nullptr : *path[depth - 1]);
+        _size++;
+        if constexpr (std::is_same_v<Balance, balance::treap>)
+            n->priority = static_cast<uint32_t>(this->rng() >> 32);
+        insert_fixup(path, depth);
+        return n;
+    }
+
+    // A childless node of this tree holding nh's element: the handle's
+    // own node, reset, when the allocators agree, else a new node the
+    // element is moved into. The handle is left empty either way.
+    node_ptr adopt_node( node_type & nh ) {
+        if (nh._alloc != get_allocator()) {
+            node_ptr n = _nodes.create(std::move(nh._node->element), nullptr, nullptr);
+            nh.reset();
+            return n;
+        }
+        node_ptr n = nh.release();
+        n->left = n->right = nullptr;
+        set_parent(n, nullptr);
+        static_cast<metadata &>(*n) = metadata{};
+        static_cast<augmentation &>(*n) = augmentation{};
+        return n;
+    }
+
+    // Unlinks t's element and returns the node holding it, which has
+    // left the tree and the size. That is t unless t has two children
+    // in a policy that erases through the successor: then t takes over
+    // the successor's element and the successor's node is returned.
+    node_ptr remove_node( node_ptr t ) {
+        if constexpr (std::is_same_v<Balance, balance::treap>) {
+            node_ptr & link = *link_to(t);
+            link = treap_join(t->left, t->right);
+            if (link != nullptr)
+                set_parent(link, parent_of(t));
+            add_to_counts(parent_of(t), -1);
+            forget_rightmost(t);
+            _size--;
+            return t;
+        } else if constexpr (std::is_same_v<Balance, balance::splay>) {
+            bool found;
+            _root = splay(t->element.first, _root, found);
+            return splay_remove_root();
+        } else if constexpr (std::is_same_v<Balance, balance::none>) {
+            // Nothing to fix up, so the link to the node is path enough
+            node_ptr * link = link_to(t);
+            if (t->left != nullptr && t->right != nullptr) {
+                link = &t->right;
+                while ((*link)->left != nullptr)
+                    link = &(*link)->left;
+                std::swap(t->element, (*link)->element);
+            }
+            return remove_at(&link, 0);
+        } else if constexpr (!parent_linked) {
+            // The path is found by key, so before the successor swap
+            node_ptr * path[MAX_BALANCED_HEIGHT];
+            size_type depth;
+            erase_path(t->element.first, path, depth);
+            return remove_at(path, depth);
+        } else {
+            if (t->left != nullptr && t->right != nullptr) {
+                node_ptr successor = t->right;
+                while (successor->left != nullptr)
+                    successor = successor->left;
+                std::swap(t->element, successor->element);
+                t = successor;
+            }
+            node_ptr * path[MAX_BALANCED_HEIGHT];
+            size_type depth;
+            node_ptr ** first = path_to(t, path, depth);
+            return remove_at(first, depth);
+        }
+    }
+
+    /* Hinted inserts */
+
+    // Overwrites the value at link, or links a new node there
+    template <typename P>
+    iterator insert_at( node_ptr * link, node_ptr parent, P && x ) {
+        if (*link != nullptr) {
+            (*link)->element.second = std::forward<P>(x).second;
+            return iterator( *link, this );
+        }
+        return iterator( link_leaf(_nodes.create(std::forward<P>(x), nullptr, nullptr), link, parent), this );
+    }
+    // The same at the end of a searched path
+    template <typename P>
+    iterator insert_at( node_ptr ** path, size_type depth, P && x ) {
+        if (*path[depth] != nullptr) {
+            (*path[depth])->element.second = std::forward<P>(x).second;
+            return iterator( *path[depth], this );
+        }
+        return iterator( link_leaf(_nodes.create(std::forward<P>(x), nullptr, nullptr), path, depth), this );
+    }
+
+    // Key next to hint: between the hint and its predecessor, or between
+    // it and its successor, costs at most four comparisons. Of the two
+    // neighbours one has an empty child slot where the key belongs.
+    // Anything else descends from the root.
+    template <typename P>
+    iterator insert_hint( const_iterator hint, P && x ) {
+        if constexpr (std::is_same_v<Balance, balance::splay>) {
+            // The last node inserted or found is already at the root
+            splay_insert(std::forward<P>(x));
+            return iterator( _root, this );
+        } else if constexpr (!parent_linked) {
+            // A neighbour of the hint would cost a search of its own, so
+            // only an end() hint, which append serves, saves anything
+            if (hint._node == nullptr)
+                return append(std::forward<P>(x));
+            if constexpr (searches_paths) {
+                node_ptr * path[MAX_BALANCED_HEIGHT];
+                size_type depth;
+                search_path(x.first, path, depth);
+                return insert_at(path, depth, std::forward<P>(x));
+            } else {
+                node_ptr parent;
+                node_ptr * link = finger_search(x.first, nullptr, parent);
+                return insert_at(link, parent, std::forward<P>(x));
+            }
+        } else {
+            const key_type & key = x.first;
+            node_ptr h = const_cast<node_ptr>(hint._node);
+            node_ptr parent;
+            // A key past the hint's successor is searched for from there,
+            // so a key a few places off costs a short climb
+            node_ptr finger = nullptr;
+
+            if (h == nullptr || comp(key, h->element.first)) {
+                node_ptr p = (--iterator( h, this ))._node;
+                if (p == nullptr || comp(p->element.first, key)) {
+                    if (h != nullptr && h->left == nullptr)
+                        return insert_at(&h->left, h, std::forward<P>(x));
+                    if (p != nullptr)
+                        return insert_at(&p->right, p, std::forward<P>(x));
+                    return insert_at(&_root, nullptr, std::forward<P>(x));
+                }
+                if (!comp(key, p->element.first))
+                    return insert_at(link_to(p), parent_of(p), std::forward<P>(x));
+            } else if (comp(h->element.first, key)) {
+                node_ptr n = (++iterator( h, this ))._node;
+                if (n == nullptr || comp(key, n->element.first)) {
+                    if (h->right == nullptr)
+                        return insert_at(&h->right, h, std::forward<P>(x));
+                    return insert_at(&n->left, n, std::forward<P>(x));
+                }
+                if (!comp(n->element.first, key))
+                    return insert_at(link_to(n), parent_of(n), std::forward<P>(x));
+                finger = n;
+            } else {
+                return insert_at(link_to(h), parent_of(h), std::forward<P>(x));
+            }
+
+            node_ptr * link = finger_search(key, finger, parent);
+            return insert_at(link, parent, std::forward<P>(x));
+        }
+    }
+
+    // One comparison against the largest key, which is reached through
+    // right links only
+    template <typename P>
+    iterator append( P && x ) {
+        if constexpr (std::is_same_v<Balance, balance::splay>) {
+            splay_insert(std::forward<P>(x));
+            return iterator( _root, this );
+        } else if constexpr (searches_paths) {
+            // The right spine is the path to the slot after the largest key
+            node_ptr * path[MAX_BALANCED_HEIGHT];
+            size_type depth = 0;
+            path[0] = &_root;
+            while (*path[depth] != nullptr) {
+                BINARY_SEARCH_TREE_SPINE_STEP();
+                path[depth + 1] = &(*path[depth])->right;
+                depth++;
+            }
+            if (depth == 0 || comp((*path[depth - 1])->element.first, x.first))
+                return insert_at(path, depth, std::forward<P>(x));
+            search_path(x.first, path, depth);
+            return insert_at(path, depth, std::forward<P>(x));
+        } else {
+            // The cached largest node spares the walk; the leaf linked
+            // after it becomes the new one, so sorted appends cost O(1)
+            // amortized even on an unbalanced chain
+            if (_rightmost == nullptr)
+                _rightmost = max_node();
+            node_ptr m = _rightmost;
+            if (m == nullptr)
+                return insert_at(&_root, nullptr, std::forward<P>(x));
+            if (comp(m->element.first, x.first))
+                return insert_at(&m->right, m, std::forward<P>(x));
+            node_ptr parent;
+            node_ptr * link = finger_search(x.first, nullptr, parent);
+            return insert_at(link, parent, std::forward<P>(x));
+        }
+    }
+
+    // A leaf n linked at link below parent is the largest node if it
+    // went into an empty tree or right of the largest node
+    void track_rightmost( node_ptr n, node_ptr * link, node_ptr parent ) {
+        if (parent == nullptr || (parent == _rightmost && link == &parent->right))
+            _rightmost = n;
+    }
+    // For t leaving the tree
+    void forget_rightmost( node_ptr t ) {
+        if (t == _rightmost)
+            _rightmost = nullptr;
+    }
+    // For a new node n linked above existing ones, as a treap insert
+    // does: with nothing right of it, n may have become the largest
+    void forget_rightmost_above( node_ptr n ) {
+        if (n->right == nullptr)
+            _rightmost = nullptr;
+    }
+
+    /* Batched updates */
+
+    // Without parent links: the link to where key is or belongs, with
+    // the links from the root to it in path[0..depth]
+    void search_path( const key_type & key, node_ptr ** path, size_type & depth ) {
+        node_ptr * link = &_root;
+        depth = 0;
+        path[0] = link;
+        while (*link != nullptr) {
+            node_ptr t = *link;
+            if (comp(key, t->element.first))
+                link = &t->left;
+            else if (comp(t->element.first, key))
+                link = &t->right;
+            else
+                break;
+            path[++depth] = link;
+        }
+    }
+
+    // Link that holds t, or the root link for a null t. Without parent
+    // links, t's key is searched for from the root.
+    node_ptr * link_to( node_ptr t ) {
+        if constexpr (!parent_linked) {
+            node_ptr * link = &_root;
+            while (t != nullptr && *link != t)
+                link = comp(t->element.first, (*link)->element.first) ? &(*link)->left : &(*link)->right;
+            return link;
+        } else {
+            if (t == nullptr || t->parent == nullptr)
+                return &_root;
+            return t == t->parent->left ? &t->parent->left : &t->parent->right;
+        }
+    }
+
+    // Link to where key is or belongs. The search starts from finger, a
+    // node ordered before key (or null for the root), and climbs until
+    // it leaves a left subtree whose parent is ordered after key: only
+    // there is key known to be inside the subtree. Climbing out of a
+    // right subtree needs no comparison. Without parent links the
+    // finger is no help and the search starts from the root.
+    node_ptr * finger_search( const key_type & key, node_ptr finger, node_ptr & parent ) {
+        node_ptr t = finger != nullptr && parent_linked ? finger : _root;
+        while (t != nullptr && parent_of(t) != nullptr) {
+            node_ptr p = parent_of(t);
+            if (t == p->left && comp(key, p->element.first))
+                break;
+            t = p;
+        }
+
+        node_ptr * link = link_to(t);
+        parent = t == nullptr ? nullptr : parent_of(t);
+        while (*link != nullptr) {
+            node_ptr n = *link;
+            if (comp(key, n->element.first))
+                link = &n->left;
+            else if (comp(n->element.first, key))
+                link = &n->right;
+            else
+                break;
+            parent = n;
+        }
+        return link;
+    }
+
+    // Rebuilds the links from the root down to t from the parent
+    // pointers, as insert_path and erase_path would have recorded them.
+    // They fill the end of path, short of the last slot which the
+    // red-black erase fixup may extend into; returns where they begin.
+    // Without parent links they are recorded by searching for t's key
+    // from the root, filling path from the start.
+    node_ptr ** path_to( node_ptr t, node_ptr ** path, size_type & depth ) {
+        if constexpr (!parent_linked) {
+            node_ptr * link = &_root;
+            depth = 0;
+            path[0] = link;
+            while (*link != t) {
+                link = comp(t->element.first, (*link)->element.first) ? &(*link)->left : &(*link)->right;
+                path[++depth] = link;
+            }
+            return path;
+        } else {
+            node_ptr ** last = path + MAX_BALANCED_HEIGHT - 1;
+            node_ptr ** first = last;
+            for (; t != nullptr; t = t->parent)
+                *--first = link_to(t);
+            depth = static_cast<size_type>(last - first) - 1;
+            return first;
+        }
+    }
+
+    // Returns the node now holding the key, the finger for the next one
+    template <typename P>
+    node_ptr batch_insert( P && x, node_ptr finger ) {
+        node_ptr parent;
+        node_ptr * link = finger_search(x.first, finger, parent);
+        if (*link != nullptr) {
+            (*link)->element.second = std::forward<P>(x).second;
+            return *link;
+        }
+
+        return link_leaf(_nodes.create(std::forward<P>(x), nullptr, nullptr), link, parent);
+    }
+
+    // Returns the closest surviving node ordered before the key, the
+    // finger for the next one
+    node_ptr batch_erase( const key_type & key, node_ptr finger ) {
+        node_ptr parent;
+        node_ptr * link = finger_search(key, finger, parent);
+        node_ptr t = *link;
+        if (t == nullptr) {
+            // key would hang off parent, so if parent comes after it the
+            // node before parent also comes before key
+            if (parent == nullptr || comp(parent->element.first, key))
+                return parent;
+            return (--iterator( parent, this ))._node;
+        }
+
+        node_ptr before = (--iterator( t, this ))._node;
+        if constexpr (std::is_same_v<Balance, balance::none>)
+            unlink(link);
+        else
+            _nodes.destroy(remove_node(t));
+        return before;
+    }
+
+    // Ops whose paths are brought into cache together before they are
+    // applied, and the searches warm_paths runs side by side
+    static constexpr size_type batch_chunk = 512;
+    static constexpr size_type batch_lanes = 16;
+    // A batch of fewer than one op per this many keys is sparse
+    static constexpr size_type batch_density = 4;
+    // How many left turns warm_paths keeps per search; past that it
+    // climbs less far than it could
+    static constexpr size_type batch_turns = 64;
+
+    // Walks the search paths of the keys of [first, last), sorted, and
+    // changes nothing. The keys are split into batch_lanes runs that are
+    // searched side by side, a step of each run in turn; each step
+    // prefetches the next node of its search and moves on to the other
+    // runs before reading it, so their cache misses overlap instead of
+    // following one another. Each run keeps the nodes where its search
+    // went left, the only places the next, larger key can part from it,
+    // and starts the next search below the deepest one still ahead of
+    // that key rather than at the root. A search for a key to erase goes
+    // on to the successor, which a node with two children trades with.
+    // Applying the ops afterwards then finds their nodes in cache.
+    template <typename RandomIt>
+    void warm_paths( RandomIt first, RandomIt last ) const {
+        struct lane {
+            const_node_ptr node;
+            RandomIt next, end;
+            bool successor;
+            size_type turns;
+            // One spare slot, written when full without being counted
+            const_node_ptr turned_left[batch_turns + 1];
+        };
+        lane lanes[batch_lanes];
+        // Where the searches end, kept so that the walk is not optimized away
+        const_node_ptr volatile found = nullptr;
+
+        auto n = last - first;
+        size_type active = 0;
+        for (size_type i = 0; i < batch_lanes; i++) {
+            lane & l = lanes[active];
+            l.next = first + n * i / batch_lanes;
+            l.end = first + n * (i + 1) / batch_lanes;
+            l.node = _root;
+            l.successor = false;
+            l.turns = 0;
+            if (l.next != l.end)
+                active++;
+        }
+
+        while (active > 0) {
+            for (size_type i = 0; i < active; ) {
+                lane & l = lanes[i];
+                const_node_ptr t = l.node;
+                if (t == nullptr) {
+                    // Done; the lane moves on to its next key, or retires
+                    if (++l.next == l.end) {
+                        l = lanes[--active];
+                        continue;
+                    }
+                    while (l.turns > 0 && !comp( l.next->element.first, l.turned_left[l.turns - 1]->element.first ))
+                        l.turns--;
+                    l.node = l.turns > 0 ? l.turned_left[l.turns - 1]->left : _root;
+                    l.successor = false;
+                } else if (l.successor) {
+                    if (l.turns < batch_turns)
+                        l.turned_left[l.turns++] = t;
+                    l.node = t->left;
+                } else {
+                    // Random keys would mispredict a branch on the way
+                    // down, so both comparisons are made and the child
+                    // is picked by index; only a match branches
+                    bool before = comp( l.next->element.first, t->element.first );
+                    bool after = comp( t->element.first, l.next->element.first );
+                    if (before != after) {
+                        const_node_ptr children[2] = { t->left, t->right };
+                        l.turned_left[l.turns] = t;
+                        l.turns += before && l.turns < batch_turns;
+                        l.node = children[after];
+                    } else if (l.next->kind == op::erase && t->left != nullptr) {
+                        l.node = t->right;
+                        l.successor = true;
+                    } else {
+                        found = t;
+                        l.node = nullptr;
+                    }
+                }
+                prefetch_node( l.node );
+                i++;
+            }
+        }
+        static_cast<void>( found );
+    }
+
+    // Starts loading n, which may be null. A node need not sit within one
+    // cache line, so both its ends are fetched.
+    static void prefetch_node( const_node_ptr n ) {
+        #if defined(__GNUC__)
+        auto address = reinterpret_cast<std::uintptr_t>( n );
+        __builtin_prefetch( reinterpret_cast<const char *>( address ) );
+        __builtin_prefetch( reinterpret_cast<const char *>( address + sizeof( node ) - 1 ) );
+        #endif
+    }
+
+    /* Split, join and set algebra */
+
+    // A detached tree (its root has a null parent) and its rank: black
+    // height for red-black trees, height for AVL trees, unused otherwise
+    struct subtree {
+        node_ptr root = nullptr;
+        int rank = 0;
+    };
+
+    static subtree whole( node_ptr t ) { return { t, tree_rank(t) }; }
+
+    // Empties the tree without destroying its nodes, which another tree
+    // has taken over. Everything pointing at them goes, the cached
+    // largest node included.
+    void disown() {
+        _root = nullptr;
+        _size = 0;
+        _rightmost = nullptr;
+        if constexpr (std::is_same_v<Balance, balance::scapegoat>)
+            this->max_size = 0;
+    }
+
+    // Takes t, a detached tree of n nodes, as the whole tree, with the
+    // comparator and policy state of from
+    void adopt( node_ptr t, size_type n, const BinarySearchTree & from ) {
+        comp = from.comp;
+        static_cast<tree_metadata<Balance> &>(*this) = from;
+        if constexpr (std::is_same_v<Balance, balance::scapegoat>)
+            this->max_size = n;
+        _root = t;
+        _size = n;
+        _rightmost = nullptr;
+    }
+
+    // Size of a, where a and b hold n nodes between them. Without counts
+    // the two are walked in step until the smaller one runs out.
+    size_type size_of_first( node_ptr a, node_ptr b, size_type n ) const {
+        if constexpr (ranked) {
+            return node_count(a);
+        } else if constexpr (!parent_linked) {
+            // No way to step through a detached tree: count a in full
+            return subtree_size(a);
+        } else {
+            const_iterator x( a == nullptr ? nullptr : min(a), this );
+            const_iterator y( b == nullptr ? nullptr : min(b), this );
+            for (size_type k = 0; ; k++, ++x, ++y) {
+                if (x == const_iterator())
+                    return k;
+                if (y == const_iterator())
+                    return n - k;
+            }
+        }
+    }
+
+    static void link_children( node_ptr k, node_ptr l, node_ptr r ) {
+        k->left = l;
+        k->right = r;
+        if (l != nullptr)
+            set_parent(l, k);
+        if (r != nullptr)
+            set_parent(r, k);
+    }
+
+    // Black height of a red-black tree, height of an AVL tree
+    static int tree_rank( const_node_ptr t ) {
+        if constexpr (std::is_same_v<Balance, balance::red_black>) {
+            int h = 0;
+            for (; t != nullptr; t = t->left)
+                h += !t->red;
+            return h;
+        } else if constexpr (std::is_same_v<Balance, balance::avl>) {
+            return height(t);
+        } else {
+            return 0;
+        }
+    }
+
+    // Cuts a child t loose as a tree of its own, with a null parent and,
+    // on a red-black tree, a black root. below is the black height it had
+    // in place.
+    static subtree cut_subtree( node_ptr t, int below ) {
+        if (t == nullptr)
+            return {};
+        set_parent(t, nullptr);
+        if constexpr (std::is_same_v<Balance, balance::red_black>) {
+            if (t->red) {
+                t->red = false;
+                return { t, below + 1 };
+            }
+            return { t, below };
+        } else {
+            return { t, tree_rank(t) };
+        }
+    }
+
+    // Separates the root of t from its two subtrees, leaving it bare
+    static void expose( subtree t, subtree & l, subtree & r ) {
+        node_ptr k = t.root;
+        int below = t.rank;
+        if constexpr (std::is_same_v<Balance, balance::red_black>)
+            below -= !k->red;
+        l = cut_subtree(k->left, below);
+        r = cut_subtree(k->right, below);
+        k->left = k->right = nullptr;
+        update_count(k);
+    }
+
+    // Splits t into the keys ordered before key and those after it. The
+    // node holding key, if any, is returned bare, in neither part.
+    node_ptr split_nodes( subtree t, const key_type & key, subtree & lt, subtree & gt ) {
+        node_ptr eq = nullptr;
+        if constexpr (std::is_same_v<Balance, balance::splay>) {
+            bool found;
+            node_ptr r = splay(key, t.root, found);
+            lt = gt = { r, 0 };
+            if (r == nullptr)
+                return nullptr;
+            // The root is the key or a neighbour of it; cut beside it
+            if (found) {
+                eq = r;
+                lt.root = r->left;
+                gt.root = r->right;
+                r->left = r->right = nullptr;
+            } else if (comp(r->element.first, key)) {
+                gt.root = r->right;
+                r->right = nullptr;
+            } else {
+                lt.root = r->left;
+                r->left = nullptr;
+            }
+            update_count(r);
+            if (lt.root != nullptr)
+                set_parent(lt.root, nullptr);
+            if (gt.root != nullptr)
+                set_parent(gt.root, nullptr);
+        } else if constexpr (std::is_same_v<Balance, balance::red_black> || std::is_same_v<Balance, balance::avl>) {
+            eq = balanced_split(t, key, lt, gt);
+        } else {
+            // Treap, scapegoat and unbalanced trees: unzip the search path
+            eq = treap_split(t.root, key, lt.root, gt.root);
+            if (eq != nullptr) {
+                eq->left = eq->right = nullptr;
+                set_parent(eq, nullptr);
+                update_count(eq);
+            }
+        }
+        return eq;
+    }
+
+    // Joins l, the bare node k and r, where the keys of l precede k and
+    // those of r follow it
+    subtree join_with( subtree l, node_ptr k, subtree r ) {
+        if constexpr (std::is_same_v<Balance, balance::red_black> || std::is_same_v<Balance, balance::avl>) {
+            return join3(l, k, r);
+        } else if constexpr (std::is_same_v<Balance, balance::treap>) {
+            return { treap_join(treap_join(l.root, k), r.root), 0 };
+        } else {
+            link_children(k, l.root, r.root);
+            set_parent(k, nullptr);
+            update_count(k);
+            return { k, 0 };
+        }
+    }
+
+    // Joins l and r, every key of l ordered before every key of r
+    subtree join_nodes( subtree l, subtree r ) {
+        if (l.root == nullptr || r.root == nullptr)
+            return l.root != nullptr ? l : r;
+
+        if constexpr (std::is_same_v<Balance, balance::treap>) {
+            return { treap_join(l.root, r.root), 0 };
+        } else if constexpr (std::is_same_v<Balance, balance::splay>) {
+            bool found;
+            node_ptr m = splay(max(l.root)->element.first, l.root, found);
+            m->right = r.root;
+            set_parent(r.root, m);
+            update_count(m);
+            return { m, 0 };
+        } else if constexpr (std::is_same_v<Balance, balance::red_black> || std::is_same_v<Balance, balance::avl>) {
+            // Take the smallest node of r out with the usual fixups, then
+            // join the two trees around it
+            node_ptr * path[MAX_BALANCED_HEIGHT];
+            size_type depth = 0;
+            node_ptr root = r.root;
+            path[0] = &root;
+            while ((*path[depth])->left != nullptr) {
+                path[depth + 1] = &(*path[depth])->left;
+                depth++;
+            }
+            node_ptr m = detach_at(path, depth);
+            if (root != nullptr)
+                set_parent(root, nullptr);
+            m->left = m->right = nullptr;
+            update_count(m);
+            return join3(l, m, whole(root));
+        } else {
+            // The largest node of l becomes the root over both
+            node_ptr rest = l.root, above = nullptr, m = l.root;
+            while (m->right != nullptr) {
+                above = m;
+                m = m->right;
+            }
+            if (above != nullptr) {
+                above->right = m->left;
+                if (m->left != nullptr)
+                    set_parent(m->left, above);
+                recount_upward(above);
+            } else {
+                rest = rest->left;
+            }
+            link_children(m, rest, r.root);
+            set_parent(m, nullptr);
+            update_count(m);
+            return { m, 0 };
+        }
+    }
+
+    // Joins l, the bare node k and r into one red-black or AVL tree. k
+    // goes where the inner spine of the taller tree comes down to the
+    // rank of the shorter one, and the insert fixup runs above it, so the
+    // cost is the difference in rank.
+    subtree join3( subtree l, node_ptr k, subtree r ) {
+        constexpr bool rb = std::is_same_v<Balance, balance::red_black>;
+        if (rb ? l.rank == r.rank : std::abs(l.rank - r.rank) <= 1) {
+            link_children(k, l.root, r.root);
+            set_parent(k, nullptr);
+            update_count(k);
+            if constexpr (rb) {
+                k->red = false;
+                return { k, l.rank + 1 };
+            } else {
+                update_height(k);
+                return { k, k->height };
+            }
+        }
+
+        bool taller_left = l.rank > r.rank;
+        int target = taller_left ? r.rank : l.rank;
+        int h = taller_left ? l.rank : r.rank;
+        node_ptr root = taller_left ? l.root : r.root;
+        node_ptr * path[MAX_BALANCED_HEIGHT];
+        size_type depth = 0;
+        node_ptr parent = nullptr;
+        path[0] = &root;
+
+        for (node_ptr c = root; c != nullptr; c = *path[depth]) {
+            if constexpr (rb) {
+                if (!c->red && h == target)
+                    break;
+                h -= !c->red;
+            } else if (c->height <= target + 1) {
+                break;
+            }
+            parent = c;
+            path[depth + 1] = taller_left ? &c->right : &c->left;
+            depth++;
+        }
+
+        node_ptr c = *path[depth];
+        if (taller_left)
+            link_children(k, c, r.root);
+        else
+            link_children(k, l.root, c);
+        set_parent(k, parent);
+        *path[depth] = k;
+        update_count(k);
+        recount_upward(parent);
+
+        if constexpr (rb) {
+            k->red = true;
+            int rank = std::max(l.rank, r.rank) + rb_insert_fixup(path, depth);
+            return { root, rank };
+        } else {
+            update_height(k);
+            avl_fixup(path, depth);
+            return { root, root->height };
+        }
+    }
+
+    // Red-black and AVL split: walks down to key, then back up joining
+    // each node on the path with its other subtree onto the side of key
+    // it belongs to. The ranks joined on each side grow as the walk
+    // climbs, so the joins cost O(log n) in total.
+    node_ptr balanced_split( subtree s, const key_type & key, subtree & lt, subtree & gt ) {
+        node_ptr path[MAX_BALANCED_HEIGHT];
+        bool went_left[MAX_BALANCED_HEIGHT];
+        int below[MAX_BALANCED_HEIGHT];
+        size_type depth = 0;
+        node_ptr eq = nullptr;
+
+        // Black height of the subtree at t; unused by AVL trees
+        node_ptr t = s.root;
+        int bh = s.rank;
+        while (t != nullptr) {
+            int child_bh = bh;
+            if constexpr (std::is_same_v<Balance, balance::red_black>)
+                child_bh -= !t->red;
+
+            if (comp(key, t->element.first)) {
+                went_left[depth] = true;
+            } else if (comp(t->element.first, key)) {
+                went_left[depth] = false;
+            } else {
+                eq = t;
+                break;
+            }
+            path[depth] = t;
+            below[depth++] = child_bh;
+            t = went_left[depth - 1] ? t->left : t->right;
+            bh = child_bh;
+        }
+
+        subtree l, g;
+        if (eq != nullptr)
+            expose({ eq, bh }, l, g);
+
+        for (size_type i = depth; i-- > 0; ) {
+            node_ptr n = path[i];
+            if (went_left[i]) {
+                subtree right = cut_subtree(n->right, below[i]);
+                g = join3(g, n, right);
+            } else {
+                subtree left = cut_subtree(n->left, below[i]);
+                l = join3(left, n, l);
+            }
+        }
+
+        lt = l;
+        gt = g;
+        return eq;
+    }
+
+    enum class set_op { merge_union, intersect, difference };
+
+    // Shared by the set operations
+    struct set_state {
+        ThreadPool & pool;
+        std::vector<node_ptr> discard; // bare nodes and whole subtrees
+        size_type matches = 0;         // keys found in both trees
+    };
+
+    // Combines the detached trees a and b: splits a at the key of b's
+    // root, combines the two sides recursively and joins the results
+    // around the root, or around a's node with that key. Forks the two
+    // sides onto the pool while forks lasts. Nodes that drop out go on
+    // state.discard; keys found in both trees are counted in
+    // state.matches.
+    template <set_op Op>
+    subtree combine( subtree a, subtree b, int forks, set_state & state ) {
+        if (a.root == nullptr || b.root == nullptr) {
+            subtree kept = Op == set_op::merge_union ? (a.root != nullptr ? a : b)
+                         : Op == set_op::difference  ? a
+                         :                             subtree{};
+            for (node_ptr t : { a.root, b.root })
+                if (t != nullptr && t != kept.root)
+                    state.discard.push_back(t);
+            return kept;
+        }
+
+        node_ptr k = b.root;
+        subtree bl, br, al, ar;
+        expose(b, bl, br);
+        node_ptr eq = split_nodes(a, k->element.first, al, ar);
+
+        subtree l, r;
+        if (forks > 0) {
+            set_state right_state{ state.pool, {}, 0 };
+            state.pool.fork_join(
+                [&] { l = combine<Op>(al, bl, forks - 1, state); },
+                [&] { r = combine<Op>(ar, br, forks - 1, right_state); });
+            state.discard.insert(state.discard.end(), right_state.discard.begin(), right_state.discard.end());
+            state.matches += right_state.matches;
+        } else {
+            l = combine<Op>(al, bl, 0, state);
+            r = combine<Op>(ar, br, 0, state);
+        }
+
+        // Where both hold the key the element of a is kept
+        node_ptr mid = nullptr;
+        if (eq != nullptr)
+            state.matches++;
+        if constexpr (Op == set_op::merge_union) {
+            mid = eq != nullptr ? eq : k;
+            if (eq != nullptr)
+                state.discard.push_back(k);
+        } else if constexpr (Op == set_op::intersect) {
+            mid = eq;
+            state.discard.push_back(k);
+        } else {
+            if (eq != nullptr)
+                state.discard.push_back(eq);
+            state.discard.push_back(k);
+        }
+        return mid != nullptr ? join_with(l, mid, r) : join_nodes(l, r);
+    }
+
+    template <set_op Op>
+    static BinarySearchTree set_algebra( BinarySearchTree && a, BinarySearchTree && b, ThreadPool & pool ) {
+        static_assert(std::is_same_v<Storage, storage::heap>, "only heap nodes can move between trees");
+        BinarySearchTree result( std::move( a ) );
+        BinarySearchTree other( std::move( b ), result.get_allocator() );
+
+        // Unbalanced and splay trees may be arbitrarily deep; give the
+        // recursion logarithmic depth
+        if constexpr (std::is_same_v<Balance, balance::none> || std::is_same_v<Balance, balance::splay>) {
+            rebuild(result._root, result._size);
+            rebuild(other._root, other._size);
+        }
+
+        // Enough forks near the top to keep every thread busy
+        int forks = 0;
+        for (unsigned n = pool.size(); n > 1; n = (n + 1) / 2)
+            forks++;
+        if (forks > 0)
+            forks += 3;
+
+        size_type n_a = result._size, n_b = other._size;
+        set_state state{ pool, {}, 0 };
+        subtree combined = result.template combine<Op>(whole(result._root), whole(other._root), forks, state);
+        result.disown();
+        other.disown();
+
+        for (node_ptr t : state.discard) {
+            set_parent(t, nullptr);
+            result.clear(t);
+        }
+
+        size_type n = Op == set_op::merge_union ? n_a + n_b - state.matches
+                    : Op == set_op::intersect   ? state.matches
+                    :                             n_a - state.matches;
+        result.adopt(combined.root, n, result);
+        return result;
+    }
+
+    // Removes the node at *link from an unbalanced tree
+    void unlink( node_ptr * link ) {
+        // two children --> take over the successor's element and unlink
+        // the successor, which has no left child, instead
+        node_ptr t = *link;
+        if (t->left != nullptr && t->right != nullptr) {
+            link = &t->right;
+            while ((*link)->left != nullptr)
+                link = &(*link)->left;
+            t->element = std::move((*link)->element);
+            t = *link;
+        }
+
+        // at most one child --> it takes the node's place
+        node_ptr child = t->left != nullptr ? t->left : t->right;
+        *link = child;
+        if (child != nullptr)
+            set_parent(child, parent_of(t));
+        add_to_counts(parent_of(t), -1);
+        forget_rightmost(t);
+        _nodes.destroy(t);
+        _size--;
+    }
+
+    template <typename A, typename B>
+    bool equal_keys( const A & a, const B & b ) const {
+        return !comp(a, b) && !comp(b, a);
+    }
+
+    // One comparison per level: remember the last node the search turned
+    // left at, which is the smallest key not before (lower) or after
+    // (upper) the probe
+    template <typename Key>
+    const_node_ptr lower_bound_node( const Key & key ) const {
+        const_node_ptr t = _root, bound = nullptr;
+        while (t != nullptr) {
+            if (!comp(t->element.first, key)) {
+                bound = t;
+                t = t->left;
+            } else {
+                t = t->right;
+            }
+        }
+        return bound;
+    }
+    template <typename Key>
+    const_node_ptr upper_bound_node( const Key & key ) const {
+        const_node_ptr t = _root, bound = nullptr;
+        while (t != nullptr) {
+            if (comp(key, t->element.first)) {
+                bound = t;
+                t = t->left;
+            } else {
+                t = t->right;
+            }
+        }
+        return bound;
+    }
+    template <typename Key>
+    node_ptr lower_bound_node( const Key & key ) {
+        return const_cast<node_ptr>(static_cast<const BinarySearchTree &>(*this).lower_bound_node(key));
+    }
+    template <typename Key>
+    node_ptr upper_bound_node( const Key & key ) {
+        return const_cast<node_ptr>(static_cast<const BinarySearchTree &>(*this).upper_bound_node(key));
+    }
+
+    // The in-order successor (Next) or predecessor of t, which has no
+    // child on that side: the last node the search for t turned away
+    // from in that direction. For trees without parent links.
+    template <bool Next>
+    const_node_ptr neighbour( const_node_ptr t ) const {
+        const_node_ptr s = _root, bound = nullptr;
+        while (s != t) {
+            if (comp(t->element.first, s->element.first)) {
+                if (Next)
+                    bound = s;
+                s = s->left;
+            } else {
+                if (!Next)
+                    bound = s;
+                s = s->right;
+            }
+        }
+        return bound;
+    }
+
+    // Leftmost and rightmost nodes, or nullptr in an empty tree
+    node_ptr min_node() { return _root == nullptr ? nullptr : const_cast<node_ptr>(min(_root)); }
+    node_ptr max_node() { return _root == nullptr ? nullptr : const_cast<node_ptr>(max(_root)); }
+    const_node_ptr min_node() const { return _root == nullptr ? nullptr : min(_root); }
+    const_node_ptr max_node() const { return _root == nullptr ? nullptr : max(_root); }
+
+    /*
+        Order statistics
+        ----------------
+
+        With augment::order_statistics each node counts the nodes of its
+        subtree. Rotations recount the two nodes they move, and a node
+        linked in or unlinked adjusts the counts of its ancestors through
+        the parent pointers. Without the augmentation every helper here
+        is empty and compiles away.
+    */
+
+    static size_type node_count( const_node_ptr t ) {
+        if constexpr (ranked)
+            return t == nullptr ? 0 : t->count;
+        else
+            return 0;
+    }
+    static void update_count( node_ptr t ) {
+        if constexpr (ranked)
+            t->count = 1 + node_count(t->left) + node_count(t->right);
+    }
+    // Adds delta to the count of t and every node above it
+    static void add_to_counts( node_ptr t, int delta ) {
+        if constexpr (ranked) {
+            for (; t != nullptr; t = parent_of(t))
+                t->count += delta;
+        }
+    }
+    // Recounts t and every node above it, for when the nodes on a path
+    // have been given new children
+    static void recount_upward( node_ptr t ) {
+        if constexpr (ranked) {
+            for (; t != nullptr; t = parent_of(t))
+                update_count(t);
+        }
+    }
+
+    // Node holding the i-th smallest key (from 0), or nullptr
+    const_node_ptr select_node( size_type i ) const {
+        const_node_ptr t = _root;
+        while (t != nullptr) {
+            size_type left = node_count(t->left);
+            if (i < left) {
+                t = t->left;
+            } else if (i == left) {
+                return t;
+            } else {
+                i -= left + 1;
+                t = t->right;
+            }
+        }
+        return nullptr;
+    }
 
-  private:
-    struct BinaryNode
-    {
-        pair element;
-        BinaryNode *left;
-        BinaryNode *right;
+    const_node_ptr min( const_node_ptr t ) const {
+        // go left 
+        while (t->left != nullptr)
+            t = t->left;
+        return t;
+    }
+    const_node_ptr max( const_node_ptr t ) const {
+        // go right 
+        while (t->right != nullptr) {
+            BINARY_SEARCH_TREE_SPINE_STEP();
+            t = t->right;
+        }
+        return t;
+    }
 
-        BinaryNode( const_reference theElement, BinaryNode *lt, BinaryNode *rt )
-          : element{ theElement }, left{ lt }, right{ rt } { }
-        
-        BinaryNode( pair && theElement, BinaryNode *lt, BinaryNode *rt )
-          : element{ std::move( theElement ) }, left{ lt }, right{ rt } { }
-    };
+    template <typename Key>
+    bool contains( const Key & x, const_node_ptr t ) const {
+        // go left / right until equal or nullptr; x is a key!
+        while (t != nullptr) {
+            if (comp(x, t->element.first))
+                t = t->left;
+            else if (comp(t->element.first, x))
+                t = t->right;
+            else
+                return true;
+        }
+        return false;
+    }
+    template <typename Key>
+    node_ptr find( const Key & key, node_ptr t ) {
+        return const_cast<node_ptr>(find(key, const_cast<const_node_ptr>(t)));
+    }
+    template <typename Key>
+    const_node_ptr find( const Key & key, const_node_ptr t ) const {
+        while (t != nullptr) {
+            if (comp(key, t->element.first))
+                t = t->left;
+            else if (comp(t->element.first, key))
+                t = t->right;
+            else
+                return t;
+        }
+        return nullptr;
+    }
 
-    using node           = BinaryNode;
-    using node_ptr       = node*;
-    using const_node_ptr = const node*;
+    // Destroys the subtree t without recursion: while the top node has a
+    // left child, rotate that child up; once it has none, destroy it and
+    // carry on with its right subtree. Each rotation moves one node off
+    // the left spine for good, so the whole walk is O(n).
+    void clear( node_ptr & t ) {
+        while (t != nullptr) {
+            if (t->left != nullptr) {
+                rotate_right(t);
+            } else {
+                node_ptr right = t->right;
+                _nodes.destroy(t);
+                t = right;
+            }
+        }
+    }
 
-    node_ptr _root;
-    size_type _size;
-    key_compare comp;
+    // Copies the subtree t into this tree's storage
+    node_ptr clone( const_node_ptr t ) {
+        return clone<false>(const_cast<node_ptr>(t));
+    }
+    // Rebuilds the subtree in this tree's storage, moving the elements
+    // out of the original nodes
+    node_ptr clone_moving( node_ptr t ) {
+        return clone<true>(t);
+    }
 
-  public:
-    BinarySearchTree() : _root{nullptr}, _size{0}, comp{} { }
+    /* Parallel copies */
 
-    BinarySearchTree( const BinarySearchTree & rhs ) : _root{rhs._root}, _size{rhs._size}{  
-        _root = clone(rhs._root); 
+    static constexpr bool concurrent_nodes = std::is_same_v<Storage, storage::heap>
+        && std::is_same_v<Allocator, std::allocator<pair>>;
+
+    // Copies the subtree t of n nodes, on the shared pool if it is large
+    // enough to fork at all
+    node_ptr clone_parallel( const_node_ptr t, size_type n ) {
+        if (!concurrent_nodes || n < 2 * parallel_clone_grain)
+            return clone(t);
+        ThreadPool & pool = ThreadPool::shared();
+        return clone(t, pool, clone_forks(n, parallel_clone_grain, pool));
     }
 
-    BinarySearchTree( BinarySearchTree && rhs ) {
-        _root = std::move(rhs._root); // move the root 
-        _size = rhs._size; // update the size 
-        rhs._size = 0; // clear rhs 
-        rhs._root = nullptr; 
+    // Levels to fork: enough for a few tasks per thread, as in the set
+    // algebra, but none for subtrees expected to be below twice the grain
+    static int clone_forks( size_type n, size_type grain, const ThreadPool & pool ) {
+        if (!concurrent_nodes)
+            return 0;
+        int forks = 0;
+        for (unsigned threads = pool.size(); threads > 1; threads = (threads + 1) / 2)
+            forks++;
+        if (forks > 0)
+            forks += 3;
+        int levels = 0;
+        for (; n > 1 && n >= 2 * grain; n /= 2)
+            levels++;
+        return std::min(forks, levels);
     }
-    ~BinarySearchTree() {
-        clear(); 
+
+    // Copies t and forks the copies of its subtrees while forks lasts
+    node_ptr clone( const_node_ptr t, ThreadPool & pool, int forks ) {
+        if (forks == 0 || t == nullptr)
+            return clone(t);
+
+        node_ptr n = _nodes.create(static_cast<const_reference>(t->element), nullptr, nullptr);
+        static_cast<metadata &>(*n) = *t;
+        static_cast<augmentation &>(*n) = *t;
+        try {
+            pool.fork_join([&] { n->left = clone(t->left, pool, forks - 1); },
+                           [&] { n->right = clone(t->right, pool, forks - 1); });
+        } catch (...) {
+            // Whichever side was finished hangs off n
+            clear(n);
+            throw;
+        }
+        if (n->left != nullptr)
+            set_parent(n->left, n);
+        if (n->right != nullptr)
+            set_parent(n->right, n);
+        return n;
     }
 
-    const_reference min() const { return min( _root )->element; }
-    const_reference max() const { return max( _root )->element; }
-    const_reference root() const { return _root->element; }
+    template <typename It>
+    static constexpr bool is_forward_iterator =
+        std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>;
 
-    bool contains( const key_type & x ) const { return contains( x, _root ); }
-    value_type & find( const key_type & key ) { return find( key, _root )->element.second; }
-    const value_type & find( const key_type & key ) const { return find( key, _root )->element.second; }
-    bool empty() const {
-        return _size == 0;
+    template <typename It>
+    bool strictly_increasing( It first, It last ) const {
+        if (first == last)
+            return true;
+        for (It next = std::next( first ); next != last; first = next++)
+            if (!comp( first->first, next->first ))
+                return false;
+        return true;
     }
-    size_type size() const {
-        return _size;
+
+    /*
+        Builds a balanced tree over n sorted elements, consuming them in
+        order. The tree over ranks [lo, hi) has the middle rank at its
+        root and the two halves as subtrees; the walk is an in-order
+        traversal of that implicit shape, so each element becomes the
+        next node created. Each frame on the explicit stack is a pending
+        middle node: before it is created its left half is being built,
+        afterwards its right half is. The stack never holds more than
+        log2(n) + 1 frames.
+
+        Subtree sizes of siblings differ by at most one, so every empty
+        link hangs at the last or second-to-last level. Making the last
+        level red (when it is not full) and everything else black is
+        therefore a valid red-black colouring, and heap-ordered treap
+        priorities come from giving each level its own band.
+    */
+    template <typename It>
+    void build_balanced( It first, size_type n ) {
+        struct frame {
+            size_type mid, hi;
+            unsigned depth;
+            node_ptr node;
+        };
+        frame stack[std::numeric_limits<size_type>::digits + 1];
+        size_type top = 0;
+
+        if (n == 0)
+            return;
+
+        unsigned deepest = 0;
+        while ((n >> deepest) > 1)
+            deepest++;
+        bool perfect = ((n + 1) & n) == 0;
+
+        node_ptr built = nullptr; // the subtree just finished, not yet linked
+        size_type lo = 0, hi = n;
+        unsigned depth = 0;
+
+        try {
+            while (true) {
+                while (lo < hi) {
+                    size_type mid = lo + (hi - lo) / 2;
+                    stack[top++] = { mid, hi, depth++, nullptr };
+                    hi = mid;
+                }
+
+                // Frames whose right half is done are complete subtrees
+                while (top > 0 && stack[top - 1].node != nullptr) {
+                    frame & f = stack[--top];
+                    f.node->right = built;
+                    if (built != nullptr)
+                        set_parent(built, f.node);
+                    finish_built_node(f.node, f.depth, deepest, perfect);
+                    built = f.node;
+                }
+                if (top == 0)
+                    break;
+
+                // The next element is the middle of the top frame
+                frame & f = stack[top - 1];
+                f.node = _nodes.create(*first, built, nullptr);
+                ++first;
+                if (built != nullptr)
+                    set_parent(built, f.node);
+                built = nullptr;
+
+                lo = f.mid + 1;
+                hi = f.hi;
+                depth = f.depth + 1;
+            }
+        } catch (...) {
+            // Hang what was built off the created frames and free it
+            while (top > 0) {
+                frame & f = stack[--top];
+                if (f.node != nullptr) {
+                    f.node->right = built;
+                    built = f.node;
+                }
+            }
+            clear(built);
+            throw;
+        }
+
+        _root = built;
+        _size = n;
+        _rightmost = nullptr;
+        if constexpr (std::is_same_v<Balance, balance::scapegoat>)
+            this->max_size = n;
     }
 
-    void clear() {
-        clear( _root );
-        _size = 0;
+    // Fills in the bookkeeping of a node whose subtrees are complete
+    void finish_built_node( node_ptr t, unsigned depth, unsigned deepest, bool perfect ) {
+        if constexpr (std::is_same_v<Balance, balance::red_black>) {
+            t->red = depth == deepest && !perfect;
+        } else if constexpr (std::is_same_v<Balance, balance::avl>) {
+            update_height(t);
+        } else if constexpr (std::is_same_v<Balance, balance::treap>) {
+            uint64_t band = (uint64_t(1) << 32) / (deepest + 1);
+            t->priority = static_cast<uint32_t>((deepest - depth) * band + (this->rng() >> 32) % band);
+        }
+        update_count(t);
     }
-    void insert( const_reference x ) { insert( x, _root ); }
-    void insert( pair && x ) { insert( std::move( x ), _root ); }
-    void erase( const key_type & x ) { erase(x, _root); }
 
-    BinarySearchTree & operator=( const BinarySearchTree & rhs ) {
-        if (&rhs == this) return *this; 
-        this->clear();
-        this->_size = rhs._size; 
-        this->_root = clone(rhs._root);
-        return *this;  
+    // Copies whose children are still to be made form a stack threaded
+    // through the copies themselves: left holds the node being copied and
+    // right the next copy on the stack. Cloning therefore needs no
+    // recursion and no memory besides the new nodes.
+    template <bool Move>
+    node_ptr clone( node_ptr t ) {
+        node_ptr root = nullptr;
+        node_ptr pending = nullptr;
+
+        try {
+            if (t != nullptr)
+                root = copy_node<Move>(t, pending);
+
+            while (pending != nullptr) {
+                node_ptr c = pending;
+                node_ptr source = c->left;
+                pending = c->right;
+                c->left = c->right = nullptr;
+
+                if (source->left != nullptr) {
+                    c->left = copy_node<Move>(source->left, pending);
+                    set_parent(c->left, c);
+                }
+                if (source->right != nullptr) {
+                    c->right = copy_node<Move>(source->right, pending);
+                    set_parent(c->right, c);
+                }
+            }
+        } catch (...) {
+            // Cut the unfinished copies loose from the original before
+            // freeing what was built
+            while (pending != nullptr) {
+                node_ptr c = pending;
+                pending = c->right;
+                c->left = c->right = nullptr;
+            }
+            clear(root);
+            throw;
+        }
+        return root;
     }
-    BinarySearchTree & operator=( BinarySearchTree && rhs ) {
-        if (&rhs == this) return *this; 
-        this->clear();
-        this->_size = rhs._size; 
-        this->_root = std::move(rhs._root);
-        rhs._size = 0; 
-        rhs._root = nullptr;  
-        return *this;  
+    template <bool Move>
+    node_ptr copy_node( node_ptr source, node_ptr & pending ) {
+        node_ptr n;
+        if constexpr (Move)
+            n = _nodes.create(std::move(source->element), source, pending);
+        else
+            n = _nodes.create(static_cast<const_reference>(source->element), source, pending);
+        static_cast<metadata &>(*n) = *source; // balancing bookkeeping travels with the node
+        static_cast<augmentation &>(*n) = *source;
+        pending = n;
+        return n;
     }
 
-  private:
-    void insert( const_reference x, node_ptr & t ) {
+    // Visits the nodes under t in key order
+    template <typename F>
+    static void in_order( node_ptr t, F && visit ) {
+        walk_in_order(t, [&](node_ptr n, size_type) { visit(n); });
+    }
 
-        // const_reference = const pair& therefore x contains the new element to add  
-        
-        // if t = nullptr --> insert right there  
-        if (t == nullptr) {
-            BinaryNode* newNode = new BinaryNode(x, nullptr, nullptr);// element{ theElement }, left{ lt }, right{ rt }
-            t = newNode;
-            _size++;
-        }
-        // if less than node --> go left; if not left --> insert 
-        else if (comp(x.first, t->element.first)) {
-            insert(x, t->left); 
+    /*
+        Visits the nodes under t in key order, or in reverse when Reverse,
+        as visit(node, depth) with depth counted from t. Climbs back up
+        through the parent pointers, so it needs no stack at all.
+
+        Without parent links the nodes still to be visited on the way
+        back up wait on a stack. The policy bounds the height (see
+        parent_links), so the stack has a fixed size and lives in the
+        frame. The tree is only read, so const trees may be walked from
+        several threads at once.
+    */
+    template <bool Reverse = false, typename N, typename F>
+    static void walk_in_order( N t, F && visit ) {
+        auto first = [](N n) -> N { return Reverse ? n->right : n->left; };
+        auto second = [](N n) -> N { return Reverse ? n->left : n->right; };
+        if (t == nullptr)
+            return;
+        if constexpr (!parent_linked) {
+            struct frame { N node; size_type depth; } stack[MAX_BALANCED_HEIGHT];
+            size_type top = 0, depth = 0;
+            for (;;) {
+                for (; t != nullptr; t = first(t), depth++)
+                    stack[top++] = { t, depth };
+                if (top == 0)
+                    return;
+                frame f = stack[--top];
+                visit(f.node, f.depth);
+                t = second(f.node);
+                depth = f.depth + 1;
+            }
         }
-        // if greater than node --> go right; if not right --> insert 
-        else if (comp(t->element.first, x.first)) {
-            insert(x, t->right);
+        const N top = t;
+        size_type depth = 0;
+
+        for (;;) {
+            while (first(t) != nullptr) {
+                t = first(t);
+                depth++;
+            }
+            for (;;) {
+                visit(t, depth);
+                if (second(t) != nullptr) {
+                    t = second(t);
+                    depth++;
+                    break;
+                }
+                // Climb until arriving from the first side; that node
+                // is the next one
+                N from;
+                do {
+                    if (t == top)
+                        return;
+                    from = t;
+                    t = parent_of(t);
+                    depth--;
+                } while (second(t) == from);
+            }
         }
-        // if equal node --> update value 
-        else if (x.first == t->element.first) {
-            t->element.second = x.second; 
+    }
+
+    // Visits the nodes under t in pre-order as visit(node, parent), where
+    // parent is the one given for t itself. Climbs through the parent
+    // pointers, or keeps a fixed stack, like walk_in_order.
+    template <typename N, typename F>
+    static void walk_pre_order( N t, N parent, F && visit ) {
+        if constexpr (!parent_linked) {
+            // Right subtrees wait on the stack while the left ones are
+            // walked; at most one per level of the path
+            struct frame { N node, parent; } stack[MAX_BALANCED_HEIGHT];
+            size_type top = 0;
+            while (t != nullptr) {
+                visit(t, parent);
+                if (t->left != nullptr) {
+                    if (t->right != nullptr)
+                        stack[top++] = { t->right, t };
+                    parent = t;
+                    t = t->left;
+                } else if (t->right != nullptr) {
+                    parent = t;
+                    t = t->right;
+                } else if (top > 0) {
+                    t = stack[top - 1].node;
+                    parent = stack[top - 1].parent;
+                    top--;
+                } else {
+                    t = nullptr;
+                }
+            }
+            return;
         }
-        else {
-            cout << "WHY HERE IN INSERT?" << endl; 
+        const N top = t;
+        while (t != nullptr) {
+            visit(t, t == top ? parent : parent_of(t));
+            if (t->left != nullptr) {
+                t = t->left;
+            } else if (t->right != nullptr) {
+                t = t->right;
+            } else {
+                // Up to the nearest ancestor with a right subtree to come
+                for (;;) {
+                    if (t == top)
+                        return;
+                    N from = t;
+                    t = parent_of(t);
+                    if (from == t->left && t->right != nullptr) {
+                        t = t->right;
+                        break;
+                    }
+                }
+            }
         }
+    }
 
+    /*
+        Balancing helpers
+        -----------------
+
+        The balanced insert and erase routines descend iteratively and
+        record the path as a list of links (the node_ptr fields which
+        point at each node on the path, starting with &_root). A
+        rotation through a link rewires the parent in place, so the
+        fixups never need to read parent pointers; the rotations keep
+        them up to date for the iterators.
+    */
+
+    static void rotate_left( node_ptr & t ) {
+        node_ptr r = t->right;
+        t->right = r->left;
+        if (r->left != nullptr)
+            set_parent(r->left, t);
+        r->left = t;
+        set_parent(r, parent_of(t));
+        set_parent(t, r);
+        update_count(t);
+        update_count(r);
+        t = r;
     }
-    void insert( pair && x, node_ptr & t ) {
-        // if t = nullptr --> insert right there  
-        if (t == nullptr) {
-            BinaryNode* newNode = new BinaryNode(std::move(x), nullptr, nullptr);// element{ theElement }, left{ lt }, right{ rt }
-            t = newNode;
-            _size++;
+    static void rotate_right( node_ptr & t ) {
+        node_ptr l = t->left;
+        t->left = l->right;
+        if (l->right != nullptr)
+            set_parent(l->right, t);
+        l->right = t;
+        set_parent(l, parent_of(t));
+        set_parent(t, l);
+        update_count(t);
+        update_count(l);
+        t = l;
+    }
+
+    // Descends to the slot for x recording the links on the way. Returns
+    // true after linking a new node at path[depth]; returns false after
+    // overwriting the value when the key is already present.
+    template <typename P>
+    bool insert_path( P && x, node_ptr ** path, size_type & depth ) {
+        node_ptr * link = &_root;
+        node_ptr parent = nullptr;
+        depth = 0;
+
+        while (*link != nullptr) {
+            path[depth++] = link;
+            node_ptr t = *link;
+            parent = t;
+            if (comp(x.first, t->element.first))
+                link = &t->left;
+            else if (comp(t->element.first, x.first))
+                link = &t->right;
+            else {
+                t->element.second = std::forward<P>(x).second;
+                return false;
+            }
         }
-        // if less than node --> go left; if not left --> insert 
-        else if (comp(x.first, t->element.first)) {
-            insert(std::move(x), t->left); 
+
+        *link = _nodes.create(std::forward<P>(x), nullptr, nullptr, parent);
+        track_rightmost(*link, link, parent);
+        _size++;
+        add_to_counts(parent, 1);
+        path[depth] = link;
+        return true;
+    }
+
+    // Descends to the node with key x recording the links on the way. A
+    // node with two children trades elements with its successor so that
+    // the node left at path[depth] has at most one child. Returns false
+    // if the key is not present.
+    template <typename Key>
+    bool erase_path( const Key & x, node_ptr ** path, size_type & depth ) {
+        node_ptr * link = &_root;
+        depth = 0;
+
+        while (*link != nullptr) {
+            path[depth] = link;
+            node_ptr t = *link;
+            if (comp(x, t->element.first))
+                link = &t->left;
+            else if (comp(t->element.first, x))
+                link = &t->right;
+            else
+                break;
+            depth++;
         }
-        // if greater than node --> go right; if not right --> insert 
-        else if (comp(t->element.first, x.first)) {
-            insert(std::move(x), t->right);
+        if (*link == nullptr)
+            return false;
+
+        node_ptr target = *link;
+        if (target->left != nullptr && target->right != nullptr) {
+            link = &target->right;
+            path[++depth] = link;
+            while ((*link)->left != nullptr) {
+                link = &(*link)->left;
+                path[++depth] = link;
+            }
+            std::swap(target->element, (*link)->element);
         }
-        // if equal node --> update value 
-        else if (x.first == t->element.first) {
-            t->element = std::move(x); 
+        return true;
+    }
+
+    template <typename P>
+    void insert_balanced( P && x ) {
+        if constexpr (std::is_same_v<Balance, balance::treap>) {
+            treap_insert(std::forward<P>(x));
+        } else if constexpr (std::is_same_v<Balance, balance::splay>) {
+            splay_insert(std::forward<P>(x));
+        } else {
+            node_ptr * path[MAX_BALANCED_HEIGHT];
+            size_type depth;
+
+            if (insert_path(std::forward<P>(x), path, depth))
+                insert_fixup(path, depth);
         }
-        else {
-            cout << "WHY HERE IN INSERT MOVE?" << endl; 
+    }
+
+    // Restores the policy's invariant after linking the node at path[depth]
+    void insert_fixup( node_ptr ** path, size_type depth ) {
+        if constexpr (std::is_same_v<Balance, balance::red_black>) {
+            rb_insert_fixup(path, depth);
+        } else if constexpr (std::is_same_v<Balance, balance::avl>) {
+            avl_fixup(path, depth);
+        } else if constexpr (std::is_same_v<Balance, balance::scapegoat>) {
+            scapegoat_insert_fixup(path, depth);
+        } else if constexpr (std::is_same_v<Balance, balance::treap>) {
+            // Rotate the node up past every parent of lower priority
+            for (; depth > 0 && (*path[depth])->priority > (*path[depth - 1])->priority; depth--) {
+                if (path[depth] == &(*path[depth - 1])->left)
+                    rotate_right(*path[depth - 1]);
+                else
+                    rotate_left(*path[depth - 1]);
+            }
         }
+    }
 
-        
+    template <typename Key>
+    bool erase_balanced( const Key & x ) {
+        if constexpr (std::is_same_v<Balance, balance::treap>)
+            return treap_erase(x);
+        else if constexpr (std::is_same_v<Balance, balance::splay>)
+            return splay_erase(x);
+
+        node_ptr * path[MAX_BALANCED_HEIGHT];
+        size_type depth;
+
+        if (!erase_path(x, path, depth))
+            return false;
+        erase_at(path, depth);
+        return true;
     }
 
-    void erase( const key_type & x, node_ptr & t ) {
+    // Unlinks and destroys the node at path[depth], which has at most one
+    // child, and restores the policy's invariant
+    void erase_at( node_ptr ** path, size_type depth ) {
+        _nodes.destroy(remove_at(path, depth));
+    }
 
-        if (t == nullptr) {
-            cout << "Couldn't find the key"; 
-        }
-        // if less than node --> go left; if left is equal to key  
-        else if (comp(x, t->element.first)) {
-            erase(x, t->left); 
-        }
-        // if greater than node --> go right; if right is equal to key
-        else if (comp(t->element.first, x)) {
-            erase(x, t->right); 
-        }
-        // if equal node --> figure out the deleting process  
-        else {//(x.first == t->element.first) 
-            
-            // case 1 -- no children; parent node left /right = nullptr  -- ????? 
-            if (t->left == nullptr && t->right == nullptr) {
-                node_ptr OG_node = t; 
-                t=nullptr;
-                delete OG_node; 
-                _size--; 
-            }
-
-            // case 2 -- one child; replace parent node left/right with the single child 
-            else if (t->left == nullptr) {
-                node_ptr OG_node = t;  
-                node_ptr rightNode = t->right; 
-                t = rightNode; 
-                delete OG_node; 
-                _size--;
-            }
-            else if (t->right == nullptr) {
-                node_ptr OG_node = t; 
-                node_ptr leftNode = t->left; 
-                t = leftNode; 
-                delete OG_node; 
-                _size--; 
-            }
-
-            // case 3 -- two children; right subtree and find leftmost node(min) and that is now the root 
-            else {
-                const_node_ptr swapNode = min(t->right); 
-                t->element = swapNode->element; 
-                erase(swapNode->element.first, t->right); 
+    // erase_at short of destroying the node, which is returned
+    node_ptr remove_at( node_ptr ** path, size_type depth ) {
+        node_ptr target = detach_at(path, depth);
+        forget_rightmost(target);
+        _size--;
+
+        if constexpr (std::is_same_v<Balance, balance::scapegoat>) {
+            // Rebuild everything once the tree shrinks below 2/3 of the
+            // size it was last balanced for
+            if (3 * _size < 2 * this->max_size) {
+                rebuild(_root, _size);
+                this->max_size = _size;
             }
         }
-
+        return target;
     }
 
-    /*
-    node_ptr & parent_of_del; // reference to parent 
-        node_ptr & to_delete; // reference to thing to delete 
+    // Unlinks the node at path[depth], which has at most one child, and
+    // runs the red-black or AVL fixup above it. Returns the node, which
+    // still counts towards _size.
+    node_ptr detach_at( node_ptr ** path, size_type depth ) {
+        node_ptr target = *path[depth];
+        node_ptr child = target->left != nullptr ? target->left : target->right;
+        *path[depth] = child;
+        if (child != nullptr)
+            set_parent(child, parent_of(target));
+        add_to_counts(parent_of(target), -1);
 
-        // traverse to parent of thing you wanna erase  
-        if (t == nullptr) {
-            cout << "Couldn't find the key"; 
+        if constexpr (std::is_same_v<Balance, balance::red_black>) {
+            if (!target->red)
+                rb_erase_fixup(path, depth);
+        } else if constexpr (std::is_same_v<Balance, balance::avl>) {
+            avl_fixup(path, depth);
         }
-        // if less than node --> go left; if left is equal to key --> update to_delete parent  
-        else if (comp(x, t->element.first)) {
-            if (t->left.element.first == x) 
-                parent_of_del = &t; 
-            erase(x, t->left); 
+        return target;
+    }
+
+    /* Red-black */
+
+    static bool is_red( const_node_ptr t ) { return t != nullptr && t->red; }
+
+    // The red node at path[depth] may have a red parent. Returns whether
+    // the black height of the tree under path[0] grew.
+    bool rb_insert_fixup( node_ptr ** path, size_type depth ) {
+        while (depth >= 2 && is_red(*path[depth - 1])) {
+            node_ptr parent = *path[depth - 1];
+            node_ptr grand = *path[depth - 2];
+
+            if (parent == grand->left) {
+                node_ptr uncle = grand->right;
+                if (is_red(uncle)) {
+                    parent->red = uncle->red = false;
+                    grand->red = true;
+                    depth -= 2;
+                    continue;
+                }
+                if (*path[depth] == parent->right)
+                    rotate_left(grand->left);
+                rotate_right(*path[depth - 2]);
+            } else {
+                node_ptr uncle = grand->left;
+                if (is_red(uncle)) {
+                    parent->red = uncle->red = false;
+                    grand->red = true;
+                    depth -= 2;
+                    continue;
+                }
+                if (*path[depth] == parent->left)
+                    rotate_right(grand->right);
+                rotate_left(*path[depth - 2]);
+            }
+
+            // The grandparent is now a red child of the black subtree root
+            (*path[depth - 2])->red = false;
+            grand->red = true;
+            break;
         }
-        // if greater than node --> go right; if right is equal to key --> update to_delete parent  
-        else if (comp(t->element.first, x)) {
-            if (t->right.element.first == x) 
-                parent_of_del = &t; 
-            erase(x, t->right); 
+
+        // A red root turning black adds a black node to every path
+        bool grew = (*path[0])->red;
+        (*path[0])->red = false;
+        return grew;
+    }
+
+    // rb_insert_fixup for a red node linked without a recorded path; it
+    // climbs by the parent pointers only as far as the recolouring goes
+    void rb_insert_fixup_up( node_ptr n ) {
+        // A red parent is never the root, so it has a parent
+        while (is_red(n->parent)) {
+            node_ptr parent = n->parent;
+            node_ptr grand = parent->parent;
+            node_ptr & top = *link_to(grand);
+
+            if (parent == grand->left) {
+                node_ptr uncle = grand->right;
+                if (is_red(uncle)) {
+                    parent->red = uncle->red = false;
+                    grand->red = true;
+                    n = grand;
+                    continue;
+                }
+                if (n == parent->right)
+                    rotate_left(grand->left);
+                rotate_right(top);
+            } else {
+                node_ptr uncle = grand->left;
+                if (is_red(uncle)) {
+                    parent->red = uncle->red = false;
+                    grand->red = true;
+                    n = grand;
+                    continue;
+                }
+                if (n == parent->left)
+                    rotate_right(grand->right);
+                rotate_left(top);
+            }
+
+            top->red = false;
+            grand->red = true;
+            break;
         }
-        // if equal node --> update to_delete var 
-        else {
-        //(x.first == t->element.first) 
-            to_delete = &t; 
+        _root->red = false;
+    }
+
+    // The subtree at path[depth] is short one black node
+    void rb_erase_fixup( node_ptr ** path, size_type depth ) {
+        while (depth > 0 && !is_red(*path[depth])) {
+            node_ptr parent = *path[depth - 1];
+
+            if (path[depth] == &parent->left) {
+                node_ptr sibling = parent->right;
+                if (sibling->red) {
+                    sibling->red = false;
+                    parent->red = true;
+                    rotate_left(*path[depth - 1]);
+                    // The sibling became the parent's parent; extend the path
+                    path[depth] = &sibling->left;
+                    path[++depth] = &parent->left;
+                    sibling = parent->right;
+                }
+                if (!is_red(sibling->left) && !is_red(sibling->right)) {
+                    sibling->red = true;
+                    depth--;
+                    continue;
+                }
+                if (!is_red(sibling->right)) {
+                    sibling->left->red = false;
+                    sibling->red = true;
+                    rotate_right(parent->right);
+                    sibling = parent->right;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->right->red = false;
+                rotate_left(*path[depth - 1]);
+            } else {
+                node_ptr sibling = parent->left;
+                if (sibling->red) {
+                    sibling->red = false;
+                    parent->red = true;
+                    rotate_right(*path[depth - 1]);
+                    path[depth] = &sibling->right;
+                    path[++depth] = &parent->right;
+                    sibling = parent->left;
+                }
+                if (!is_red(sibling->left) && !is_red(sibling->right)) {
+                    sibling->red = true;
+                    depth--;
+                    continue;
+                }
+                if (!is_red(sibling->left)) {
+                    sibling->right->red = false;
+                    sibling->red = true;
+                    rotate_left(parent->left);
+                    sibling = parent->left;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->left->red = false;
+                rotate_right(*path[depth - 1]);
+            }
+            return;
         }
-        */
 
-    const_node_ptr min( const_node_ptr t ) const {
-        // go left 
-        if (t->left == nullptr) {
-            return t; 
+        if (*path[depth] != nullptr)
+            (*path[depth])->red = false;
+    }
+
+    /* AVL */
+
+    static int height( const_node_ptr t ) { return t == nullptr ? 0 : t->height; }
+    static int balance_factor( const_node_ptr t ) { return height(t->left) - height(t->right); }
+    static void update_height( node_ptr t ) {
+        t->height = static_cast<unsigned char>(1 + std::max(height(t->left), height(t->right)));
+    }
+
+    // Restores the AVL property at t, whose children are balanced
+    static void avl_rebalance( node_ptr & t ) {
+        int bf = balance_factor(t);
+        if (bf > 1) {
+            if (balance_factor(t->left) < 0) {
+                rotate_left(t->left);
+                update_height(t->left->left);
+                update_height(t->left);
+            }
+            rotate_right(t);
+            update_height(t->right);
+        } else if (bf < -1) {
+            if (balance_factor(t->right) > 0) {
+                rotate_right(t->right);
+                update_height(t->right->right);
+                update_height(t->right);
+            }
+            rotate_left(t);
+            update_height(t->left);
         }
-        min(t->left); 
+        update_height(t);
     }
-    const_node_ptr max( const_node_ptr t ) const {
-        // go right 
-        if (t->right == nullptr) {
-            return t; 
+
+    // Walks from the parent of the link at path[depth] back to the root,
+    // rebalancing each ancestor. Stops once a subtree ends up as tall as
+    // it was before the update since nothing above it can change.
+    void avl_fixup( node_ptr ** path, size_type depth ) {
+        while (depth-- > 0) {
+            node_ptr & t = *path[depth];
+            int before = t->height;
+
+            avl_rebalance(t);
+
+            if (t->height == before)
+                break;
         }
-        max(t->right);
     }
 
-    bool contains( const key_type & x, const_node_ptr t ) const {
-        
-        // go left / right until equal or nullptr; x is a key!
+    // avl_fixup from t upward by the parent pointers
+    void avl_fixup_up( node_ptr t ) {
+        while (t != nullptr) {
+            node_ptr & link = *link_to(t);
+            int before = t->height;
 
-        // if t = nullptr return false  
-        if (t == nullptr) {
-            return false;
+            avl_rebalance(link);
+
+            if (link->height == before)
+                break;
+            t = link->parent;
         }
-        // if less than node --> go left
-        else if (x < t->element.first) {
-            contains(x, t->left); 
+    }
+
+    /* Treap */
+
+    // Splits the subtree t into the keys less than and greater than key,
+    // stored in lt and gt. A node with an equal key is detached and
+    // returned (or nullptr if there is none). Iterative, so the cost is
+    // the depth of t.
+    // The roots of lt and gt are left with a null parent.
+    node_ptr treap_split( node_ptr t, const key_type & key, node_ptr & lt, node_ptr & gt ) {
+        node_ptr * l = &lt;
+        node_ptr * r = &gt;
+        node_ptr l_parent = nullptr;
+        node_ptr r_parent = nullptr;
+
+        while (t != nullptr) {
+            if (comp(key, t->element.first)) {
+                *r = t;
+                set_parent(t, r_parent);
+                r_parent = t;
+                r = &t->left;
+                t = t->left;
+            } else if (comp(t->element.first, key)) {
+                *l = t;
+                set_parent(t, l_parent);
+                l_parent = t;
+                l = &t->right;
+                t = t->right;
+            } else {
+                *l = t->left;
+                if (t->left != nullptr)
+                    set_parent(t->left, l_parent);
+                *r = t->right;
+                if (t->right != nullptr)
+                    set_parent(t->right, r_parent);
+                recount_upward(l_parent);
+                recount_upward(r_parent);
+                return t;
+            }
         }
-        // if greater than node --> go right
-        else if (x > t->element.first) {
-            contains(x, t->right); 
+
+        *l = *r = nullptr;
+        recount_upward(l_parent);
+        recount_upward(r_parent);
+        return nullptr;
+    }
+
+    // Joins two treaps where every key in l precedes every key in r. The
+    // root of the result is left with a null parent.
+    static node_ptr treap_join( node_ptr l, node_ptr r ) {
+        node_ptr joined;
+        node_ptr * link = &joined;
+        node_ptr parent = nullptr;
+
+        while (l != nullptr && r != nullptr) {
+            if (l->priority > r->priority) {
+                *link = l;
+                set_parent(l, parent);
+                parent = l;
+                link = &l->right;
+                l = l->right;
+            } else {
+                *link = r;
+                set_parent(r, parent);
+                parent = r;
+                link = &r->left;
+                r = r->left;
+            }
         }
-        // if equal node --> update value 
-        else if (x == t->element.first) {
-            return true; 
+
+        *link = l != nullptr ? l : r;
+        if (*link != nullptr)
+            set_parent(*link, parent);
+        recount_upward(parent);
+        return joined;
+    }
+
+    template <typename P>
+    void treap_insert( P && x ) {
+        uint32_t priority = static_cast<uint32_t>(this->rng() >> 32);
+        node_ptr * link = &_root;
+        node_ptr parent = nullptr;
+
+        // Above the new node's position every priority is at least as high
+        while (*link != nullptr && (*link)->priority >= priority) {
+            node_ptr t = *link;
+            parent = t;
+            if (comp(x.first, t->element.first))
+                link = &t->left;
+            else if (comp(t->element.first, x.first))
+                link = &t->right;
+            else {
+                t->element.second = std::forward<P>(x).second;
+                return;
+            }
         }
-        else {
-            cout << "WHY HERE IN contains?" << endl; 
+
+        node_ptr lt, gt;
+        node_ptr n = treap_split(*link, x.first, lt, gt);
+
+        // An existing node further down is reused at the new position
+        node_ptr reused = n;
+        if (n != nullptr) {
+            n->element.second = std::forward<P>(x).second;
+        } else {
+            n = _nodes.create(std::forward<P>(x), nullptr, nullptr);
+            _size++;
         }
 
+        n->priority = priority;
+        n->left = lt;
+        n->right = gt;
+        set_parent(n, parent);
+        if (lt != nullptr)
+            set_parent(lt, n);
+        if (gt != nullptr)
+            set_parent(gt, n);
+        *link = n;
+        if (reused == nullptr)
+            forget_rightmost_above(n);
+        update_count(n);
+        if (reused == nullptr)
+            add_to_counts(parent, 1);
     }
-    node_ptr find( const key_type & key, node_ptr t ) {
-        bool comparison = comp(key, t->element.first);
-    
-        // if nullptr stop recurring 
-        if (t == nullptr) {
-            return nullptr;
+
+    template <typename Key>
+    bool treap_erase( const Key & x ) {
+        node_ptr * link = &_root;
+
+        while (*link != nullptr) {
+            node_ptr t = *link;
+            if (comp(x, t->element.first))
+                link = &t->left;
+            else if (comp(t->element.first, x))
+                link = &t->right;
+            else {
+                _nodes.destroy(remove_node(t));
+                return true;
+            }
         }
-        else if (key == t->element.first) {
-            return t; 
+        return false;
+    }
+
+    /* Scapegoat */
+
+    // Largest depth allowed for a tree of n nodes: floor(log_{3/2}(n))
+    static size_type scapegoat_height( size_type n ) {
+        size_type h = 0;
+        for (long double bound = 1.5L; bound <= n; bound *= 1.5L)
+            h++;
+        return h;
+    }
+
+    // Counts the nodes under t with a Morris traversal, which threads
+    // and then restores right pointers instead of using a stack
+    static size_type subtree_size( node_ptr t ) {
+        if constexpr (ranked)
+            return node_count(t);
+
+        size_type count = 0;
+
+        while (t != nullptr) {
+            if (t->left == nullptr) {
+                count++;
+                t = t->right;
+                continue;
+            }
+
+            node_ptr pred = t->left;
+            while (pred->right != nullptr && pred->right != t)
+                pred = pred->right;
+
+            if (pred->right == nullptr) {
+                pred->right = t;
+                t = t->left;
+            } else {
+                pred->right = nullptr;
+                count++;
+                t = t->right;
+            }
         }
-        // if less than node --> go left; if not left --> insert 
-        else if (comparison) {
-            find(key, t->left);
+
+        return count;
+    }
+
+    // Rotates the n nodes of t into a perfectly balanced subtree in place
+    // (Day-Stout-Warren): first into a right-leaning vine, then a series
+    // of left-rotation passes fold the vine in half until it is
+    // balanced. Linear time and constant space.
+    static void rebuild( node_ptr & t, size_type n ) {
+        for (node_ptr * link = &t; *link != nullptr; ) {
+            if ((*link)->left != nullptr)
+                rotate_right(*link);
+            else
+                link = &(*link)->right;
         }
-        // if greater than node --> go right; if not right --> insert 
-        else {
-            find(key, t->right);
+
+        size_type full = 1;
+        while (full <= n + 1)
+            full <<= 1;
+        full >>= 1;
+
+        // Fold the surplus below the largest perfect tree first
+        compress(t, n + 1 - full);
+        for (size_type m = full - 1; m > 1; m /= 2)
+            compress(t, m / 2);
+    }
+
+    static void compress( node_ptr & t, size_type count ) {
+        node_ptr * link = &t;
+        for (size_type i = 0; i < count; i++) {
+            rotate_left(*link);
+            link = &(*link)->right;
         }
     }
-    const_node_ptr find( const key_type & key, const_node_ptr t ) const {
-        bool comparison = comp(key, t->element.first);
-    
-        // if nullptr stop recurring 
-        if (t == nullptr) {
-            return nullptr;
+
+    // The new node at path[depth] may be too deep; if so find the lowest
+    // ancestor whose child holds more than 2/3 of its nodes and rebuild it
+    void scapegoat_insert_fixup( node_ptr ** path, size_type depth ) {
+        this->max_size = std::max(this->max_size, _size);
+
+        if (depth <= scapegoat_height(_size))
+            return;
+
+        size_type child_size = 1;
+        for (size_type i = depth; i-- > 0; ) {
+            node_ptr t = *path[i];
+            node_ptr child = *path[i + 1];
+            node_ptr sibling = child == t->left ? t->right : t->left;
+            size_type size = child_size + 1 + subtree_size(sibling);
+
+            if (3 * child_size > 2 * size) {
+                rebuild(*path[i], size);
+                return;
+            }
+            child_size = size;
         }
-        else if (key == t->element.first) {
-            return t; 
+    }
+
+    /* Splay */
+
+    // Top-down splay: brings the node with key to the root of t, or the
+    // last node on its search path if the key is absent, and returns the
+    // new root. Nodes passed on the way are hung off two side trees
+    // which become the root's children at the end. found reports
+    // whether the new root holds key. The new root has a null parent.
+    template <typename Key>
+    node_ptr splay( const Key & key, node_ptr t, bool & found ) {
+        found = false;
+        if (t == nullptr)
+            return t;
+
+        node_ptr lt = nullptr;
+        node_ptr gt = nullptr;
+        node_ptr * lt_max = &lt;
+        node_ptr * gt_min = &gt;
+        node_ptr lt_last = nullptr; // node owning lt_max
+        node_ptr gt_last = nullptr;
+
+        while (true) {
+            if (comp(key, t->element.first)) {
+                if (t->left == nullptr)
+                    break;
+                if (comp(key, t->left->element.first)) {
+                    rotate_right(t);
+                    if (t->left == nullptr)
+                        break;
+                }
+                *gt_min = t;
+                set_parent(t, gt_last);
+                gt_last = t;
+                gt_min = &t->left;
+                t = t->left;
+            } else if (comp(t->element.first, key)) {
+                if (t->right == nullptr)
+                    break;
+                if (comp(t->right->element.first, key)) {
+                    rotate_left(t);
+                    if (t->right == nullptr)
+                        break;
+                }
+                *lt_max = t;
+                set_parent(t, lt_last);
+                lt_last = t;
+                lt_max = &t->right;
+                t = t->right;
+            } else {
+                found = true;
+                break;
+            }
         }
-        // if less than node --> go left; if not left --> insert 
-        else if (comparison) {
-            find(key, t->left);
+
+        *lt_max = t->left;
+        if (t->left != nullptr)
+            set_parent(t->left, lt_last);
+        *gt_min = t->right;
+        if (t->right != nullptr)
+            set_parent(t->right, gt_last);
+        recount_upward(lt_last);
+        recount_upward(gt_last);
+        t->left = lt;
+        if (lt != nullptr)
+            set_parent(lt, t);
+        t->right = gt;
+        if (gt != nullptr)
+            set_parent(gt, t);
+        set_parent(t, nullptr);
+        update_count(t);
+        return t;
+    }
+
+    template <typename Key>
+    node_ptr splay_find( const Key & key ) {
+        bool found;
+        _root = splay(key, _root, found);
+        return found ? _root : nullptr;
+    }
+
+    template <typename P>
+    void splay_insert( P && x ) {
+        bool found;
+        _root = splay(x.first, _root, found);
+
+        if (found) {
+            _root->element.second = std::forward<P>(x).second;
+            return;
         }
-        // if greater than node --> go right; if not right --> insert 
-        else {
-            find(key, t->right);
+
+        if (_root == nullptr) {
+            _root = _nodes.create(std::forward<P>(x), nullptr, nullptr);
+        } else if (comp(x.first, _root->element.first)) {
+            node_ptr n = _nodes.create(std::forward<P>(x), _root->left, _root);
+            if (n->left != nullptr)
+                set_parent(n->left, n);
+            _root->left = nullptr;
+            set_parent(_root, n);
+            update_count(_root);
+            update_count(n);
+            _root = n;
+        } else {
+            node_ptr n = _nodes.create(std::forward<P>(x), _root, _root->right);
+            if (n->right != nullptr)
+                set_parent(n->right, n);
+            _root->right = nullptr;
+            set_parent(_root, n);
+            update_count(_root);
+            update_count(n);
+            _root = n;
         }
-    }   
+        _size++;
+    }
 
-    void clear( node_ptr & t ) {
-        if (t == nullptr) // base case 
-            return; 
-        clear(t->left); // go thru the left side until leaf 
-        clear(t->right); // go thru right until leaf 
-        delete t; // delete the current leaf 
-        t = nullptr; // for the root node 
+    template <typename Key>
+    bool splay_erase( const Key & x ) {
+        if (splay_find(x) == nullptr)
+            return false;
+        _nodes.destroy(splay_remove_root());
+        return true;
     }
-    
-    node_ptr clone ( const_node_ptr t ) const {
-        if(t == nullptr)
-            return nullptr;  
 
-        BinaryNode* newBinNode = new BinaryNode(t->element, clone(t->left), clone(t->right)); // continue to make new nodes until the entire tree is made
-        return newBinNode; 
+    // Unlinks the root and returns it
+    node_ptr splay_remove_root() {
+        node_ptr old = _root;
+        if (old->left == nullptr) {
+            _root = old->right;
+            if (_root != nullptr)
+                set_parent(_root, nullptr);
+        } else {
+            // Every key on the left is smaller, so splaying for the root's
+            // key brings the maximum up and leaves its right child free
+            bool found;
+            _root = splay(old->element.first, old->left, found);
+            _root->right = old->right;
+            if (old->right != nullptr)
+                set_parent(old->right, _root);
+            update_count(_root);
+        }
+        _size--;
+        return old;
     }
 
   public:
-    template <typename KK, typename VV, typename CC>
-    friend void printLevelByLevel( const BinarySearchTree<KK, VV, CC>& bst, std::ostream & out );
+    template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+    friend void printLevelByLevel( const BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>& bst, std::ostream & out );
 
-    template <typename KK, typename VV, typename CC>
-    friend std::ostream& printNode(std::ostream& o, const typename BinarySearchTree<KK, VV, CC>::node& bn);
+    template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+    friend std::ostream& printNode(std::ostream& o, const typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::node& bn);
 
-    template <typename KK, typename VV, typename CC>
-    friend void printTree( const BinarySearchTree<KK, VV, CC>& bst, std::ostream & out );
+    template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+    friend void printTree( const BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>& bst, std::ostream & out );
 
-    template <typename KK, typename VV, typename CC>
-    friend void printTree(typename BinarySearchTree<KK, VV, CC>::const_node_ptr t, std::ostream & out, unsigned depth );
+    template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+    friend void printTree(typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::const_node_ptr t, std::ostream & out, unsigned depth );
 
-    template <typename KK, typename VV, typename CC>
+    template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
     friend void vizTree(
-        typename BinarySearchTree<KK, VV, CC>::const_node_ptr node, 
+        typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::const_node_ptr node, 
         std::ostream & out,
-        typename BinarySearchTree<KK, VV, CC>::const_node_ptr prev
+        typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::const_node_ptr prev
     );
 
-    template <typename KK, typename VV, typename CC>
+    template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
     friend void vizTree(
-        const BinarySearchTree<KK, VV, CC> & bst, 
+        const BinarySearchTree<KK, VV, CC, BB, SS, AA, GG> & bst, 
         std::ostream & out
     );
 };
 
-template <typename KK, typename VV, typename CC>
-std::ostream& printNode(std::ostream & o, const typename BinarySearchTree<KK, VV, CC>::node & bn) {
+template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+std::ostream& printNode(std::ostream & o, const typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::node & bn) {
     return o << '(' << bn.element.first << ", " << bn.element.second << ')';
 }
 
-template <typename KK, typename VV, typename CC>
-void printLevelByLevel( const BinarySearchTree<KK, VV, CC>& bst, std::ostream & out = std::cout ) {
+template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+void printLevelByLevel( const BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>& bst, std::ostream & out = std::cout ) {
     
-    using node = typename BinarySearchTree<KK, VV, CC>::node;
-    using node_ptr = typename BinarySearchTree<KK, VV, CC>::node_ptr;
-    using const_node_ptr = typename BinarySearchTree<KK, VV, CC>::const_node_ptr;
+    using node = typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::node;
+    using node_ptr = typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::node_ptr;
+    using const_node_ptr = typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::const_node_ptr;
     
-    // TODO -- Guide in Instructions
+    // Every position of a level is printed, null or not, and the queue
+    // holds one level: 2^d entries at depth d, so O(2^h) for a tree of
+    // height h. Meant for small trees; printTree and vizTree take O(1)
+    // extra memory at any height.
     if (bst.empty()) return; 
 
     std::queue <node_ptr> node_queue; 
@@ -380,7 +3577,7 @@ void printLevelByLevel( const BinarySearchTree<KK, VV, CC>& bst, std::ostream &
         node_queue.pop(); // front most element 
         node_count--;
         if (curr_node) {
-            printNode<KK, VV, CC>(out, *curr_node);
+            printNode<KK, VV, CC, BB, SS, AA, GG>(out, *curr_node);
             out << " ";
             node_queue.push(curr_node->left); 
             node_queue.push(curr_node->right); 
@@ -410,29 +3607,36 @@ void printLevelByLevel( const BinarySearchTree<KK, VV, CC>& bst, std::ostream &
     
 }
 
-template <typename KK, typename VV, typename CC>
-void printTree( const BinarySearchTree<KK, VV, CC> & bst, std::ostream & out = std::cout ) { printTree<KK, VV, CC>(bst._root, out ); }
+template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+void printTree( const BinarySearchTree<KK, VV, CC, BB, SS, AA, GG> & bst, std::ostream & out = std::cout ) { printTree<KK, VV, CC, BB, SS, AA, GG>(bst._root, out ); }
 
-template <typename KK, typename VV, typename CC>
-void printTree(typename BinarySearchTree<KK, VV, CC>::const_node_ptr t, std::ostream & out, unsigned depth = 0 ) {
-    if (t != nullptr) {
-        printTree<KK, VV, CC>(t->right, out, depth + 1);
-        for (unsigned i = 0; i < depth; ++i)
+// Right subtree first, so the tree reads left to right when the output
+// is turned a quarter clockwise. Walks the tree without a stack.
+template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
+void printTree(typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::const_node_ptr t, std::ostream & out, unsigned depth = 0 ) {
+    using tree = BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>;
+    using const_node_ptr = typename tree::const_node_ptr;
+
+    tree::template walk_in_order<true>(t, [&](const_node_ptr n, typename tree::size_type d) {
+        for (size_t i = 0; i < depth + d; ++i)
             out << '\t';
-        printNode<KK, VV, CC>(out, *t) << '\n';
-        printTree<KK, VV, CC>(t->left, out, depth + 1);
-    }
+        printNode<KK, VV, CC, BB, SS, AA, GG>(out, *n) << '\n';
+    });
 }
 
-template <typename KK, typename VV, typename CC>
+// Emits each node and the edge from its parent in pre-order, walking
+// the tree without a stack
+template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
 void vizTree(
-    typename BinarySearchTree<KK, VV, CC>::const_node_ptr node, 
+    typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::const_node_ptr node, 
     std::ostream & out,
-    typename BinarySearchTree<KK, VV, CC>::const_node_ptr prev = nullptr
+    typename BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>::const_node_ptr prev = nullptr
 ) {
-    if(node) {
-        std::hash<KK> khash{};
+    using tree = BinarySearchTree<KK, VV, CC, BB, SS, AA, GG>;
+    using const_node_ptr = typename tree::const_node_ptr;
+    std::hash<KK> khash{};
 
+    tree::walk_pre_order(node, prev, [&](const_node_ptr node, const_node_ptr prev) {
         out << "\t" "node_" << (uint32_t) khash(node->element.first)
             << "[label=\"" << node->element.first 
             << " [" << node->element.second << "]\"];" << std::endl;
@@ -443,18 +3647,25 @@ void vizTree(
             out << "\t";
         
         out << "node_" << (uint32_t) khash(node->element.first) << ";" << std::endl;
-    
-        vizTree<KK, VV, CC>(node->left, out, node);
-        vizTree<KK, VV, CC>(node->right, out, node);
-    }
+    });
 }
 
-template <typename KK, typename VV, typename CC>
+template <typename KK, typename VV, typename CC, typename BB, typename SS, typename AA, typename GG>
 void vizTree(
-    const BinarySearchTree<KK, VV, CC> & bst, 
+    const BinarySearchTree<KK, VV, CC, BB, SS, AA, GG> & bst, 
     std::ostream & out = std::cout
 ) {
     out << "digraph Tree {" << std::endl;
-    vizTree<KK, VV, CC>(bst._root, out);
+    vizTree<KK, VV, CC, BB, SS, AA, GG>(bst._root, out);
     out << "}" << std::endl;
 }
+
+namespace pmr {
+    // BinarySearchTree whose nodes (or, with storage::pool, slabs) come
+    // from a std::pmr::memory_resource, e.g. a per-request
+    // monotonic_buffer_resource released all at once
+    template <typename K, typename V, typename Comparator = std::less<K>, typename Balance = balance::none,
+              typename Storage = storage::heap, typename Augment = augment::none>
+    using BinarySearchTree = ::BinarySearchTree<K, V, Comparator, Balance, Storage,
+                                                std::pmr::polymorphic_allocator<std::pair<K, V>>, Augment>;
+}
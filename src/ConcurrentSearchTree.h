@@ -0,0 +1,408 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional> // std::less
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility> // std::pair
+#include <vector>
+
+/*
+    Search tree for one writer thread and any number of reader threads.
+    Readers take no lock and make no atomic read-modify-write.
+
+    A published node is never modified. insert and erase copy the nodes
+    on the search path (and the few a rotation touches) into a new
+    version that shares every other subtree with the current one, as
+    PersistentSearchTree does. The writer then publishes the new root
+    with a release store. A reader loads the root with acquire and sees
+    one consistent version for as long as it looks.
+
+    The replaced nodes are freed by epoch-based reclamation. Each reader
+    owns a slot, padded to its own cache line. Before loading the root,
+    a lookup stores the current epoch in its slot, and it resets the slot
+    once it is done. Those are plain stores and a fence, so readers never
+    write a cache line another thread writes. The writer tags each
+    replaced node with the epoch of its update. Every reclaim_threshold
+    replaced nodes, it advances the epoch and frees the nodes tagged
+    before the oldest epoch any reader is still in.
+
+    insert, erase, reclaim and the writer's own lookups must all be called
+    from one thread at a time. Each thread reads through its own reader
+    from register_reader(). Every reader must be destroyed before the
+    tree.
+*/
+template <typename K, typename V, typename Comparator = std::less<K>>
+class ConcurrentSearchTree
+{
+  public:
+    using key_type        = K;
+    using value_type      = V;
+    using key_compare     = Comparator;
+    using pair            = std::pair<key_type, value_type>;
+    using const_reference = const pair&;
+    using size_type       = size_t;
+
+    // Replaced nodes the writer holds before it tries to free them
+    static constexpr size_type reclaim_threshold = 256;
+
+  private:
+    using epoch_type = unsigned long long;
+    static constexpr epoch_type idle = ~0ULL;
+
+    struct Node {
+        pair element;
+        const Node *left;
+        const Node *right;
+        unsigned char height;
+        // The update that created the node
+        epoch_type stamp;
+
+        template <typename E>
+        Node( E && e, const Node *lt, const Node *rt, unsigned char h, epoch_type s )
+          : element{std::forward<E>(e)}, left{lt}, right{rt}, height{h}, stamp{s} { }
+    };
+    using node_ptr = const Node *;
+
+    // The epoch a reader is in, or idle
+    struct alignas(64) Slot {
+        std::atomic<epoch_type> epoch{idle};
+        bool in_use = false; // guarded by _slots_mutex
+    };
+
+    std::atomic<node_ptr> _root{nullptr};
+    std::atomic<size_type> _size{0};
+    key_compare comp;
+
+    alignas(64) std::atomic<epoch_type> _epoch{0};
+    std::mutex _slots_mutex;
+    std::vector<std::unique_ptr<Slot>> _slots;
+    // Replaced nodes in the order they were replaced, with their epochs
+    std::deque<std::pair<epoch_type, node_ptr>> _retired;
+
+    // The writer's update in progress: the nodes it has created, those
+    // of them it has already replaced again, and the published nodes it
+    // has replaced
+    epoch_type _update = 0;
+    std::vector<node_ptr> _fresh, _discarded, _replaced;
+
+  public:
+    // A reader thread's view of the tree. Every lookup sees the version
+    // that was current when it began.
+    class reader
+    {
+        ConcurrentSearchTree *_tree = nullptr;
+        Slot *_slot = nullptr;
+
+        friend class ConcurrentSearchTree;
+        reader( ConcurrentSearchTree *tree, Slot *slot ) : _tree{tree}, _slot{slot} { }
+
+        // Keeps the nodes reachable from root alive while it exists
+        class pin {
+            Slot *_slot;
+
+          public:
+            node_ptr root;
+
+            explicit pin( const reader & r ) : _slot{r._slot} {
+                _slot->epoch.store(r._tree->_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+                // Orders the store before the root load; pairs with the
+                // fence in reclaim
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                root = r._tree->_root.load(std::memory_order_acquire);
+            }
+            pin( const pin & ) = delete;
+            pin & operator=( const pin & ) = delete;
+            ~pin() { _slot->epoch.store(idle, std::memory_order_release); }
+        };
+
+      public:
+        reader( reader && rhs ) noexcept
+          : _tree{std::exchange(rhs._tree, nullptr)}, _slot{std::exchange(rhs._slot, nullptr)} { }
+        reader & operator=( reader && rhs ) noexcept {
+            std::swap(_tree, rhs._tree);
+            std::swap(_slot, rhs._slot);
+            return *this;
+        }
+        ~reader() {
+            if (_tree != nullptr)
+                _tree->unregister(_slot);
+        }
+
+        bool contains( const key_type & key ) const {
+            pin p(*this);
+            return _tree->lookup(p.root, key) != nullptr;
+        }
+        // The value is copied out, since the node may be freed as soon as
+        // the lookup is over
+        std::optional<value_type> find( const key_type & key ) const {
+            pin p(*this);
+            node_ptr t = _tree->lookup(p.root, key);
+            if (t == nullptr)
+                return std::nullopt;
+            return t->element.second;
+        }
+        // Calls visit on every element of one version in key order
+        template <typename F>
+        void for_each( F && visit ) const {
+            pin p(*this);
+            in_order(p.root, visit);
+        }
+    };
+
+    ConcurrentSearchTree() : comp{} { }
+    explicit ConcurrentSearchTree( const key_compare & c ) : comp{c} { }
+
+    // Builds the tree from pairs sorted by strictly increasing key
+    explicit ConcurrentSearchTree( std::vector<pair> && sorted, const key_compare & c = key_compare{} )
+      : comp{c} {
+        try {
+            _root.store(build(sorted, 0, sorted.size()), std::memory_order_relaxed);
+        } catch (...) {
+            abandon();
+            throw;
+        }
+        _fresh.clear();
+        _size.store(sorted.size(), std::memory_order_relaxed);
+    }
+
+    ConcurrentSearchTree( const ConcurrentSearchTree & ) = delete;
+    ConcurrentSearchTree & operator=( const ConcurrentSearchTree & ) = delete;
+    ~ConcurrentSearchTree() {
+        clear(_root.load(std::memory_order_relaxed));
+        for (auto & [epoch, t] : _retired)
+            delete t;
+    }
+
+    // Any thread may register; the reader is then used by one thread
+    reader register_reader() {
+        std::lock_guard<std::mutex> lock(_slots_mutex);
+        for (auto & slot : _slots) {
+            if (!slot->in_use) {
+                slot->in_use = true;
+                return reader(this, slot.get());
+            }
+        }
+        _slots.push_back(std::make_unique<Slot>());
+        _slots.back()->in_use = true;
+        return reader(this, _slots.back().get());
+    }
+
+    // As BinarySearchTree::insert, an equal key has its value replaced
+    void insert( const_reference x ) {
+        bool added = false;
+        update([&](node_ptr root) { return insert(root, x, added); });
+        if (added)
+            _size.store(size() + 1, std::memory_order_relaxed);
+    }
+    void erase( const key_type & key ) {
+        node_ptr root = _root.load(std::memory_order_relaxed);
+        if (lookup(root, key) == nullptr)
+            return;
+        update([&](node_ptr t) { return erase(t, key); });
+        _size.store(size() - 1, std::memory_order_relaxed);
+    }
+
+    // The writer's lookups, which need no pin because only the writer
+    // frees nodes
+    bool contains( const key_type & key ) const { return lookup(_root.load(std::memory_order_relaxed), key) != nullptr; }
+    const value_type & find( const key_type & key ) const { return lookup(_root.load(std::memory_order_relaxed), key)->element.second; }
+    template <typename F>
+    void for_each( F && visit ) const { in_order(_root.load(std::memory_order_relaxed), visit); }
+    size_type height() const { return height(_root.load(std::memory_order_relaxed)); }
+
+    // Safe from any thread
+    size_type size() const { return _size.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+
+    // Replaced nodes not yet freed
+    size_type retired() const { return _retired.size(); }
+
+    // Advances the epoch and frees the replaced nodes no reader can
+    // still reach. Called by the writer every reclaim_threshold
+    // replacements, or at any other time.
+    void reclaim() {
+        epoch_type oldest = _epoch.load(std::memory_order_relaxed) + 1;
+        _epoch.store(oldest, std::memory_order_release);
+        // A reader whose store to its slot this fence misses will load a
+        // root published before it
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::lock_guard<std::mutex> lock(_slots_mutex);
+            for (auto & slot : _slots)
+                oldest = std::min(oldest, slot->epoch.load(std::memory_order_acquire));
+        }
+        while (!_retired.empty() && _retired.front().first < oldest) {
+            delete _retired.front().second;
+            _retired.pop_front();
+        }
+    }
+
+  private:
+    void unregister( Slot * slot ) {
+        std::lock_guard<std::mutex> lock(_slots_mutex);
+        slot->in_use = false;
+    }
+
+    // Builds a new version from the current root with build and publishes
+    // it. If build throws, the current version stays and the new nodes
+    // are freed.
+    template <typename Build>
+    void update( Build && build ) {
+        _update++;
+        node_ptr root;
+        try {
+            root = build(_root.load(std::memory_order_relaxed));
+        } catch (...) {
+            abandon();
+            throw;
+        }
+        _root.store(root, std::memory_order_release);
+
+        // Nodes of this update that were replaced again were never seen
+        for (node_ptr t : _discarded)
+            delete t;
+        epoch_type epoch = _epoch.load(std::memory_order_relaxed);
+        for (node_ptr t : _replaced)
+            _retired.emplace_back(epoch, t);
+        _fresh.clear();
+        _discarded.clear();
+        _replaced.clear();
+
+        if (_retired.size() >= reclaim_threshold)
+            reclaim();
+    }
+    void abandon() {
+        for (node_ptr t : _fresh)
+            delete t;
+        _fresh.clear();
+        _discarded.clear();
+        _replaced.clear();
+    }
+
+    static int height( node_ptr t ) { return t == nullptr ? 0 : t->height; }
+
+    template <typename E>
+    node_ptr make( node_ptr l, E && e, node_ptr r ) {
+        int h = 1 + std::max(height(l), height(r));
+        _fresh.emplace_back();
+        return _fresh.back() = new Node(std::forward<E>(e), l, r, static_cast<unsigned char>(h), _update);
+    }
+
+    // t is no longer part of the version being built
+    void replace( node_ptr t ) {
+        if (t->stamp == _update)
+            _discarded.push_back(t);
+        else
+            _replaced.push_back(t);
+    }
+
+    // make for subtrees whose heights differ by at most two, rotating
+    // the result into AVL balance
+    node_ptr balance( node_ptr l, const_reference e, node_ptr r ) {
+        int hl = height(l), hr = height(r);
+        if (hl > hr + 1) {
+            node_ptr a = l;
+            replace(a);
+            if (height(a->left) >= height(a->right))
+                return make(a->left, a->element, make(a->right, e, r));
+            node_ptr b = a->right;
+            replace(b);
+            node_ptr lower = make(a->left, a->element, b->left);
+            return make(lower, b->element, make(b->right, e, r));
+        }
+        if (hr > hl + 1) {
+            node_ptr a = r;
+            replace(a);
+            if (height(a->right) >= height(a->left))
+                return make(make(l, e, a->left), a->element, a->right);
+            node_ptr b = a->left;
+            replace(b);
+            node_ptr lower = make(l, e, b->left);
+            return make(lower, b->element, make(b->right, a->element, a->right));
+        }
+        return make(l, e, r);
+    }
+
+    node_ptr insert( node_ptr t, const_reference x, bool & added ) {
+        if (t == nullptr) {
+            added = true;
+            return make(nullptr, x, nullptr);
+        }
+        replace(t);
+        if (comp(x.first, t->element.first))
+            return balance(insert(t->left, x, added), t->element, t->right);
+        if (comp(t->element.first, x.first))
+            return balance(t->left, t->element, insert(t->right, x, added));
+        return make(t->left, x, t->right);
+    }
+
+    // key is known to be under t
+    node_ptr erase( node_ptr t, const key_type & key ) {
+        replace(t);
+        if (comp(key, t->element.first))
+            return balance(erase(t->left, key), t->element, t->right);
+        if (comp(t->element.first, key))
+            return balance(t->left, t->element, erase(t->right, key));
+        if (t->left == nullptr)
+            return t->right;
+        if (t->right == nullptr)
+            return t->left;
+
+        // The successor's element takes the erased node's place
+        node_ptr successor = t->right;
+        while (successor->left != nullptr)
+            successor = successor->left;
+        node_ptr r = erase_min(t->right);
+        return balance(t->left, successor->element, r);
+    }
+    node_ptr erase_min( node_ptr t ) {
+        replace(t);
+        if (t->left == nullptr)
+            return t->right;
+        return balance(erase_min(t->left), t->element, t->right);
+    }
+
+    // Perfectly balanced tree over sorted[first, last)
+    node_ptr build( std::vector<pair> & sorted, size_type first, size_type last ) {
+        if (first == last)
+            return nullptr;
+        size_type mid = first + (last - first) / 2;
+        node_ptr l = build(sorted, first, mid);
+        node_ptr r = build(sorted, mid + 1, last);
+        return make(l, std::move(sorted[mid]), r);
+    }
+
+    static void clear( node_ptr t ) {
+        while (t != nullptr) {
+            node_ptr right = t->right;
+            clear(t->left);
+            delete t;
+            t = right;
+        }
+    }
+
+    node_ptr lookup( node_ptr t, const key_type & key ) const {
+        while (t != nullptr) {
+            if (comp(key, t->element.first))
+                t = t->left;
+            else if (comp(t->element.first, key))
+                t = t->right;
+            else
+                return t;
+        }
+        return nullptr;
+    }
+
+    template <typename F>
+    static void in_order( node_ptr t, F & visit ) {
+        while (t != nullptr) {
+            in_order(t->left, visit);
+            visit(t->element);
+            t = t->right;
+        }
+    }
+};
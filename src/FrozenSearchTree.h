@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <functional> // std::less
+#include <utility> // std::pair
+#include <vector>
+
+/*
+    Immutable search tree stored as an array in Eytzinger (breadth-first)
+    order: the children of the node at 1-based index k sit at 2k and
+    2k + 1. A lookup descends by index arithmetic alone, so there are no
+    pointers to chase and no branches to mispredict, and since the four
+    grandchildren of k are adjacent (4k .. 4k + 3) they can be prefetched
+    two levels ahead of the search.
+
+    Produced by BinarySearchTree::freeze() and exposes the same find,
+    contains, min and max as the live tree.
+*/
+template <typename K, typename V, typename Comparator = std::less<K>>
+class FrozenSearchTree
+{
+  public:
+    using key_type        = K;
+    using value_type      = V;
+    using key_compare     = Comparator;
+    using pair            = std::pair<key_type, value_type>;
+    using const_reference = const pair&;
+    using size_type       = size_t;
+
+  private:
+    std::vector<pair> _elements; // _elements[k - 1] holds node k
+    key_compare comp;
+
+  public:
+    FrozenSearchTree() : _elements{}, comp{} { }
+
+    // Builds the snapshot from pairs sorted by strictly increasing key
+    explicit FrozenSearchTree( std::vector<pair> && sorted, const key_compare & c = key_compare{} )
+      : _elements{}, comp{c} {
+        size_type n = sorted.size();
+
+        // Walk the implicit tree in order; the j-th node visited receives
+        // the j-th smallest pair
+        std::vector<size_type> source(n);
+        size_type k = leftmost(1, n);
+        for (size_type j = 0; j < n; j++) {
+            source[k - 1] = j;
+            if (2 * k + 1 <= n) {
+                k = leftmost(2 * k + 1, n);
+            } else {
+                while (k & 1)
+                    k >>= 1;
+                k >>= 1;
+            }
+        }
+
+        _elements.reserve(n);
+        for (size_type i = 0; i < n; i++)
+            _elements.push_back(std::move(sorted[source[i]]));
+    }
+
+    const_reference min() const { return _elements[leftmost(1, size()) - 1]; }
+    const_reference max() const { return _elements[rightmost(1, size()) - 1]; }
+
+    bool contains( const key_type & x ) const { return lookup( x ) != 0; }
+    const value_type & find( const key_type & key ) const { return _elements[lookup( key ) - 1].second; }
+
+    bool empty() const {
+        return _elements.empty();
+    }
+    size_type size() const {
+        return _elements.size();
+    }
+
+  private:
+    static size_type leftmost( size_type k, size_type n ) {
+        while (2 * k <= n)
+            k = 2 * k;
+        return k;
+    }
+    static size_type rightmost( size_type k, size_type n ) {
+        while (2 * k + 1 <= n)
+            k = 2 * k + 1;
+        return k;
+    }
+
+    // 1-based index of the node holding key, or 0 if there is none
+    size_type lookup( const key_type & key ) const {
+        const pair * a = _elements.data();
+        size_type n = _elements.size();
+        size_type k = 1;
+
+        while (k <= n) {
+            #if defined(__GNUC__)
+            __builtin_prefetch(reinterpret_cast<const char *>(a) + (4 * k - 1) * sizeof(pair));
+            #endif
+            k = 2 * k + comp(a[k - 1].first, key);
+        }
+
+        // Each right turn appended a one bit; strip the trailing right
+        // turns and the final left turn to recover the last node where
+        // the search went left, which is the lower bound of key
+        k >>= count_trailing_ones(k) + 1;
+
+        if (k == 0 || comp(key, a[k - 1].first))
+            return 0;
+        return k;
+    }
+
+    static unsigned count_trailing_ones( size_type k ) {
+        #if defined(__GNUC__)
+        return __builtin_ctzll(~static_cast<unsigned long long>(k));
+        #else
+        unsigned n = 0;
+        for (; k & 1; k >>= 1)
+            n++;
+        return n;
+        #endif
+    }
+};
@@ -0,0 +1,211 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory> // std::allocator_traits
+#include <new>
+#include <utility> // std::forward
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/*
+    Slab allocator for the nodes of a single tree. Nodes are handed out
+    back to back from slabs of growing size (4KB doubling up to 64KB, or
+    2MB transparent huge pages when enabled), erased nodes go on a free
+    list and are reused first, and release() returns every slab at once.
+
+    A node costs exactly sizeof(Node) bytes instead of sizeof(Node) plus
+    the general-purpose allocator's header and rounding, and once the
+    pool has grown to the working size of the tree insert and erase no
+    longer touch the global heap.
+
+    Regular slabs come from Allocator; huge-page slabs are mapped
+    directly from the system.
+*/
+template <typename Node, typename Allocator = std::allocator<Node>>
+class NodePool
+{
+    union Slot {
+        Slot * next; // while on the free list
+        alignas(Node) unsigned char bytes[sizeof(Node)];
+    };
+
+    // Each slab starts with a header linking it to the previous slab
+    struct Slab {
+        Slab * next;
+        size_t slots; // including the ones the header occupies
+        bool huge;
+    };
+
+    using slot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+    using slot_traits    = std::allocator_traits<slot_allocator>;
+
+    static constexpr size_t header_slots = (sizeof(Slab) + sizeof(Slot) - 1) / sizeof(Slot);
+    static constexpr size_t first_slab_bytes = 4096;
+    static constexpr size_t max_slab_bytes = 1 << 16;
+    static constexpr size_t min_slab_nodes = 16;
+    static constexpr size_t huge_page_bytes = 2 << 20;
+
+    Slab * _slabs;
+    Slot * _free;        // erased nodes, most recently erased first
+    Slot * _next;        // unused tail of the newest slab
+    Slot * _end;
+    size_t _slab_bytes;  // size of the next regular slab
+    bool _huge_pages;
+    slot_allocator _alloc;
+
+  public:
+    using allocator_type = Allocator;
+
+    NodePool() : NodePool(Allocator{}) { }
+    explicit NodePool( const Allocator & a ) noexcept
+      : _slabs{nullptr}, _free{nullptr}, _next{nullptr}, _end{nullptr},
+        _slab_bytes{first_slab_bytes}, _huge_pages{false}, _alloc{a} { }
+
+    NodePool( const NodePool & ) = delete;
+    NodePool & operator=( const NodePool & ) = delete;
+
+    // The slabs travel with the nodes they hold
+    NodePool( NodePool && rhs ) noexcept
+      : _slabs{rhs._slabs}, _free{rhs._free}, _next{rhs._next}, _end{rhs._end},
+        _slab_bytes{rhs._slab_bytes}, _huge_pages{rhs._huge_pages}, _alloc{std::move(rhs._alloc)} {
+        rhs.forget();
+    }
+    // Unless the allocator propagates on move assignment, the two pools'
+    // allocators must compare equal
+    NodePool & operator=( NodePool && rhs ) noexcept {
+        if (&rhs == this) return *this;
+        release();
+        if constexpr (slot_traits::propagate_on_container_move_assignment::value)
+            _alloc = std::move(rhs._alloc);
+        _slabs = rhs._slabs;
+        _free = rhs._free;
+        _next = rhs._next;
+        _end = rhs._end;
+        _slab_bytes = rhs._slab_bytes;
+        _huge_pages = rhs._huge_pages;
+        rhs.forget();
+        return *this;
+    }
+    ~NodePool() {
+        release();
+    }
+
+    template <typename... Args>
+    Node * create( Args &&... args ) {
+        Slot * s = take();
+        try {
+            return ::new (static_cast<void *>(s)) Node(std::forward<Args>(args)...);
+        } catch (...) {
+            give_back(s);
+            throw;
+        }
+    }
+    void destroy( Node * n ) noexcept {
+        n->~Node();
+        give_back(reinterpret_cast<Slot *>(n));
+    }
+
+    // Frees every slab. Nodes still live in the pool must either have
+    // been destroyed or be trivially destructible.
+    void release() noexcept {
+        while (_slabs != nullptr) {
+            Slab * next = _slabs->next;
+            free_slab(_slabs);
+            _slabs = next;
+        }
+        _free = _next = _end = nullptr;
+        _slab_bytes = first_slab_bytes;
+    }
+
+    allocator_type get_allocator() const { return allocator_type(_alloc); }
+    // Replaces the allocator; the pool must hold no slabs
+    void set_allocator( const allocator_type & a ) { _alloc = slot_allocator(a); }
+
+    // Back later slabs with 2MB transparent huge pages where the system
+    // supports them, cutting TLB misses on trees of millions of nodes
+    void huge_pages( bool on ) { _huge_pages = on; }
+
+    size_t slab_count() const {
+        size_t n = 0;
+        for (Slab * s = _slabs; s != nullptr; s = s->next)
+            n++;
+        return n;
+    }
+
+  private:
+    void forget() noexcept {
+        _slabs = nullptr;
+        _free = _next = _end = nullptr;
+        _slab_bytes = first_slab_bytes;
+    }
+
+    Slot * take() {
+        if (_free != nullptr) {
+            Slot * s = _free;
+            _free = s->next;
+            return s;
+        }
+        if (_next == _end)
+            grow();
+        return _next++;
+    }
+    void give_back( Slot * s ) noexcept {
+        s->next = _free;
+        _free = s;
+    }
+
+    void grow() {
+        size_t slots = huge_page_bytes / sizeof(Slot);
+        Slot * mem = _huge_pages ? static_cast<Slot *>(map_huge_page()) : nullptr;
+        bool huge = mem != nullptr;
+
+        if (!huge) {
+            slots = _slab_bytes / sizeof(Slot);
+            if (slots < header_slots + min_slab_nodes)
+                slots = header_slots + min_slab_nodes;
+            mem = slot_traits::allocate(_alloc, slots);
+            if (_slab_bytes < max_slab_bytes)
+                _slab_bytes *= 2;
+        }
+
+        _slabs = ::new (static_cast<void *>(mem)) Slab{ _slabs, slots, huge };
+        _next = mem + header_slots;
+        _end = mem + slots;
+    }
+
+    void free_slab( Slab * slab ) noexcept {
+        #if defined(__linux__)
+        if (slab->huge) {
+            munmap(slab, huge_page_bytes);
+            return;
+        }
+        #endif
+        slot_traits::deallocate(_alloc, reinterpret_cast<Slot *>(slab), slab->slots);
+    }
+
+    // Maps one 2MB-aligned region and asks for it to be backed by a huge
+    // page; returns nullptr where that is not possible
+    static void * map_huge_page() {
+        #if defined(__linux__) && defined(MADV_HUGEPAGE)
+        size_t span = 2 * huge_page_bytes;
+        void * p = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+
+        // Trim the mapping down to the aligned 2MB in the middle of it
+        uintptr_t start = reinterpret_cast<uintptr_t>(p);
+        uintptr_t aligned = (start + huge_page_bytes - 1) & ~(uintptr_t(huge_page_bytes) - 1);
+        if (aligned > start)
+            munmap(p, aligned - start);
+        if (start + span > aligned + huge_page_bytes)
+            munmap(reinterpret_cast<void *>(aligned + huge_page_bytes), start + span - aligned - huge_page_bytes);
+
+        madvise(reinterpret_cast<void *>(aligned), huge_page_bytes, MADV_HUGEPAGE);
+        return reinterpret_cast<void *>(aligned);
+        #else
+        return nullptr;
+        #endif
+    }
+};
@@ -0,0 +1,288 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional> // std::less
+#include <utility> // std::pair
+#include <vector>
+
+/*
+    Persistent search tree: every copy is a snapshot. Copying shares the
+    root, so it costs O(1) and allocates nothing. insert and erase never
+    change a node that is already linked. They copy the nodes on the
+    search path (and the few a rotation touches) into a new version and
+    share every other subtree with the old one. An update therefore
+    allocates O(log n) nodes, and the versions held elsewhere are
+    unaffected. The tree is kept AVL-balanced; nodes have no parent
+    pointers, which would tie a node to a single version.
+
+    Nodes count the versions and parent nodes that reference them, and
+    the last of those to let go frees the node. The counts are atomic,
+    so versions sharing nodes may be copied, read and destroyed on
+    different threads. A single PersistentSearchTree object is not
+    synchronised: give each thread its own copy.
+
+    Can also be produced by BinarySearchTree::freeze<PersistentSearchTree<K, V>>().
+*/
+template <typename K, typename V, typename Comparator = std::less<K>>
+class PersistentSearchTree
+{
+  public:
+    using key_type        = K;
+    using value_type      = V;
+    using key_compare     = Comparator;
+    using pair            = std::pair<key_type, value_type>;
+    using const_reference = const pair&;
+    using size_type       = size_t;
+
+  private:
+    struct Node {
+        pair element;
+        const Node *left;
+        const Node *right;
+        unsigned char height;
+        mutable std::atomic<size_t> refs{1};
+
+        Node( const_reference e, const Node *lt, const Node *rt, unsigned char h )
+          : element{e}, left{lt}, right{rt}, height{h} { }
+        Node( pair && e, const Node *lt, const Node *rt, unsigned char h )
+          : element{std::move(e)}, left{lt}, right{rt}, height{h} { }
+    };
+    using node_ptr = const Node *;
+
+    // Owns one reference to a node, so a subtree built halfway through
+    // an update is released if a later element copy throws
+    class ref {
+        node_ptr _node = nullptr;
+
+      public:
+        ref() = default;
+        explicit ref( node_ptr n ) : _node{n} { }
+        ref( ref && rhs ) noexcept : _node{rhs.release()} { }
+        ref & operator=( ref && rhs ) noexcept {
+            std::swap(_node, rhs._node);
+            return *this;
+        }
+        ~ref() { drop(_node); }
+
+        node_ptr get() const { return _node; }
+        node_ptr release() { return std::exchange(_node, nullptr); }
+    };
+
+    node_ptr _root = nullptr;
+    size_type _size = 0;
+    key_compare comp;
+
+  public:
+    PersistentSearchTree() : comp{} { }
+    explicit PersistentSearchTree( const key_compare & c ) : comp{c} { }
+
+    // Builds the tree from pairs sorted by strictly increasing key
+    explicit PersistentSearchTree( std::vector<pair> && sorted, const key_compare & c = key_compare{} )
+      : comp{c} {
+        _root = build(sorted, 0, sorted.size()).release();
+        _size = sorted.size();
+    }
+
+    PersistentSearchTree( const PersistentSearchTree & rhs )
+      : _root{share(rhs._root).release()}, _size{rhs._size}, comp{rhs.comp} { }
+    PersistentSearchTree( PersistentSearchTree && rhs ) noexcept
+      : _root{std::exchange(rhs._root, nullptr)}, _size{std::exchange(rhs._size, 0)}, comp{rhs.comp} { }
+    PersistentSearchTree & operator=( const PersistentSearchTree & rhs ) {
+        node_ptr root = share(rhs._root).release();
+        drop(_root);
+        _root = root;
+        _size = rhs._size;
+        comp = rhs.comp;
+        return *this;
+    }
+    PersistentSearchTree & operator=( PersistentSearchTree && rhs ) noexcept {
+        std::swap(_root, rhs._root);
+        std::swap(_size, rhs._size);
+        comp = rhs.comp;
+        return *this;
+    }
+    ~PersistentSearchTree() { drop(_root); }
+
+    // The current version; later updates to this tree leave it alone
+    PersistentSearchTree snapshot() const { return *this; }
+
+    // As BinarySearchTree::insert, an equal key has its value replaced
+    void insert( const_reference x ) {
+        bool added = false;
+        ref root = insert(_root, x, added);
+        drop(std::exchange(_root, root.release()));
+        _size += added;
+    }
+    void erase( const key_type & key ) {
+        if (!contains(key))
+            return;
+        ref root = erase(_root, key);
+        drop(std::exchange(_root, root.release()));
+        _size--;
+    }
+    void clear() {
+        drop(std::exchange(_root, nullptr));
+        _size = 0;
+    }
+
+    bool contains( const key_type & key ) const { return lookup(key) != nullptr; }
+    const value_type & find( const key_type & key ) const { return lookup(key)->element.second; }
+    const_reference min() const {
+        node_ptr t = _root;
+        while (t->left != nullptr)
+            t = t->left;
+        return t->element;
+    }
+    const_reference max() const {
+        node_ptr t = _root;
+        while (t->right != nullptr)
+            t = t->right;
+        return t->element;
+    }
+
+    // Calls visit on every element in key order
+    template <typename F>
+    void for_each( F && visit ) const { in_order(_root, visit); }
+
+    bool empty() const { return _size == 0; }
+    size_type size() const { return _size; }
+    // Nodes on the longest root-to-leaf path
+    size_type height() const { return height(_root); }
+
+    // Whether both versions hold the same root, i.e. one is an unchanged
+    // snapshot of the other
+    bool shares_root( const PersistentSearchTree & other ) const { return _root == other._root; }
+
+  private:
+    static int height( node_ptr t ) { return t == nullptr ? 0 : t->height; }
+
+    static ref share( node_ptr t ) {
+        if (t != nullptr)
+            t->refs.fetch_add(1, std::memory_order_relaxed);
+        return ref(t);
+    }
+
+    // Gives up one reference to t. The last one frees t and gives up its
+    // references to the children: the left by recursion, which the
+    // balance keeps shallow, and the right by looping.
+    static void drop( node_ptr t ) {
+        while (t != nullptr && t->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            node_ptr right = t->right;
+            drop(t->left);
+            delete t;
+            t = right;
+        }
+    }
+
+    // A new node over l and r, which it takes over
+    template <typename E>
+    static ref make( ref l, E && e, ref r ) {
+        int h = 1 + std::max(height(l.get()), height(r.get()));
+        node_ptr n = new Node(std::forward<E>(e), l.get(), r.get(), static_cast<unsigned char>(h));
+        l.release();
+        r.release();
+        return ref(n);
+    }
+
+    // make for subtrees whose heights differ by at most two, rotating
+    // the result into AVL balance. Rotated nodes are rebuilt; their
+    // subtrees are shared.
+    static ref balance( ref l, const_reference e, ref r ) {
+        int hl = height(l.get()), hr = height(r.get());
+        if (hl > hr + 1) {
+            node_ptr a = l.get();
+            if (height(a->left) >= height(a->right))
+                return make(share(a->left), a->element, make(share(a->right), e, std::move(r)));
+            node_ptr b = a->right;
+            ref lower = make(share(a->left), a->element, share(b->left));
+            return make(std::move(lower), b->element, make(share(b->right), e, std::move(r)));
+        }
+        if (hr > hl + 1) {
+            node_ptr a = r.get();
+            if (height(a->right) >= height(a->left))
+                return make(make(std::move(l), e, share(a->left)), a->element, share(a->right));
+            node_ptr b = a->left;
+            ref lower = make(std::move(l), e, share(b->left));
+            return make(std::move(lower), b->element, make(share(b->right), a->element, share(a->right)));
+        }
+        return make(std::move(l), e, std::move(r));
+    }
+
+    ref insert( node_ptr t, const_reference x, bool & added ) const {
+        if (t == nullptr) {
+            added = true;
+            return make(ref(), x, ref());
+        }
+        if (comp(x.first, t->element.first)) {
+            ref l = insert(t->left, x, added);
+            return balance(std::move(l), t->element, share(t->right));
+        }
+        if (comp(t->element.first, x.first)) {
+            ref r = insert(t->right, x, added);
+            return balance(share(t->left), t->element, std::move(r));
+        }
+        return make(share(t->left), x, share(t->right));
+    }
+
+    // key is known to be under t
+    ref erase( node_ptr t, const key_type & key ) const {
+        if (comp(key, t->element.first)) {
+            ref l = erase(t->left, key);
+            return balance(std::move(l), t->element, share(t->right));
+        }
+        if (comp(t->element.first, key)) {
+            ref r = erase(t->right, key);
+            return balance(share(t->left), t->element, std::move(r));
+        }
+        if (t->left == nullptr)
+            return share(t->right);
+        if (t->right == nullptr)
+            return share(t->left);
+
+        // The successor's element takes the erased node's place
+        node_ptr successor = t->right;
+        while (successor->left != nullptr)
+            successor = successor->left;
+        ref r = erase_min(t->right);
+        return balance(share(t->left), successor->element, std::move(r));
+    }
+    static ref erase_min( node_ptr t ) {
+        if (t->left == nullptr)
+            return share(t->right);
+        ref l = erase_min(t->left);
+        return balance(std::move(l), t->element, share(t->right));
+    }
+
+    // Perfectly balanced tree over sorted[first, last)
+    static ref build( std::vector<pair> & sorted, size_type first, size_type last ) {
+        if (first == last)
+            return ref();
+        size_type mid = first + (last - first) / 2;
+        ref l = build(sorted, first, mid);
+        ref r = build(sorted, mid + 1, last);
+        return make(std::move(l), std::move(sorted[mid]), std::move(r));
+    }
+
+    node_ptr lookup( const key_type & key ) const {
+        node_ptr t = _root;
+        while (t != nullptr) {
+            if (comp(key, t->element.first))
+                t = t->left;
+            else if (comp(t->element.first, key))
+                t = t->right;
+            else
+                return t;
+        }
+        return nullptr;
+    }
+
+    template <typename F>
+    static void in_order( node_ptr t, F & visit ) {
+        while (t != nullptr) {
+            in_order(t->left, visit);
+            visit(t->element);
+            t = t->right;
+        }
+    }
+};
@@ -0,0 +1,254 @@
+#pragma once
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional> // std::less
+#include <type_traits>
+#include <utility> // std::pair
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define STATIC_SEARCH_TREE_X86 1
+#endif
+
+// Compare kernels StaticSearchTree can run, from slowest to fastest
+enum class instruction_set { portable, sse4_2, avx2 };
+
+/*
+    Immutable k-ary search tree for 32- and 64-bit integer keys, in the
+    style of FAST / S-trees. Keys are packed into 64-byte blocks of B
+    sorted keys (16 for 32-bit keys, 8 for 64-bit keys), and block k has
+    B + 1 children at k * (B + 1) + 1 .. k * (B + 1) + B + 1. Each level
+    is decided by one vector compare of the probe against the whole
+    block: the number of keys less than the probe is the child to take,
+    so a lookup costs one cache line and no mispredicted branches per
+    log2(B + 1) levels of a binary tree.
+
+    The compare kernel is picked at construction from what the running
+    CPU supports (AVX2, then SSE4.2, then a portable loop), so one binary
+    runs on any x86-64 host. select() overrides the choice.
+
+    Build one with BinarySearchTree::freeze<StaticSearchTree<K, V>>().
+*/
+template <typename K, typename V, typename Comparator = std::less<K>>
+class StaticSearchTree
+{
+    static_assert(std::is_integral<K>::value && (sizeof(K) == 4 || sizeof(K) == 8),
+                  "StaticSearchTree needs 32- or 64-bit integer keys");
+    static_assert(std::is_same<Comparator, std::less<K>>::value,
+                  "StaticSearchTree orders keys with std::less");
+
+  public:
+    using key_type        = K;
+    using value_type      = V;
+    using key_compare     = Comparator;
+    using pair            = std::pair<key_type, value_type>;
+    using const_reference = const pair&;
+    using size_type       = size_t;
+
+    static constexpr size_type block_bytes = 64;
+    static constexpr size_type B = block_bytes / sizeof(K); // keys per block
+
+  private:
+    // Keys are compared as signed integers of the same width; unsigned
+    // keys have their top bit flipped so the order is preserved
+    using lane = typename std::conditional<sizeof(K) == 4, int32_t, int64_t>::type;
+
+    struct alignas(block_bytes) block {
+        lane keys[B];
+    };
+
+    using lookup_fn = size_type (*)( const block *, size_type, lane );
+
+    std::vector<block> _blocks;
+    std::vector<pair> _elements; // _elements[k * B + i] pairs with _blocks[k].keys[i]
+    size_type _size;
+    instruction_set _isa;
+    lookup_fn _lookup;
+
+  public:
+    StaticSearchTree() : _blocks{}, _elements{}, _size{0}, _isa{instruction_set::portable}, _lookup{lookup_portable} {
+        select(detect());
+    }
+
+    // Builds the tree from pairs sorted by strictly increasing key.
+    // Slots past the last pair repeat the largest pair, so lookups need
+    // no special case for them.
+    explicit StaticSearchTree( std::vector<pair> && sorted, const key_compare & = key_compare{} )
+      : StaticSearchTree() {
+        _size = sorted.size();
+        if (_size == 0)
+            return;
+
+        size_type n_blocks = (_size + B - 1) / B;
+        _blocks.resize(n_blocks);
+        _elements.reserve(n_blocks * B);
+        _elements.resize(n_blocks * B, sorted.back());
+
+        size_type next = 0;
+        fill(0, sorted, next);
+    }
+
+    // Uses the given compare kernel. Returns false, keeping the current
+    // one, if this CPU cannot run it.
+    bool select( instruction_set isa ) {
+        if (!supported(isa))
+            return false;
+        _isa = isa;
+        switch (isa) {
+          #ifdef STATIC_SEARCH_TREE_X86
+          case instruction_set::avx2:   _lookup = lookup_avx2; break;
+          case instruction_set::sse4_2: _lookup = lookup_sse4_2; break;
+          #endif
+          default:                      _lookup = lookup_portable; break;
+        }
+        return true;
+    }
+    instruction_set isa() const { return _isa; }
+
+    static bool supported( instruction_set isa ) {
+        switch (isa) {
+          case instruction_set::portable: return true;
+          #ifdef STATIC_SEARCH_TREE_X86
+          case instruction_set::sse4_2:   return __builtin_cpu_supports("sse4.2");
+          case instruction_set::avx2:     return __builtin_cpu_supports("avx2");
+          #endif
+          default:                        return false;
+        }
+    }
+    static instruction_set detect() {
+        if (supported(instruction_set::avx2))
+            return instruction_set::avx2;
+        if (supported(instruction_set::sse4_2))
+            return instruction_set::sse4_2;
+        return instruction_set::portable;
+    }
+
+    const_reference min() const { return _elements[leftmost()]; }
+    const_reference max() const { return _elements[rightmost()]; }
+
+    bool contains( const key_type & x ) const { return lookup( x ) != npos; }
+    const value_type & find( const key_type & key ) const { return _elements[lookup( key )].second; }
+
+    bool empty() const {
+        return _size == 0;
+    }
+    size_type size() const {
+        return _size;
+    }
+
+  private:
+    static constexpr size_type npos = ~size_type(0);
+
+    static lane to_lane( key_type key ) {
+        if constexpr (std::is_unsigned<key_type>::value)
+            return static_cast<lane>(key ^ (key_type(1) << (sizeof(K) * CHAR_BIT - 1)));
+        else
+            return static_cast<lane>(key);
+    }
+
+    static size_type child( size_type k, size_type i ) { return k * (B + 1) + i + 1; }
+
+    // Hands out the sorted pairs to the slots in key order
+    void fill( size_type k, std::vector<pair> & sorted, size_type & next ) {
+        if (k >= _blocks.size())
+            return;
+        for (size_type i = 0; i < B; i++) {
+            fill(child(k, i), sorted, next);
+            if (next < sorted.size())
+                _elements[k * B + i] = std::move(sorted[next++]);
+            _blocks[k].keys[i] = to_lane(_elements[k * B + i].first);
+        }
+        fill(child(k, B), sorted, next);
+    }
+
+    size_type leftmost() const {
+        size_type k = 0;
+        while (child(k, 0) < _blocks.size())
+            k = child(k, 0);
+        return k * B;
+    }
+    // Last slot in key order; it holds the largest pair or padding
+    // repeating it
+    size_type rightmost() const {
+        size_type k = 0;
+        while (child(k, B) < _blocks.size())
+            k = child(k, B);
+        return k * B + B - 1;
+    }
+
+    // Slot of the pair with key, or npos if there is none
+    size_type lookup( const key_type & key ) const {
+        if (_size == 0)
+            return npos;
+        size_type slot = _lookup(_blocks.data(), _blocks.size(), to_lane(key));
+        if (slot == npos || _elements[slot].first != key)
+            return npos;
+        return slot;
+    }
+
+    /*
+        Each kernel descends from the root, counting the keys of the
+        block that are less than x; that count is the child to visit.
+        The first key not less than x is remembered at each level, and
+        the last one remembered is the lower bound of x.
+    */
+    static size_type lookup_portable( const block * blocks, size_type n_blocks, lane x ) {
+        size_type k = 0, slot = npos;
+        while (k < n_blocks) {
+            size_type i = 0;
+            for (size_type j = 0; j < B; j++)
+                i += blocks[k].keys[j] < x;
+            if (i < B)
+                slot = k * B + i;
+            k = child(k, i);
+        }
+        return slot;
+    }
+
+    #ifdef STATIC_SEARCH_TREE_X86
+    __attribute__((target("sse4.2")))
+    static size_type lookup_sse4_2( const block * blocks, size_type n_blocks, lane x ) {
+        size_type k = 0, slot = npos;
+        __m128i probe = sizeof(lane) == 4 ? _mm_set1_epi32(static_cast<int32_t>(x))
+                                          : _mm_set1_epi64x(static_cast<int64_t>(x));
+        while (k < n_blocks) {
+            const __m128i * keys = reinterpret_cast<const __m128i *>(blocks[k].keys);
+            __m128i less[4];
+            for (unsigned j = 0; j < 4; j++)
+                less[j] = sizeof(lane) == 4 ? _mm_cmpgt_epi32(probe, _mm_load_si128(keys + j))
+                                            : _mm_cmpgt_epi64(probe, _mm_load_si128(keys + j));
+            // Narrow the compare results so each 32-bit lane becomes one
+            // byte, then count the set bytes
+            __m128i narrow = _mm_packs_epi16(_mm_packs_epi32(less[0], less[1]), _mm_packs_epi32(less[2], less[3]));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(narrow));
+            size_type i = static_cast<size_type>(__builtin_popcount(mask)) / (sizeof(lane) / 4);
+            if (i < B)
+                slot = k * B + i;
+            k = child(k, i);
+        }
+        return slot;
+    }
+
+    __attribute__((target("avx2")))
+    static size_type lookup_avx2( const block * blocks, size_type n_blocks, lane x ) {
+        size_type k = 0, slot = npos;
+        __m256i probe = sizeof(lane) == 4 ? _mm256_set1_epi32(static_cast<int32_t>(x))
+                                          : _mm256_set1_epi64x(static_cast<int64_t>(x));
+        while (k < n_blocks) {
+            const __m256i * keys = reinterpret_cast<const __m256i *>(blocks[k].keys);
+            __m256i lo = _mm256_load_si256(keys), hi = _mm256_load_si256(keys + 1);
+            __m256i less_lo = sizeof(lane) == 4 ? _mm256_cmpgt_epi32(probe, lo) : _mm256_cmpgt_epi64(probe, lo);
+            __m256i less_hi = sizeof(lane) == 4 ? _mm256_cmpgt_epi32(probe, hi) : _mm256_cmpgt_epi64(probe, hi);
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(less_lo))
+                          | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(less_hi))) << 32;
+            size_type i = static_cast<size_type>(__builtin_popcountll(mask)) / sizeof(lane);
+            if (i < B)
+                slot = k * B + i;
+            k = child(k, i);
+        }
+        return slot;
+    }
+    #endif
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+    Fork-join thread pool for the divide-and-conquer tree algorithms.
+
+    fork_join(a, b) queues b, runs a on the calling thread, and then runs
+    b itself unless a worker has taken it in the meantime, in which case
+    it helps with other queued tasks until b is done. Idle workers take
+    the oldest queued task. In a recursive algorithm that is the largest
+    one, so workers steal big pieces of work and leave the small ones
+    with the thread that forked them. A task lives in the stack frame of
+    the fork_join that queued it.
+
+    A pool of n threads starts n - 1 workers, and the thread calling
+    fork_join is the n-th. With a single thread fork_join runs a and
+    then b.
+*/
+class ThreadPool
+{
+    struct Task {
+        void (*run)( Task * );
+        std::atomic<bool> done{false};
+        std::exception_ptr error;
+
+        explicit Task( void (*r)( Task * ) ) : run{r} { }
+    };
+
+    template <typename F>
+    struct BoundTask : Task {
+        F & f;
+
+        explicit BoundTask( F & fn ) : Task{&invoke}, f{fn} { }
+
+        // The forking thread may return as soon as done is set, so the
+        // task is not touched after that
+        static void invoke( Task * t ) {
+            try {
+                static_cast<BoundTask *>(t)->f();
+            } catch (...) {
+                t->error = std::current_exception();
+            }
+            t->done.store(true, std::memory_order_release);
+        }
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::deque<Task *> _queue;
+    std::vector<std::thread> _workers;
+    bool _stopping = false;
+
+  public:
+    explicit ThreadPool( unsigned threads = std::max(1u, std::thread::hardware_concurrency()) ) {
+        for (unsigned i = 1; i < threads; i++)
+            _workers.emplace_back([this] { work(); });
+    }
+    ThreadPool( const ThreadPool & ) = delete;
+    ThreadPool & operator=( const ThreadPool & ) = delete;
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _ready.notify_all();
+        for (std::thread & w : _workers)
+            w.join();
+    }
+
+    // Threads that run forked tasks, counting the one calling fork_join
+    unsigned size() const { return static_cast<unsigned>(_workers.size()) + 1; }
+
+    // Pool shared by every tree, one thread per hardware thread
+    static ThreadPool & shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    // Runs a and b, possibly in parallel, and returns once both are done.
+    // An exception from either is rethrown here, a's first.
+    template <typename A, typename B>
+    void fork_join( A && a, B && b ) {
+        if (_workers.empty()) {
+            a();
+            b();
+            return;
+        }
+
+        BoundTask<std::remove_reference_t<B>> task(b);
+        push(&task);
+        try {
+            a();
+        } catch (...) {
+            finish(&task);
+            throw;
+        }
+        finish(&task);
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+
+  private:
+    void push( Task * t ) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(t);
+        }
+        _ready.notify_one();
+    }
+
+    // Runs t here if it is still queued (it normally sits at the back),
+    // otherwise helps with other tasks until whoever took it is done
+    void finish( Task * t ) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto it = std::find(_queue.rbegin(), _queue.rend(), t);
+            if (it != _queue.rend()) {
+                _queue.erase(std::next(it).base());
+                lock.unlock();
+                t->run(t);
+                return;
+            }
+        }
+        while (!t->done.load(std::memory_order_acquire)) {
+            if (!run_oldest())
+                std::this_thread::yield();
+        }
+    }
+
+    bool run_oldest() {
+        Task * t;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_queue.empty())
+                return false;
+            t = _queue.front();
+            _queue.pop_front();
+        }
+        t->run(t);
+        return true;
+    }
+
+    void work() {
+        while (true) {
+            Task * t;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _ready.wait(lock, [this] { return _stopping || !_queue.empty(); });
+                if (_queue.empty())
+                    return;
+                t = _queue.front();
+                _queue.pop_front();
+            }
+            t->run(t);
+        }
+    }
+};
@@ -0,0 +1,91 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+/*
+    Applies batches of random inserts and erases drawn by Typegen to a
+    tree of n random keys, once with a loop of insert and erase calls
+    and once with apply_batch. The batch is sorted once. The batches of
+    n / 100 and n / 10 ops are sparse: each chunk of them has its paths
+    prefetched in one pass, with the misses overlapped, before its ops
+    run. The batch of n ops is dense, and each search starts from where
+    the previous key left off. The reported time for apply_batch
+    includes the sort.
+
+    Usage: bench_apply_batch [n]   (default 1000000)
+*/
+
+template<typename Balance>
+void run(char const * name, std::vector<int> const & keys, size_t batch_size) {
+    using Tree = BinarySearchTree<int, int, std::less<int>, Balance>;
+    using op = typename Tree::op;
+
+    // Half the ops erase distinct keys of the tree, so the unbalanced
+    // erase never reports a miss; the rest insert fresh random keys
+    Typegen t;
+    std::vector<int> victims = keys;
+    t.shuffle(victims.begin(), victims.end());
+    std::vector<op> batch(batch_size);
+    for(size_t i = 0; i < batch_size; i++) {
+        if(i % 2 == 0)
+            batch[i] = { op::erase, { victims[i / 2], 0 } };
+        else
+            batch[i] = { op::insert, { t.get<int>(), static_cast<int>(i) } };
+    }
+
+    Tree looped, batched;
+    for(int key : keys) {
+        looped.insert({ key, key });
+        batched.insert({ key, key });
+    }
+
+    double loop = time_ms([&] {
+        for(auto const & o : batch) {
+            if(o.kind == op::insert)
+                looped.insert(o.element);
+            else
+                looped.erase(o.element.first);
+        }
+    });
+    double apply = time_ms([&] { batched.apply_batch(batch); });
+    do_not_optimize(looped);
+    do_not_optimize(batched);
+
+    std::cout << std::setw(10) << name
+              << std::setw(10) << keys.size()
+              << std::setw(10) << batch_size
+              << std::setw(12) << std::fixed << std::setprecision(1) << loop
+              << std::setw(12) << apply
+              << std::setw(10) << std::setprecision(2) << loop / apply
+              << (looped.size() == batched.size() ? "" : "  MISMATCH")
+              << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    Typegen t;
+    std::vector<int> keys(n);
+    for(int & key : keys)
+        key = t.get<int>();
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    t.shuffle(keys.begin(), keys.end());
+
+    std::cout << std::setw(10) << "balance"
+              << std::setw(10) << "n"
+              << std::setw(10) << "batch"
+              << std::setw(12) << "loop ms"
+              << std::setw(12) << "batch ms"
+              << std::setw(10) << "speedup" << std::endl;
+
+    for(size_t batch = n / 100; batch <= n; batch *= 10) {
+        run<balance::none>("none", keys, batch);
+        run<balance::red_black>("red_black", keys, batch);
+        run<balance::avl>("avl", keys, batch);
+    }
+}
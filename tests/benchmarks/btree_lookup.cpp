@@ -0,0 +1,65 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "BTree.h"
+#include "typegen.h"
+
+#include <cstdlib>
+#include <vector>
+
+/*
+    Random point lookups on large trees. A binary tree takes a cache
+    miss at nearly every one of its ~log2(n) levels once the tree
+    outgrows the cache; the B-tree packs 7 or 15 keys per node and so
+    descends only log_8(n) or log_16(n) levels.
+
+    Usage: bench_btree_lookup [max_n]   (default 10000000)
+*/
+
+template<typename Tree>
+void run(char const * name, std::vector<int> const & keys, std::vector<int> const & probes) {
+    Tree tree;
+    double build = time_ms([&] {
+        for(int key : keys)
+            tree.insert({ key, key });
+    });
+
+    long long sum = 0;
+    double ms = time_ms([&] {
+        for(int key : probes)
+            sum += tree.find(key);
+    });
+    do_not_optimize(sum);
+
+    std::cout << std::setw(14) << name
+              << std::setw(11) << keys.size()
+              << std::setw(12) << std::fixed << std::setprecision(1) << build
+              << std::setw(14) << std::setprecision(1) << 1e6 * ms / probes.size()
+              << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t const lookups = 2000000;
+
+    std::cout << std::setw(14) << "tree"
+              << std::setw(11) << "n"
+              << std::setw(12) << "build ms"
+              << std::setw(14) << "ns/lookup" << std::endl;
+
+    for(size_t n = 10000; n <= max_n; n *= 10) {
+        Typegen t;
+        std::vector<int> keys(n);
+        for(int & key : keys)
+            key = t.get<int>();
+
+        std::vector<int> probes(lookups);
+        for(int & probe : probes)
+            probe = keys[t.range<size_t>(n)];
+
+        run<BinarySearchTree<int, int, std::less<int>, balance::red_black>>("red_black", keys, probes);
+        run<BinarySearchTree<int, int, std::less<int>, balance::avl>>("avl", keys, probes);
+        run<BTree<int, int, std::less<int>, 64>>("btree<64>", keys, probes);
+        run<BTree<int, int, std::less<int>, 128>>("btree<128>", keys, probes);
+        run<BTree<int, int, std::less<int>, 256>>("btree<256>", keys, probes);
+    }
+}
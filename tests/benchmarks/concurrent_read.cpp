@@ -0,0 +1,135 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "ConcurrentSearchTree.h"
+#include "typegen.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Readers look up random keys while one writer keeps inserting and
+    erasing. Compares a red-black tree behind a mutex with
+    ConcurrentSearchTree for 1, 2, 4, ... readers up to the reader
+    count given (default: every hardware thread). Each reader does the
+    same number of finds; the writer runs until the last reader is done.
+    Reports the finds per microsecond over all readers and the scaling
+    relative to a single reader.
+
+    Usage: bench_concurrent_read [max readers] [n]   (default n 1000000)
+*/
+
+using Locked = BinarySearchTree<int, int, std::less<int>, balance::red_black>;
+using Concurrent = ConcurrentSearchTree<int, int>;
+
+size_t const finds_per_reader = 1000000;
+
+struct LockedTree {
+    Locked tree;
+    std::mutex mutex;
+
+    void insert(std::pair<int, int> const & x) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tree.insert(x);
+    }
+    void erase(int key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tree.erase(key);
+    }
+
+    struct reader {
+        LockedTree & owner;
+        bool contains(int key) const {
+            std::lock_guard<std::mutex> lock(owner.mutex);
+            return owner.tree.contains(key);
+        }
+    };
+    reader register_reader() { return reader{ *this }; }
+};
+
+// Finds per microsecond with the given number of readers
+template<typename Tree>
+double run(Tree & tree, std::vector<int> const & keys, unsigned readers) {
+    std::atomic<bool> go{false};
+    std::atomic<unsigned> running{readers};
+    std::atomic<size_t> hits{0};
+
+    std::vector<std::thread> threads;
+    for(unsigned r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            auto reader = tree.register_reader();
+            Typegen t;
+            std::vector<int> order(finds_per_reader);
+            for(int & key : order)
+                key = keys[t.range<size_t>(keys.size())];
+
+            while(!go.load())
+                std::this_thread::yield();
+            size_t found = 0;
+            for(int key : order)
+                found += reader.contains(key);
+            hits += found;
+            running--;
+        });
+    }
+
+    Typegen t;
+    double ms = time_ms([&] {
+        go = true;
+        // Writer: keys outside the readers' set come and go
+        while(running.load() > 0) {
+            int key = -1 - t.range(0, static_cast<int>(keys.size()));
+            tree.insert({ key, key });
+            tree.erase(key);
+        }
+        for(auto & thread : threads)
+            thread.join();
+    });
+    do_not_optimize(hits);
+    return readers * finds_per_reader / (ms * 1000);
+}
+
+int main(int argc, char ** argv) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned max_readers = argc > 1 ? std::max(1, std::atoi(argv[1])) : cores;
+    size_t n = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+    Typegen t;
+    std::vector<int> keys(n);
+    t.fill_unique(keys.begin(), keys.end());
+    // The writer's keys are negative
+    for(int & key : keys)
+        key = key < 0 ? -(key + 1) : key;
+
+    LockedTree locked;
+    for(int key : keys)
+        locked.tree.insert({ key, key });
+    Concurrent concurrent = locked.tree.freeze<Concurrent>();
+
+    std::cout << "hardware threads: " << cores << ", nodes: " << concurrent.size() << std::endl
+              << std::setw(10) << "readers"
+              << std::setw(14) << "mutex/us"
+              << std::setw(10) << "scaling"
+              << std::setw(14) << "lock-free/us"
+              << std::setw(10) << "scaling" << std::endl;
+
+    double locked_one = 0, concurrent_one = 0;
+    for(unsigned readers = 1; ; readers = std::min(2 * readers, max_readers)) {
+        double l = run(locked, keys, readers);
+        double c = run(concurrent, keys, readers);
+        if(readers == 1) {
+            locked_one = l;
+            concurrent_one = c;
+        }
+
+        std::cout << std::setw(10) << readers
+                  << std::setw(14) << std::fixed << std::setprecision(2) << l
+                  << std::setw(10) << l / locked_one
+                  << std::setw(14) << c
+                  << std::setw(10) << c / concurrent_one << std::endl;
+        if(readers >= max_readers)
+            break;
+    }
+}
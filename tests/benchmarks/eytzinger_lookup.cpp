@@ -0,0 +1,70 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+/*
+    Random point lookups against a read-only copy of a large tree: the
+    live red-black tree, std::lower_bound over a sorted vector, and the
+    Eytzinger snapshot returned by freeze(). Binary search over a sorted
+    array misses the cache on its late, far-apart probes and mispredicts
+    every comparison; the Eytzinger layout keeps the hot top levels
+    together and prefetches ahead of a branchless descent.
+
+    Half of the probes hit a stored key and half miss.
+
+    Usage: bench_eytzinger_lookup [max_n]   (default 10000000)
+*/
+
+template<typename F>
+void run(char const * name, size_t n, std::vector<int> const & probes, F && contains) {
+    long long sum = 0;
+    double ms = time_ms([&] {
+        for(int key : probes)
+            sum += contains(key);
+    });
+    do_not_optimize(sum);
+
+    std::cout << std::setw(14) << name
+              << std::setw(11) << n
+              << std::setw(14) << std::fixed << std::setprecision(1) << 1e6 * ms / probes.size()
+              << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t const lookups = 2000000;
+
+    std::cout << std::setw(14) << "layout"
+              << std::setw(11) << "n"
+              << std::setw(14) << "ns/lookup" << std::endl;
+
+    for(size_t n = 10000; n <= max_n; n *= 10) {
+        Typegen t;
+        std::vector<int> keys(n);
+        for(int & key : keys)
+            key = t.get<int>();
+
+        std::vector<int> probes(lookups);
+        for(size_t i = 0; i < lookups; i++)
+            probes[i] = i % 2 ? t.get<int>() : keys[t.range<size_t>(n)];
+
+        BinarySearchTree<int, int, std::less<int>, balance::red_black> tree;
+        for(int key : keys)
+            tree.insert({ key, key });
+        auto frozen = tree.freeze();
+
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        run("red_black", n, probes, [&](int key) { return tree.contains(key); });
+        run("lower_bound", n, probes, [&](int key) {
+            auto it = std::lower_bound(keys.begin(), keys.end(), key);
+            return it != keys.end() && *it == key;
+        });
+        run("eytzinger", n, probes, [&](int key) { return frozen.contains(key); });
+    }
+}
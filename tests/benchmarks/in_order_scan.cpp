@@ -0,0 +1,74 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+/*
+    Sums every value of a tree in key order through its iterators and
+    compares the scan against the same walk over a std::map holding the
+    same keys. Both containers step through parent pointers, so the
+    difference left is node layout and allocation order.
+
+    Usage: bench_in_order_scan [max_n]   (default 10000000)
+*/
+
+template<typename Container>
+double scan(Container const & c, int rounds) {
+    long long sum = 0;
+    double ms = time_ms([&] {
+        for(int r = 0; r < rounds; r++)
+            for(auto const & [key, value] : c)
+                sum += value;
+    });
+    do_not_optimize(sum);
+    return ms / rounds;
+}
+
+int main(int argc, char ** argv) {
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    std::cout << std::setw(10) << "n"
+              << std::setw(14) << "std::map ms"
+              << std::setw(14) << "heap ms"
+              << std::setw(14) << "pool ms"
+              << std::setw(14) << "heap ns/elt" << std::endl;
+
+    for(size_t n = 10000; n <= max_n; n *= 10) {
+        Typegen t;
+        std::vector<int> keys(n);
+        for(int & key : keys)
+            key = t.get<int>();
+
+        int rounds = static_cast<int>(std::max<size_t>(1, 10000000 / n));
+
+        double map_ms, heap_ms, pool_ms;
+        {
+            std::map<int, int> map;
+            for(int key : keys)
+                map.emplace(key, key);
+            map_ms = scan(map, rounds);
+        }
+        {
+            BinarySearchTree<int, int, std::less<int>, balance::red_black> tree;
+            for(int key : keys)
+                tree.insert({ key, key });
+            heap_ms = scan(tree, rounds);
+        }
+        {
+            BinarySearchTree<int, int, std::less<int>, balance::red_black, storage::pool> tree;
+            for(int key : keys)
+                tree.insert({ key, key });
+            pool_ms = scan(tree, rounds);
+        }
+
+        std::cout << std::setw(10) << n
+                  << std::setw(14) << std::fixed << std::setprecision(2) << map_ms
+                  << std::setw(14) << heap_ms
+                  << std::setw(14) << pool_ms
+                  << std::setw(14) << heap_ms * 1e6 / n
+                  << std::endl;
+    }
+}
@@ -0,0 +1,67 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <cstdlib>
+#include <vector>
+
+/*
+    Builds a red-black tree, churns it with interleaved erases and
+    inserts at a steady size, and clears it, once with a new/delete per
+    node (storage::heap) and once with the slab pool (storage::pool).
+    The pool skips the general-purpose allocator on every operation
+    after warm-up and frees whole slabs on clear.
+
+    Usage: bench_node_churn [max_n]   (default 1000000)
+*/
+
+template<typename Storage>
+void run(char const * name, std::vector<int> const & keys, std::vector<int> const & churn, bool huge = false) {
+    BinarySearchTree<int, int, std::less<int>, balance::red_black, Storage> tree;
+    if constexpr (std::is_same_v<Storage, storage::pool>) {
+        if(huge)
+            tree.use_huge_pages();
+    }
+
+    double build = time_ms([&] {
+        for(int key : keys)
+            tree.insert({ key, key });
+    });
+    double ops = time_ms([&] {
+        for(size_t i = 0; i < churn.size(); i++) {
+            tree.erase(keys[i % keys.size()]);
+            tree.insert({ churn[i], churn[i] });
+        }
+    });
+    double clear = time_ms([&] { tree.clear(); });
+
+    std::cout << std::setw(12) << name
+              << std::setw(10) << keys.size()
+              << std::setw(12) << std::fixed << std::setprecision(1) << build
+              << std::setw(12) << ops
+              << std::setw(12) << clear
+              << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::cout << std::setw(12) << "storage"
+              << std::setw(10) << "n"
+              << std::setw(12) << "build ms"
+              << std::setw(12) << "churn ms"
+              << std::setw(12) << "clear ms" << std::endl;
+
+    for(size_t n = 10000; n <= max_n; n *= 10) {
+        Typegen t;
+        std::vector<int> keys(n), churn(2 * n);
+        for(int & key : keys)
+            key = t.get<int>();
+        for(int & key : churn)
+            key = t.get<int>();
+
+        run<storage::heap>("heap", keys, churn);
+        run<storage::pool>("pool", keys, churn);
+        run<storage::pool>("pool+thp", keys, churn, true);
+    }
+}
@@ -0,0 +1,52 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <cstdlib>
+#include <optional>
+#include <thread>
+
+/*
+    Copy a red-black tree of n random keys on pools of 1, 2, 4, ... up
+    to every hardware thread. The one-thread pool takes the sequential
+    clone; the others fork the top levels of the copy. Each copy is
+    timed with its destruction excluded.
+
+    Usage: bench_parallel_clone [n]   (default 4000000)
+*/
+
+using Tree = BinarySearchTree<int, int, std::less<int>, balance::red_black>;
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    Typegen t;
+    Tree tree;
+    for(size_t i = 0; i < n; i++)
+        tree.insert({ t.get<int>(), static_cast<int>(i) });
+
+    std::cout << "threads: " << cores << ", nodes: " << tree.size() << std::endl
+              << std::setw(10) << "pool"
+              << std::setw(12) << "ms"
+              << std::setw(12) << "speedup" << std::endl;
+
+    double serial = 0;
+    for(unsigned threads = 1; ; threads = std::min(2 * threads, cores)) {
+        ThreadPool pool(threads);
+        double ms = 0;
+        {
+            std::optional<Tree> copy;
+            ms = time_ms([&] { copy.emplace(tree, pool); });
+            do_not_optimize(*copy);
+        }
+        if(threads == 1)
+            serial = ms;
+
+        std::cout << std::setw(10) << threads
+                  << std::setw(12) << std::fixed << std::setprecision(1) << ms
+                  << std::setw(12) << std::setprecision(2) << serial / ms << std::endl;
+        if(threads == cores)
+            break;
+    }
+}
@@ -0,0 +1,63 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <cstdlib>
+#include <memory_resource>
+#include <vector>
+
+/*
+    A request-scoped tree: build it, then throw it away. Compares the
+    default allocator, a std::pmr monotonic buffer (node deallocation
+    is free, but destruction still visits every node), and the same
+    buffer under storage::pool, where a tree of trivially destructible
+    elements is torn down slab by slab without visiting its nodes.
+
+    Usage: bench_pmr_arena [max_n]   (default 1000000)
+*/
+
+template<typename Tree, typename... Args>
+void run(char const * name, std::vector<int> const & keys, Args &&... args) {
+    double build, teardown;
+    {
+        auto tree = std::make_unique<Tree>(std::forward<Args>(args)...);
+        build = time_ms([&] {
+            for(int key : keys)
+                tree->insert({ key, key });
+        });
+        teardown = time_ms([&] { tree.reset(); });
+    }
+
+    std::cout << std::setw(14) << name
+              << std::setw(10) << keys.size()
+              << std::setw(12) << std::fixed << std::setprecision(1) << build
+              << std::setw(14) << std::setprecision(2) << teardown
+              << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::cout << std::setw(14) << "allocator"
+              << std::setw(10) << "n"
+              << std::setw(12) << "build ms"
+              << std::setw(14) << "teardown ms" << std::endl;
+
+    using rb = balance::red_black;
+    for(size_t n = 10000; n <= max_n; n *= 10) {
+        Typegen t;
+        std::vector<int> keys(n);
+        for(int & key : keys)
+            key = t.get<int>();
+
+        run<BinarySearchTree<int, int, std::less<int>, rb>>("std::allocator", keys);
+        {
+            std::pmr::monotonic_buffer_resource arena;
+            run<pmr::BinarySearchTree<int, int, std::less<int>, rb>>("pmr", keys, &arena);
+        }
+        {
+            std::pmr::monotonic_buffer_resource arena;
+            run<pmr::BinarySearchTree<int, int, std::less<int>, rb, storage::pool>>("pmr+pool", keys, &arena);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "tree_asserts.h"
+#include "typegen.h"
+
+#include <vector>
+
+/*
+    A 95% find / 5% insert workload over random keys. Reports the
+    average number of comparator calls made by each find along with
+    the wall time for the whole run.
+*/
+
+template<typename Balance>
+void run(char const * name, size_t n, size_t ops) {
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, Balance>;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+
+    Typegen t;
+    std::vector<int> keys(n);
+    t.fill_unique(keys.begin(), keys.end());
+
+    Tree tree;
+    for(int key : keys)
+        tree.insert({ key, key });
+
+    size_t finds = 0, find_comparisons = 0;
+    long long sum = 0;
+
+    double ms = time_ms([&] {
+        for(size_t i = 0; i < ops; i++) {
+            if(t.range<size_t>(100) < 95) {
+                int key = keys[t.range<size_t>(keys.size())];
+                comparisons = 0;
+                sum += tree.find(key);
+                find_comparisons += comparisons;
+                finds++;
+            } else {
+                int key = t.get<int>();
+                tree.insert({ key, key });
+                keys.push_back(key);
+            }
+        }
+    });
+    do_not_optimize(sum);
+
+    std::cout << std::setw(10) << name
+              << std::setw(10) << n
+              << std::setw(16) << std::fixed << std::setprecision(2)
+              << static_cast<double>(find_comparisons) / finds
+              << std::setw(12) << std::setprecision(3) << ms << std::endl;
+}
+
+int main() {
+    std::cout << std::setw(10) << "balance"
+              << std::setw(10) << "n"
+              << std::setw(16) << "cmp/find"
+              << std::setw(12) << "ms" << std::endl;
+
+    size_t const ops = 1000000;
+    for(size_t n = 1000; n <= 1000000; n *= 10) {
+        run<balance::none>("none", n, ops);
+        run<balance::red_black>("red_black", n, ops);
+        run<balance::avl>("avl", n, ops);
+    }
+}
@@ -0,0 +1,96 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+/*
+    Union and intersection of a red-black tree of n random keys with one
+    of m random keys. The baseline walks the smaller tree and looks each
+    key up in the larger one with contains, inserting into (or copying
+    out of) the larger tree. merge_union and intersect split and join
+    instead, in O(m log(n/m + 1)), forking onto pools of 1 and of every
+    hardware thread. Building the input trees is not timed.
+
+    Usage: bench_set_algebra [n]   (default 1000000)
+*/
+
+using Tree = BinarySearchTree<int, int, std::less<int>, balance::red_black>;
+
+Tree make_tree(std::vector<int> const & keys) {
+    Tree tree;
+    for(int key : keys)
+        tree.insert({ key, key });
+    return tree;
+}
+
+void run(std::vector<int> const & large, std::vector<int> const & small) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool serial(1), parallel(cores);
+
+    Tree a = make_tree(large), b = make_tree(small);
+    double loop_union = time_ms([&] {
+        for(auto const & [key, value] : b)
+            if(!a.contains(key))
+                a.insert({ key, value });
+    });
+    do_not_optimize(a);
+
+    a = make_tree(large);
+    Tree common;
+    double loop_intersect = time_ms([&] {
+        for(auto const & [key, value] : b)
+            if(a.contains(key))
+                common.insert({ key, value });
+    });
+    do_not_optimize(common);
+
+    auto timed = [&](auto op, ThreadPool & pool) {
+        Tree x = make_tree(large), y = make_tree(small);
+        Tree result;
+        double ms = time_ms([&] { result = op(std::move(x), std::move(y), pool); });
+        do_not_optimize(result);
+        return ms;
+    };
+    auto unite = [](Tree && x, Tree && y, ThreadPool & pool) { return Tree::merge_union(std::move(x), std::move(y), pool); };
+    auto meet = [](Tree && x, Tree && y, ThreadPool & pool) { return Tree::intersect(std::move(x), std::move(y), pool); };
+
+    std::cout << std::setw(10) << large.size()
+              << std::setw(10) << small.size()
+              << std::setw(12) << std::fixed << std::setprecision(1) << loop_union
+              << std::setw(12) << timed(unite, serial)
+              << std::setw(12) << timed(unite, parallel)
+              << std::setw(12) << loop_intersect
+              << std::setw(12) << timed(meet, serial)
+              << std::setw(12) << timed(meet, parallel)
+              << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    Typegen t;
+    std::vector<int> large(n);
+    for(int & key : large)
+        key = t.range(0, static_cast<int>(2 * n));
+
+    std::cout << "threads: " << cores << std::endl
+              << std::setw(10) << "n"
+              << std::setw(10) << "m"
+              << std::setw(12) << "loop U"
+              << std::setw(12) << "union 1"
+              << std::setw(12) << "union all"
+              << std::setw(12) << "loop I"
+              << std::setw(12) << "meet 1"
+              << std::setw(12) << "meet all" << std::endl;
+
+    for(size_t m = n / 1000; m <= n; m *= 10) {
+        std::vector<int> small(m);
+        for(int & key : small)
+            key = t.range(0, static_cast<int>(2 * n));
+        run(large, small);
+    }
+}
@@ -0,0 +1,77 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "typegen.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/*
+    Random point lookups on integer keys: the live red-black tree, the
+    Eytzinger snapshot, and the k-ary StaticSearchTree with each compare
+    kernel this CPU supports. Half of the probes hit a stored key.
+
+    Usage: bench_simd_lookup [max_n]   (default 10000000)
+*/
+
+template<typename K, typename F>
+void run(char const * name, size_t n, std::vector<K> const & probes, F && contains) {
+    long long sum = 0;
+    double ms = time_ms([&] {
+        for(K key : probes)
+            sum += contains(key);
+    });
+    do_not_optimize(sum);
+
+    std::cout << std::setw(22) << name
+              << std::setw(11) << n
+              << std::setw(14) << std::fixed << std::setprecision(1) << 1e6 * ms / probes.size()
+              << std::endl;
+}
+
+template<typename K>
+void run_all(char const * type, size_t max_n) {
+    size_t const lookups = 2000000;
+
+    std::cout << type << std::endl;
+    for(size_t n = 10000; n <= max_n; n *= 10) {
+        Typegen t;
+        std::vector<K> keys(n);
+        for(K & key : keys)
+            key = t.get<K>();
+
+        std::vector<K> probes(lookups);
+        for(size_t i = 0; i < lookups; i++)
+            probes[i] = i % 2 ? t.get<K>() : keys[t.range<size_t>(n)];
+
+        BinarySearchTree<K, int, std::less<K>, balance::red_black> tree;
+        for(K key : keys)
+            tree.insert({ key, 0 });
+        auto frozen = tree.freeze();
+        auto fast = tree.template freeze<StaticSearchTree<K, int>>();
+
+        run("red_black", n, probes, [&](K key) { return tree.contains(key); });
+        run("eytzinger", n, probes, [&](K key) { return frozen.contains(key); });
+
+        std::pair<instruction_set, char const *> kernels[] = {
+            { instruction_set::portable, "static/portable" },
+            { instruction_set::sse4_2, "static/sse4.2" },
+            { instruction_set::avx2, "static/avx2" },
+        };
+        for(auto const & [level, name] : kernels) {
+            if(fast.select(level))
+                run(name, n, probes, [&](K key) { return fast.contains(key); });
+        }
+    }
+}
+
+int main(int argc, char ** argv) {
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    std::cout << std::setw(22) << "layout"
+              << std::setw(11) << "n"
+              << std::setw(14) << "ns/lookup" << std::endl;
+
+    run_all<int>("int", max_n);
+    run_all<uint64_t>("uint64_t", max_n);
+}
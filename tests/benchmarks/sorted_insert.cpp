@@ -0,0 +1,96 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "tree_asserts.h"
+
+/*
+    Insert the keys 0, 1, ..., n - 1 in order. The unbalanced
+    tree degenerates into a linked list and makes O(n^2)
+    comparisons while the red-black tree makes O(n log n).
+    assign_sorted builds the same keys into a balanced tree with no
+    comparisons at all. append_max compares each key with the current
+    maximum only, n comparisons in all, and links it below the cached
+    largest node, so even the unbalanced chain costs O(1) per key.
+*/
+
+template<typename Balance, bool Append = false>
+void run(char const * name, size_t n) {
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, Balance>;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+
+    Tree tree;
+    comparisons = 0;
+    double ms = time_ms([&] {
+        for(size_t i = 0; i < n; i++) {
+            if constexpr (Append)
+                tree.append_max({ static_cast<int>(i), static_cast<int>(i) });
+            else
+                tree.insert({ static_cast<int>(i), static_cast<int>(i) });
+        }
+    });
+    do_not_optimize(tree);
+
+    std::cout << std::setw(10) << name
+              << std::setw(10) << n
+              << std::setw(14) << comparisons
+              << std::setw(14) << std::fixed << std::setprecision(2) << comparisons / n_log2_n(n)
+              << std::setw(12) << std::setprecision(3) << ms << std::endl;
+}
+
+void run_bulk(size_t n) {
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor>;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+
+    std::vector<std::pair<int, int>> pairs(n);
+    for(size_t i = 0; i < n; i++)
+        pairs[i] = { static_cast<int>(i), static_cast<int>(i) };
+
+    Tree tree;
+    comparisons = 0;
+    double ms = time_ms([&] { tree.assign_sorted(pairs.begin(), pairs.end()); });
+    do_not_optimize(tree);
+
+    std::cout << std::setw(10) << "bulk"
+              << std::setw(10) << n
+              << std::setw(14) << comparisons
+              << std::setw(14) << std::fixed << std::setprecision(2) << comparisons / n_log2_n(n)
+              << std::setw(12) << std::setprecision(3) << ms << std::endl;
+}
+
+// Times equal batches of appends as the unbalanced chain grows. With
+// the largest node cached the last batch takes as long as the first;
+// walking down the chain to it each time would make the last of eight
+// batches about fifteen times slower.
+void run_chain_batches(size_t batch, size_t batches) {
+    BinarySearchTree<int, int> chain;
+    std::cout << std::endl << std::setw(10) << "batch"
+              << std::setw(10) << "chain"
+              << std::setw(12) << "ms" << std::endl;
+    int key = 0;
+    for(size_t b = 0; b < batches; b++) {
+        double ms = time_ms([&] {
+            for(size_t i = 0; i < batch; i++, key++)
+                chain.append_max({ key, key });
+        });
+        std::cout << std::setw(10) << b
+                  << std::setw(10) << chain.size()
+                  << std::setw(12) << std::fixed << std::setprecision(3) << ms << std::endl;
+    }
+    do_not_optimize(chain);
+}
+
+int main() {
+    std::cout << std::setw(10) << "balance"
+              << std::setw(10) << "n"
+              << std::setw(14) << "comparisons"
+              << std::setw(14) << "cmp/(nlogn)"
+              << std::setw(12) << "ms" << std::endl;
+
+    for(size_t n = 1000; n <= 32000; n *= 2) {
+        run<balance::none>("none", n);
+        run<balance::none, true>("none+app", n);
+        run<balance::red_black>("red_black", n);
+        run<balance::red_black, true>("append", n);
+        run_bulk(n);
+    }
+    run_chain_batches(1 << 15, 8);
+}
@@ -0,0 +1,93 @@
+#include "benchmark.h"
+#include "BinarySearchTree.h"
+#include "tree_asserts.h"
+#include "typegen.h"
+
+#include <algorithm>
+#include <vector>
+
+/*
+    Lookups whose key popularity follows a Zipf distribution with
+    exponent s: the key of rank r is requested with probability
+    proportional to 1 / r^s. The splay tree keeps the hot keys near
+    the root so they cost a few comparisons each.
+*/
+
+// Draw ranks by inverting the cumulative distribution
+class Zipf {
+    std::vector<double> cdf;
+
+    public:
+
+    Zipf(size_t n, double s) : cdf(n) {
+        double sum = 0;
+        for(size_t r = 0; r < n; r++)
+            cdf[r] = sum += 1 / std::pow(r + 1, s);
+        for(double & c : cdf)
+            c /= sum;
+    }
+
+    size_t operator()(Typegen & t) const {
+        double u = t.get<double>();
+        return std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    }
+};
+
+template<typename Balance>
+void run(char const * name, double s, std::vector<int> const & keys,
+         std::vector<int> const & by_rank, std::vector<size_t> const & ranks) {
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, Balance>;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+
+    Tree tree;
+    for(int key : keys)
+        tree.insert({ key, key });
+
+    long long sum = 0;
+    comparisons = 0;
+    double ms = time_ms([&] {
+        for(size_t rank : ranks)
+            sum += tree.find(by_rank[rank]);
+    });
+    do_not_optimize(sum);
+
+    std::cout << std::setw(10) << name
+              << std::setw(6) << std::setprecision(1) << s
+              << std::setw(10) << keys.size()
+              << std::setw(16) << std::setprecision(2)
+              << static_cast<double>(comparisons) / ranks.size()
+              << std::setw(12) << std::setprecision(3) << ms << std::endl;
+}
+
+int main() {
+    std::cout << std::fixed;
+    std::cout << std::setw(10) << "balance"
+              << std::setw(6) << "s"
+              << std::setw(10) << "n"
+              << std::setw(16) << "cmp/find"
+              << std::setw(12) << "ms" << std::endl;
+
+    size_t const ops = 2000000;
+
+    for(double s : { 1.2, 1.8 }) {
+        for(size_t n = 10000; n <= 1000000; n *= 10) {
+            Typegen t;
+
+            std::vector<int> keys(n);
+            t.fill_unique(keys.begin(), keys.end());
+
+            // Popularity is independent of insertion order
+            std::vector<int> by_rank = keys;
+            t.shuffle(by_rank.begin(), by_rank.end());
+
+            Zipf zipf(n, s);
+            std::vector<size_t> ranks(ops);
+            for(size_t & rank : ranks)
+                rank = zipf(t);
+
+            run<balance::none>("none", s, keys, by_rank, ranks);
+            run<balance::red_black>("red_black", s, keys, by_rank, ranks);
+            run<balance::splay>("splay", s, keys, by_rank, ranks);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+
+// COMMON HEADER FOR BENCHMARKS
+// Benchmarks are standalone programs in ./benchmarks built
+// with optimizations and without Memhook so allocations are
+// not instrumented. Run them with make bench/<name>.
+
+// Time a callable in milliseconds
+template<typename F>
+double time_ms(F && f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Keep the optimizer from discarding a computed result
+template<typename T>
+void do_not_optimize(T const & value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+inline double n_log2_n(std::size_t n) {
+    return n * std::log2(static_cast<double>(n));
+}
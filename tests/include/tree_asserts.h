@@ -4,8 +4,8 @@
 #define TREE_ASSERT_PRINT_SZ_LIMIT 15
 #endif
 
-template<typename K, typename V, typename C>
-std::ostream & maybe_print_tree(std::ostream & o, BinarySearchTree<K, V, C> const & tree) {
+template<typename K, typename V, typename C, typename... Policies>
+std::ostream & maybe_print_tree(std::ostream & o, BinarySearchTree<K, V, C, Policies...> const & tree) {
     #if defined(TREE_ASSERT_VIZ) || defined(TREE_ASSERT_PRINT)
     size_t sz = tree.size();
     if(sz <= TREE_ASSERT_PRINT_SZ_LIMIT) {
@@ -25,11 +25,11 @@ std::ostream & maybe_print_tree(std::ostream & o, BinarySearchTree<K, V, C> cons
     return o;
 }
 
-template<typename K, typename V, typename C>
+template<typename K, typename V, typename C, typename... Policies>
 std::ostream & _assert_value_exists_in_tree(
     std::ostream & o, 
     V const & expected_value, 
-    BinarySearchTree<K, V, C> const & tree, 
+    BinarySearchTree<K, V, C, Policies...> const & tree, 
     K const & key
 ) {
     const V & value = tree.find(key);
@@ -60,11 +60,11 @@ namespace {
 }
 
 
-template<typename K, typename V, typename C>
+template<typename K, typename V, typename C, typename... Policies>
 std::ostream & _tree_pairs_contained_and_found(
     std::ostream & o, 
     std::vector<std::pair<K, V>> const & pairs, 
-    BinarySearchTree<K, V, C> const & tree
+    BinarySearchTree<K, V, C, Policies...> const & tree
 ) {
     
     for(auto const & [key, expected_value] : pairs) {
@@ -100,12 +100,12 @@ struct comparison_tracking_comparitor {
 
 size_t comparison_tracking_comparitor::comparisons = 0;
 
-template<typename K, typename V>
+template<typename K, typename V, typename... Policies>
 std::ostream & _assert_insertion_comparisons_between(
     std::ostream & o, 
     size_t lower_bound,
     size_t upper_bound,
-    BinarySearchTree<K, V, comparison_tracking_comparitor> & tree,
+    BinarySearchTree<K, V, comparison_tracking_comparitor, Policies...> & tree,
     typename BinarySearchTree<K, V>::pair const & pair 
     ) {
     size_t & comparisons = comparison_tracking_comparitor::comparisons;
@@ -130,3 +130,31 @@ std::ostream & _assert_insertion_comparisons_between(
 
 #define INSERT_AND_ASSERT_COMPARISONS_BETWEEN(lower_bound, upper_bound, tree, pair) \
     MK_ASSERT(_assert_insertion_comparisons_between, lower_bound, upper_bound, tree, pair)
+
+template<typename K, typename V, typename C, typename... Policies>
+std::ostream & _assert_tree_size_and_height(
+    std::ostream & o,
+    size_t expected_size,
+    size_t max_height,
+    BinarySearchTree<K, V, C, Policies...> const & tree
+) {
+    if(tree.size() != expected_size) {
+        o << "Expected the tree to hold " << expected_size << " nodes."
+          << " Instead it holds " << tree.size() << "." << std::endl;
+        maybe_print_tree(o, tree);
+        return o;
+    }
+
+    size_t height = tree.height();
+    if(height > max_height) {
+        o << "Expected the tree to be at most " << max_height << " nodes tall."
+          << " Instead it is " << height << " nodes tall." << std::endl;
+        maybe_print_tree(o, tree);
+        return o;
+    }
+
+    return o;
+}
+
+#define ASSERT_TREE_SIZE_AND_HEIGHT(expected_size, max_height, tree) \
+    MK_ASSERT(_assert_tree_size_and_height, expected_size, max_height, tree)
@@ -7,6 +7,8 @@
 	with a single uint64_t.
 */
 
+#pragma once
+
 #include <cstdint>
 
 class xoshiro256 {
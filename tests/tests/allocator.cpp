@@ -0,0 +1,231 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <cstdlib>
+#include <memory_resource>
+
+// Counts the allocations made through it; copies share the counters
+// and compare equal only if they do. Memory comes from malloc so that
+// Memhook sees only what bypasses the allocator.
+struct arena_stats {
+    size_t allocs = 0;
+    size_t frees = 0;
+};
+
+template<typename T, bool Propagate>
+struct tracking_allocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::bool_constant<Propagate>;
+    using propagate_on_container_move_assignment = std::bool_constant<Propagate>;
+    using propagate_on_container_swap = std::bool_constant<Propagate>;
+
+    template<typename U>
+    struct rebind { using other = tracking_allocator<U, Propagate>; };
+
+    arena_stats * stats;
+
+    explicit tracking_allocator(arena_stats * s) : stats(s) { }
+    template<typename U>
+    tracking_allocator(tracking_allocator<U, Propagate> const & other) : stats(other.stats) { }
+
+    T * allocate(size_t n) {
+        stats->allocs++;
+        return static_cast<T *>(std::malloc(n * sizeof(T)));
+    }
+    void deallocate(T * p, size_t n) {
+        stats->frees++;
+        std::free(p);
+    }
+
+    friend bool operator==(tracking_allocator const & a, tracking_allocator const & b) { return a.stats == b.stats; }
+    friend bool operator!=(tracking_allocator const & a, tracking_allocator const & b) { return a.stats != b.stats; }
+};
+
+template<bool Propagate, typename Storage = storage::heap>
+using tracked_tree = BinarySearchTree<int, int, std::less<int>, balance::red_black, Storage,
+                                      tracking_allocator<std::pair<int, int>, Propagate>>;
+
+template<typename Tree>
+void fill(Tree & tree, std::vector<std::pair<int, int>> const & pairs) {
+    for(auto const & pair : pairs)
+        tree.insert(pair);
+}
+
+template<typename Tree>
+bool holds(Tree const & tree, std::vector<std::pair<int, int>> const & pairs) {
+    if(tree.size() != pairs.size())
+        return false;
+    for(auto const & [key, value] : pairs) {
+        if(!tree.contains(key) || tree.find(key) != value)
+            return false;
+    }
+    return true;
+}
+
+TEST(allocator_allocates_every_node) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1000);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        arena_stats stats;
+        Memhook mh;
+        {
+            tracked_tree<false> bst { tracking_allocator<std::pair<int, int>, false>(&stats) };
+            fill(bst, pairs);
+            ASSERT_EQ(sz, stats.allocs);
+            ASSERT_TRUE(holds(bst, pairs));
+            ASSERT_TRUE(bst.get_allocator().stats == &stats);
+        }
+        ASSERT_EQ(sz, stats.frees);
+        // Nothing went through the global heap
+        ASSERT_EQ(0ULL, mh.n_allocs());
+    }
+}
+
+TEST(allocator_propagation) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 500);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+        auto other = generate_kv_pairs<int, int>(t, t.range<size_t>(1, 500), true);
+
+        arena_stats a, b;
+
+        // Copy and move construction carry the allocator along
+        {
+            tracked_tree<false> src { tracking_allocator<std::pair<int, int>, false>(&a) };
+            fill(src, pairs);
+            tracked_tree<false> cpy { src };
+            ASSERT_TRUE(cpy.get_allocator().stats == &a);
+            ASSERT_EQ(2 * sz, a.allocs);
+
+            tracked_tree<false> moved { std::move(cpy) };
+            ASSERT_TRUE(moved.get_allocator().stats == &a);
+            ASSERT_EQ(2 * sz, a.allocs);
+            ASSERT_TRUE(cpy.empty());
+            ASSERT_TRUE(holds(moved, pairs));
+
+            // Moving into a tree with a different allocator moves element by element
+            tracked_tree<false> elsewhere { std::move(moved), tracking_allocator<std::pair<int, int>, false>(&b) };
+            ASSERT_TRUE(elsewhere.get_allocator().stats == &b);
+            ASSERT_EQ(sz, b.allocs);
+            ASSERT_TRUE(moved.empty());
+            ASSERT_TRUE(holds(elsewhere, pairs));
+        }
+        ASSERT_EQ(a.allocs, a.frees);
+        ASSERT_EQ(b.allocs, b.frees);
+
+        // Non-propagating assignment keeps the target's allocator
+        {
+            tracked_tree<false> lhs { tracking_allocator<std::pair<int, int>, false>(&a) };
+            tracked_tree<false> rhs { tracking_allocator<std::pair<int, int>, false>(&b) };
+            fill(lhs, other);
+            fill(rhs, pairs);
+
+            lhs = rhs;
+            ASSERT_TRUE(lhs.get_allocator().stats == &a);
+            ASSERT_TRUE(holds(lhs, pairs));
+
+            size_t b_allocs = b.allocs;
+            lhs = std::move(rhs);
+            ASSERT_TRUE(lhs.get_allocator().stats == &a);
+            ASSERT_TRUE(rhs.empty());
+            ASSERT_TRUE(holds(lhs, pairs));
+            ASSERT_EQ(b_allocs, b.allocs);
+            ASSERT_EQ(b.allocs, b.frees);
+        }
+        ASSERT_EQ(a.allocs, a.frees);
+
+        // Propagating assignment adopts the source's allocator
+        {
+            tracked_tree<true> lhs { tracking_allocator<std::pair<int, int>, true>(&a) };
+            tracked_tree<true> rhs { tracking_allocator<std::pair<int, int>, true>(&b) };
+            fill(lhs, other);
+            fill(rhs, pairs);
+
+            lhs = rhs;
+            ASSERT_TRUE(lhs.get_allocator().stats == &b);
+            ASSERT_TRUE(holds(lhs, pairs));
+            ASSERT_EQ(a.allocs, a.frees);
+
+            tracked_tree<true> third { tracking_allocator<std::pair<int, int>, true>(&a) };
+            fill(third, other);
+            size_t b_allocs = b.allocs;
+            third = std::move(rhs);
+            ASSERT_TRUE(third.get_allocator().stats == &b);
+            ASSERT_EQ(b_allocs, b.allocs);
+            ASSERT_TRUE(holds(third, pairs));
+        }
+        ASSERT_EQ(a.allocs, a.frees);
+        ASSERT_EQ(b.allocs, b.frees);
+    }
+}
+
+TEST(allocator_pool_slabs) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 5000);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        arena_stats stats;
+        Memhook mh;
+        {
+            tracked_tree<false, storage::pool> bst { tracking_allocator<std::pair<int, int>, false>(&stats) };
+            fill(bst, pairs);
+            ASSERT_TRUE(holds(bst, pairs));
+            // Slabs, not nodes, come from the allocator
+            ASSERT_LT(stats.allocs, 10 + sz / 1000);
+        }
+        ASSERT_EQ(stats.allocs, stats.frees);
+        ASSERT_EQ(0ULL, mh.n_allocs());
+    }
+}
+
+TEST(pmr_monotonic_buffer) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1000);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        // Every node comes out of the buffer; the resource never falls
+        // back to the global heap
+        static std::byte buffer[1 << 18];
+        std::pmr::monotonic_buffer_resource arena { buffer, sizeof(buffer), std::pmr::null_memory_resource() };
+        pmr::BinarySearchTree<int, int, std::less<int>, balance::avl> bst { &arena };
+        {
+            Memhook mh;
+            fill(bst, pairs);
+            ASSERT_EQ(0ULL, mh.n_allocs());
+        }
+        ASSERT_TRUE(holds(bst, pairs));
+        ASSERT_TRUE(bst.get_allocator().resource() == &arena);
+
+        // Copies follow the standard rule and use the default resource
+        pmr::BinarySearchTree<int, int, std::less<int>, balance::avl> cpy { bst };
+        ASSERT_TRUE(cpy.get_allocator().resource() == std::pmr::get_default_resource());
+        ASSERT_TRUE(holds(cpy, pairs));
+    }
+}
+
+TEST(pmr_pool_resource) {
+    Typegen t;
+    std::pmr::unsynchronized_pool_resource pool;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1000);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        pmr::BinarySearchTree<int, int, std::less<int>, balance::treap, storage::pool> a { &pool }, b { &pool };
+        fill(a, pairs);
+        b = std::move(a);
+        ASSERT_TRUE(a.empty());
+        ASSERT_TRUE(holds(b, pairs));
+        for(size_t j = 0; j < sz; j += 2)
+            b.erase(pairs[j].first);
+        ASSERT_EQ(sz / 2, b.size());
+    }
+}
@@ -0,0 +1,186 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <vector>
+
+template<typename Balance>
+using RankedTree = BinarySearchTree<int, int, std::less<int>, Balance, storage::heap,
+                                    std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+// A batch ends up the same as its ops applied one by one in their
+// original order: repeated keys, erases of absent keys and ops undoing
+// each other included. Parent links, counts and the balance survive.
+template<typename Balance>
+void check_apply_batch(Typegen & t, size_t max_height_factor_x100, int * utest_result) {
+    using Tree = RankedTree<Balance>;
+    using op = typename Tree::op;
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        int key_range = static_cast<int>(2 * sz + 1);
+
+        Memhook mh;
+        {
+            Tree tree;
+            std::map<int, int> expected;
+            for(size_t j = 0; j < sz; j++) {
+                int key = t.range(0, key_range);
+                tree.insert({ key, key });
+                expected[key] = key;
+            }
+
+            for(size_t round = 0; round < 4; round++) {
+                std::vector<op> batch(t.range<size_t>(0, 2 * sz + 1));
+                for(size_t j = 0; j < batch.size(); j++) {
+                    int key = t.range(0, key_range);
+                    if(t.get<bool>()) {
+                        batch[j] = { op::insert, { key, static_cast<int>(j) } };
+                        expected[key] = static_cast<int>(j);
+                    } else {
+                        batch[j] = { op::erase, { key, 0 } };
+                        expected.erase(key);
+                    }
+                }
+                tree.apply_batch(batch);
+
+                size_t n = expected.size();
+                size_t bound = max_height_factor_x100 > 0
+                    ? static_cast<size_t>(max_height_factor_x100 * std::log2(n + 2) / 100) + 1
+                    : n;
+                ASSERT_TREE_SIZE_AND_HEIGHT(n, bound, tree);
+                ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+                    return a.first == b.first && a.second == b.second;
+                }));
+                ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend(), [](auto const & a, auto const & b) {
+                    return a.first == b.first;
+                }));
+                size_t rank = 0;
+                for(auto const & [key, value] : expected)
+                    ASSERT_EQ(rank++, tree.rank(key));
+            }
+
+            // The tree carries on as usual afterwards
+            for(auto const & [key, value] : std::map<int, int>(expected))
+                if(t.get<bool>()) {
+                    tree.erase(key);
+                    expected.erase(key);
+                }
+            ASSERT_EQ(expected.size(), tree.size());
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(apply_batch_matches_sequential_ops) {
+    Typegen t;
+
+    check_apply_batch<balance::none>(t, 0, utest_result);
+    check_apply_batch<balance::red_black>(t, 200, utest_result);
+    check_apply_batch<balance::avl>(t, 144, utest_result);
+    check_apply_batch<balance::treap>(t, 0, utest_result);
+    check_apply_batch<balance::splay>(t, 0, utest_result);
+    check_apply_batch<balance::scapegoat>(t, 0, utest_result);
+}
+
+// A batch much smaller than the tree is fetched ahead a chunk at a time
+// and applied from the root; it still ends up the same as its ops one by
+// one, across many chunks
+template<typename Balance>
+void check_sparse_apply_batch(Typegen & t, int * utest_result) {
+    using Tree = RankedTree<Balance>;
+    using op = typename Tree::op;
+
+    for(size_t i = 0; i < TEST_ITER / 20; i++) {
+        size_t sz = t.range<size_t>(8192, 16384);
+        int key_range = static_cast<int>(2 * sz);
+
+        Tree tree;
+        std::map<int, int> expected;
+        for(size_t j = 0; j < sz; j++) {
+            int key = t.range(0, key_range);
+            tree.insert({ key, key });
+            expected[key] = key;
+        }
+
+        std::vector<op> batch(t.range<size_t>(600, sz / 8));
+        for(size_t j = 0; j < batch.size(); j++) {
+            int key = t.range(0, key_range);
+            if(t.get<bool>()) {
+                batch[j] = { op::insert, { key, static_cast<int>(j) } };
+                expected[key] = static_cast<int>(j);
+            } else {
+                batch[j] = { op::erase, { key, 0 } };
+                expected.erase(key);
+            }
+        }
+        tree.apply_batch(batch);
+
+        ASSERT_EQ(expected.size(), tree.size());
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+            return a.first == b.first && a.second == b.second;
+        }));
+        size_t rank = 0;
+        for(auto const & [key, value] : expected)
+            ASSERT_EQ(rank++, tree.rank(key));
+    }
+}
+
+TEST(sparse_apply_batch_matches_sequential_ops) {
+    Typegen t;
+
+    check_sparse_apply_batch<balance::none>(t, utest_result);
+    check_sparse_apply_batch<balance::red_black>(t, utest_result);
+    check_sparse_apply_batch<balance::avl>(t, utest_result);
+    check_sparse_apply_batch<balance::treap>(t, utest_result);
+    check_sparse_apply_batch<balance::splay>(t, utest_result);
+    check_sparse_apply_batch<balance::scapegoat>(t, utest_result);
+}
+
+// Sorted neighbours share the top of their search paths: a batch
+// touching every key of a red-black tree costs a constant number of
+// comparisons per key on top of the sort, where inserting the keys one
+// by one costs a full descent each
+TEST(apply_batch_shares_paths) {
+    Typegen t;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::red_black>;
+    using op = Tree::op;
+
+    for(size_t i = 0; i < TEST_ITER / 10; i++) {
+        size_t sz = t.range<size_t>(1024, 8192);
+
+        Tree tree;
+        for(size_t j = 0; j < sz; j++)
+            tree.insert({ static_cast<int>(2 * j), 0 });
+        Tree looped = tree;
+
+        // Every other op overwrites a key, the rest add one between two
+        std::vector<op> batch(sz);
+        for(size_t j = 0; j < sz; j++)
+            batch[j] = { op::insert, { static_cast<int>(2 * j + (j % 2)), 1 } };
+
+        comparisons = 0;
+        for(auto const & o : batch)
+            looped.insert(o.element);
+        size_t one_by_one = comparisons;
+
+        comparisons = 0;
+        std::vector<op> sorted = batch;
+        std::stable_sort(sorted.begin(), sorted.end(), [](op const & a, op const & b) {
+            return comparison_tracking_comparitor{}(a.element.first, b.element.first);
+        });
+        size_t sorting = comparisons;
+
+        comparisons = 0;
+        tree.apply_batch(batch);
+        size_t searches = comparisons - sorting;
+
+        ASSERT_EQ(sz + sz / 2, tree.size());
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), looped.begin(), looped.end()));
+        ASSERT_LE(searches, 10 * sz);
+        ASSERT_LT(2 * searches, one_by_one);
+    }
+}
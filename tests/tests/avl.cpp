@@ -0,0 +1,127 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+
+using AVLTree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::avl>;
+
+static_assert(
+    BinarySearchTree<int, int, std::less<int>, balance::avl>::node_size <= 64,
+    "AVL node for <int, int> must fit in a cache line"
+);
+
+// An AVL tree with n nodes is less than 1.4405 * log2(n + 2) nodes tall
+// and insert makes at most two comparisons per node on its path
+size_t avl_insert_bound(size_t n) {
+    return 2 * static_cast<size_t>(std::ceil(1.4405 * std::log2(n + 2)));
+}
+
+TEST(avl_sorted_insert) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 2048);
+        bool descending = t.get<bool>();
+
+        Memhook mh;
+        {
+            AVLTree tree;
+            std::vector<std::pair<int, int>> pairs;
+
+            for(size_t j = 0; j < sz; j++) {
+                int key = descending ? static_cast<int>(sz - j) : static_cast<int>(j);
+                std::pair<int, int> p { key, t.get<int>() };
+
+                {
+                    Memhook mh;
+                    INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                        0, avl_insert_bound(tree.size() + 1),
+                        tree, p
+                    );
+                    ASSERT_EQ(1ULL, mh.n_allocs());
+                }
+
+                pairs.push_back(p);
+            }
+
+            ASSERT_EQ(sz, tree.size());
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(avl_erase) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1024);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        if(t.get<bool>())
+            std::sort(pairs.begin(), pairs.end());
+
+        Memhook mh;
+        {
+            AVLTree tree;
+
+            for(auto const & pair : pairs)
+                tree.insert(pair);
+
+            while(!pairs.empty()) {
+                size_t idx = t.range(pairs.size());
+
+                {
+                    Memhook mh;
+                    tree.erase(pairs[idx].first);
+                    ASSERT_EQ(1ULL, mh.n_frees());
+                    ASSERT_EQ(0ULL, mh.n_allocs());
+                }
+
+                ASSERT_FALSE(tree.contains(pairs[idx].first));
+                pairs.erase(pairs.begin() + idx);
+                ASSERT_EQ(pairs.size(), tree.size());
+
+                if(!pairs.empty() && t.get<bool>()) {
+                    auto const & pair = pairs[t.range(pairs.size())];
+                    INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                        1, avl_insert_bound(tree.size()),
+                        tree, pair
+                    );
+                }
+            }
+
+            ASSERT_TRUE(tree.empty());
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(avl_copy) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+        std::sort(pairs.begin(), pairs.end());
+
+        AVLTree src;
+        for(auto const & pair : pairs)
+            src.insert(pair);
+
+        AVLTree cpy;
+        cpy = src;
+        ASSERT_EQ(sz, cpy.size());
+        ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, cpy);
+
+        // The copy keeps its heights and so stays balanced under insertion
+        if(sz) {
+            cpy.erase(pairs.back().first);
+            INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                1, avl_insert_bound(sz), cpy, pairs.back()
+            );
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include "BTree.h"
+#include <algorithm>
+#include <map>
+#include <string>
+
+static_assert(BTree<int, int, std::less<int>, 64>::MAX_KEYS == 7, "64-byte <int, int> nodes hold 7 keys");
+static_assert(BTree<int, int, std::less<int>, 128>::MAX_KEYS == 15, "128-byte <int, int> nodes hold 15 keys");
+
+// Mirror a sequence of random operations into a std::map and check
+// the tree agrees with it after each one
+template<typename Tree>
+void check_against_map(Typegen & t, size_t sz, int key_range, int * utest_result) {
+    Tree tree;
+    std::map<int, int> ref;
+
+    for(size_t j = 0; j < sz; j++) {
+        int key = t.range(0, key_range);
+        int value = t.get<int>();
+
+        if(t.range(4) != 0) {
+            if(t.get<bool>())
+                tree.insert({ key, value });
+            else {
+                std::pair<int, int> p { key, value };
+                tree.insert(p);
+            }
+            ref[key] = value;
+        } else {
+            tree.erase(key);
+            ref.erase(key);
+        }
+
+        ASSERT_EQ(ref.size(), tree.size());
+        ASSERT_EQ(ref.count(key) == 1, tree.contains(key));
+        if(!ref.empty()) {
+            ASSERT_EQ(ref.begin()->first, tree.min().first);
+            ASSERT_EQ(ref.rbegin()->first, tree.max().first);
+        }
+    }
+
+    for(auto const & [key, value] : ref)
+        ASSERT_EQ(value, tree.find(key));
+
+    Tree cpy { tree };
+    while(!ref.empty()) {
+        auto it = ref.begin();
+        std::advance(it, t.range(ref.size()));
+        cpy.erase(it->first);
+        ASSERT_FALSE(cpy.contains(it->first));
+        ASSERT_TRUE(tree.contains(it->first));
+        ref.erase(it);
+        ASSERT_EQ(ref.size(), cpy.size());
+    }
+    ASSERT_TRUE(cpy.empty());
+}
+
+TEST(btree_matches_map) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 4096);
+        int key_range = t.range(1, 2048);
+
+        check_against_map<BTree<int, int, std::less<int>, 64>>(t, sz, key_range, utest_result);
+        check_against_map<BTree<int, int, std::less<int>, 128>>(t, sz, key_range, utest_result);
+        check_against_map<BTree<int, int, std::less<int>, 256>>(t, sz, key_range, utest_result);
+    }
+}
+
+TEST(btree_sorted_insert) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 8192);
+
+        BTree<int, int> tree;
+        for(size_t j = 0; j < sz; j++)
+            tree.insert({ static_cast<int>(j), static_cast<int>(2 * j) });
+
+        ASSERT_EQ(sz, tree.size());
+        for(size_t j = 0; j < sz; j++)
+            ASSERT_EQ(static_cast<int>(2 * j), tree.find(static_cast<int>(j)));
+
+        // Nodes are at least half full
+        size_t bound = 1;
+        for(size_t cap = BTree<int, int>::MIN_KEYS + 1, n = 1; n <= sz; n *= cap)
+            bound++;
+        ASSERT_LE(tree.height(), bound);
+
+        for(size_t j = sz; j-- > 0; ) {
+            tree.erase(static_cast<int>(j));
+            ASSERT_FALSE(tree.contains(static_cast<int>(j)));
+        }
+        ASSERT_TRUE(tree.empty());
+        ASSERT_EQ(0ULL, tree.height());
+    }
+}
+
+TEST(btree_large_pairs) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 512);
+
+        // Pairs too large for the line fall back to three keys per node
+        BTree<std::string, std::string, std::less<std::string>, 64> tree;
+        std::map<std::string, std::string> ref;
+
+        for(size_t j = 0; j < sz; j++) {
+            std::string key = t.get<std::string>(t.range<size_t>(1, 4));
+            std::string value = t.get<std::string>(24);
+            tree.insert({ key, value });
+            ref[key] = value;
+        }
+
+        ASSERT_EQ(ref.size(), tree.size());
+        for(auto const & [key, value] : ref)
+            ASSERT_TRUE(value == tree.find(key));
+
+        for(auto const & [key, value] : ref)
+            tree.erase(key);
+        ASSERT_TRUE(tree.empty());
+    }
+}
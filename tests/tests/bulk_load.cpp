@@ -0,0 +1,148 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <memory>
+
+// Nodes on the longest path of a perfectly balanced tree of n nodes
+size_t balanced_height(size_t n) {
+    size_t h = 0;
+    while((n >> h) > 0)
+        h++;
+    return h;
+}
+
+// The bulk-loaded shape must be a valid tree for the policy: later
+// inserts and erases run its fixups on top of the colours, heights and
+// priorities the build filled in, and must keep the policy's bound
+template<typename Balance>
+void check_bulk_load(Typegen & t, size_t max_height_factor_x100, int * utest_result) {
+    using Tree = BinarySearchTree<int, int, std::less<int>, Balance, storage::heap,
+                                  std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+    for(size_t i = 0; i < TEST_ITER / 2; i++) {
+        size_t sz = t.range<size_t>(0, 1024);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+        std::sort(pairs.begin(), pairs.end());
+
+        Memhook mh;
+        {
+            Tree tree;
+            {
+                Memhook mh;
+                tree.assign_sorted(pairs.begin(), pairs.end());
+                ASSERT_EQ(sz, mh.n_allocs());
+            }
+            ASSERT_TREE_SIZE_AND_HEIGHT(sz, balanced_height(sz), tree);
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+            for(size_t j = 0; j < sz; j++)
+                ASSERT_EQ(j, tree.rank(pairs[j].first));
+
+            std::map<int, int> expected(pairs.begin(), pairs.end());
+            std::vector<int> keys;
+            for(auto const & [key, value] : pairs)
+                keys.push_back(key);
+
+            for(size_t j = 0; j < sz; j++) {
+                if(t.get<bool>() && !keys.empty()) {
+                    size_t victim = t.range(keys.size());
+                    tree.erase(keys[victim]);
+                    expected.erase(keys[victim]);
+                    keys[victim] = keys.back();
+                    keys.pop_back();
+                } else {
+                    int key = t.get<int>();
+                    if(!expected.count(key))
+                        keys.push_back(key);
+                    tree.insert({ key, static_cast<int>(j) });
+                    expected[key] = static_cast<int>(j);
+                }
+            }
+
+            size_t n = expected.size();
+            size_t bound = static_cast<size_t>(max_height_factor_x100 * std::log2(n + 2) / 100) + 1;
+            if(std::is_same_v<Balance, balance::red_black> || std::is_same_v<Balance, balance::avl>)
+                ASSERT_TREE_SIZE_AND_HEIGHT(n, bound, tree);
+            ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+                return a.first == b.first && a.second == b.second;
+            }));
+            if(n > 0)
+                ASSERT_EQ(n - 1, tree.rank(tree.max().first));
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(assign_sorted_builds_balanced_trees) {
+    Typegen t;
+
+    check_bulk_load<balance::none>(t, 0, utest_result);
+    check_bulk_load<balance::red_black>(t, 200, utest_result);
+    check_bulk_load<balance::avl>(t, 144, utest_result);
+    check_bulk_load<balance::treap>(t, 0, utest_result);
+    check_bulk_load<balance::splay>(t, 0, utest_result);
+    check_bulk_load<balance::scapegoat>(t, 0, utest_result);
+}
+
+// assign_sorted trusts its input and makes no comparisons; the range
+// constructor checks the order with one comparison per adjacent pair
+TEST(range_constructor_checks_order) {
+    Typegen t;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor>;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 2048);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+        std::sort(pairs.begin(), pairs.end());
+
+        Memhook mh;
+        {
+            Tree sorted;
+            comparisons = 0;
+            sorted.assign_sorted(pairs.begin(), pairs.end());
+            ASSERT_EQ(0ULL, comparisons);
+
+            comparisons = 0;
+            Tree checked(pairs.begin(), pairs.end());
+            ASSERT_EQ(sz - 1, comparisons);
+            ASSERT_TREE_SIZE_AND_HEIGHT(sz, balanced_height(sz), checked);
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, checked);
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+// Unsorted input with repeated keys ends up as if inserted one by one
+TEST(range_constructor_sorts_unsorted_input) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(0, 2048);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, false);
+        for(auto & [key, value] : pairs)
+            key %= static_cast<int>(sz / 2 + 1);
+
+        Memhook mh;
+        {
+            BinarySearchTree<int, int> inserted;
+            for(auto const & pair : pairs)
+                inserted.insert(pair);
+
+            BinarySearchTree<int, int, std::less<int>, balance::red_black> loaded(pairs.begin(), pairs.end());
+            ASSERT_TREE_SIZE_AND_HEIGHT(inserted.size(), balanced_height(inserted.size()), loaded);
+            ASSERT_TRUE(std::equal(loaded.begin(), loaded.end(), inserted.begin(), inserted.end()));
+
+            // Other containers' elements convert, and a moved range moves
+            std::map<int, int> source(pairs.begin(), pairs.end());
+            BinarySearchTree<int, int> from_map(source.begin(), source.end());
+            ASSERT_EQ(source.size(), from_map.size());
+
+            BinarySearchTree<int, int> moved(std::make_move_iterator(pairs.begin()), std::make_move_iterator(pairs.end()));
+            ASSERT_EQ(inserted.size(), moved.size());
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
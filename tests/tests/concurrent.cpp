@@ -0,0 +1,186 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include "ConcurrentSearchTree.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <thread>
+#include <vector>
+
+using Concurrent = ConcurrentSearchTree<int, int>;
+
+// A reader sees every update the writer has published, and the tree
+// stays AVL-balanced. Once no reader is pinned, reclaim frees every
+// replaced node.
+TEST(concurrent_matches_map) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t ops = t.range<size_t>(0, 2048);
+        int key_range = static_cast<int>(ops / 2 + 1);
+
+        Memhook mh;
+        {
+            Concurrent tree;
+            auto reader = tree.register_reader();
+            std::map<int, int> expected;
+
+            for(size_t j = 0; j < ops; j++) {
+                int key = t.range(0, key_range);
+                if(t.range(0, 3) > 0) {
+                    tree.insert({ key, static_cast<int>(j) });
+                    expected[key] = static_cast<int>(j);
+                } else {
+                    tree.erase(key);
+                    expected.erase(key);
+                }
+
+                ASSERT_EQ(expected.size(), tree.size());
+                ASSERT_LE(tree.height(), static_cast<size_t>(1.44 * std::log2(expected.size() + 2)));
+                ASSERT_LT(tree.retired(), Concurrent::reclaim_threshold);
+
+                auto found = reader.find(key);
+                auto it = expected.find(key);
+                ASSERT_EQ(it != expected.end(), found.has_value());
+                if(found)
+                    ASSERT_EQ(it->second, *found);
+                ASSERT_EQ(it != expected.end(), reader.contains(key));
+                ASSERT_EQ(it != expected.end(), tree.contains(key));
+            }
+
+            std::vector<std::pair<int, int>> elements;
+            reader.for_each([&](auto const & e) { elements.push_back(e); });
+            ASSERT_TRUE(std::equal(elements.begin(), elements.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+                return a.first == b.first && a.second == b.second;
+            }));
+
+            tree.reclaim();
+            ASSERT_EQ(0ULL, tree.retired());
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+// A reader in the middle of a traversal keeps its version: the nodes the
+// writer replaces meanwhile are not freed until the reader lets go
+TEST(concurrent_pinned_reader_delays_reclaim) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        int sz = t.range(1, 1024);
+
+        Concurrent tree;
+        for(int key = 0; key < sz; key++)
+            tree.insert({ key, key });
+        auto reader = tree.register_reader();
+        auto other = tree.register_reader();
+
+        int seen = 0;
+        reader.for_each([&](auto const & e) {
+            ASSERT_EQ(seen, e.first);
+            ASSERT_EQ(seen, e.second);
+            seen++;
+
+            // Each visit erases the key after it and overwrites the one
+            // before it (which the next visit erases), then tries to
+            // free what that replaced
+            tree.erase(e.first + 1);
+            tree.insert({ e.first - 1, -1 });
+            tree.reclaim();
+            ASSERT_LT(0ULL, tree.retired());
+
+            // A lookup pinned after the update sees it
+            ASSERT_FALSE(other.contains(e.first + 1));
+        });
+        ASSERT_EQ(sz, seen);
+
+        tree.reclaim();
+        ASSERT_EQ(0ULL, tree.retired());
+        ASSERT_EQ(static_cast<size_t>(sz), tree.size());
+    }
+}
+
+TEST(concurrent_from_freeze) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(0, 2048);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        BinarySearchTree<int, int> bst;
+        for(auto const & pair : pairs)
+            bst.insert(pair);
+
+        auto tree = bst.freeze<Concurrent>();
+        auto reader = tree.register_reader();
+        ASSERT_EQ(sz, tree.size());
+        ASSERT_LE(tree.height(), static_cast<size_t>(std::log2(sz + 1)) + 1);
+        for(auto const & [key, value] : pairs)
+            ASSERT_EQ(value, *reader.find(key));
+    }
+}
+
+// Readers traverse while the writer rewrites every value in key order,
+// round after round, and adds and removes one extra key. Each traversal
+// sees a single version: a prefix of keys already at the next round.
+TEST(concurrent_readers_see_consistent_versions) {
+    constexpr int keys = 2048;
+    constexpr int readers = 3;
+
+    Concurrent tree;
+    for(int key = 0; key < keys; key++)
+        tree.insert({ key, 0 });
+
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::atomic<int> traversals{0};
+
+    std::vector<std::thread> threads;
+    for(int r = 0; r < readers; r++) {
+        threads.emplace_back([&] {
+            auto reader = tree.register_reader();
+            while(!done.load()) {
+                int count = 0, previous = -1, first = -1;
+                reader.for_each([&](auto const & e) {
+                    if(e.first == keys)
+                        return;
+                    if(first < 0)
+                        first = e.second;
+                    if(previous >= 0 && (e.second > previous || e.second < first - 1))
+                        bad++;
+                    previous = e.second;
+                    count++;
+                });
+                if(count != keys)
+                    bad++;
+
+                auto value = reader.find(keys / 2);
+                if(!value || *value < 0)
+                    bad++;
+                traversals++;
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    for(int round = 1; round <= 32; round++) {
+        for(int key = 0; key < keys; key++) {
+            tree.insert({ key, round });
+            if(key % 64 == 0)
+                tree.insert({ keys, 0 });
+            else if(key % 64 == 32)
+                tree.erase(keys);
+        }
+        std::this_thread::yield();
+    }
+    while(traversals.load() < readers)
+        std::this_thread::yield();
+    done = true;
+    for(auto & thread : threads)
+        thread.join();
+
+    ASSERT_EQ(0, bad.load());
+    tree.reclaim();
+    ASSERT_EQ(0ULL, tree.retired());
+}
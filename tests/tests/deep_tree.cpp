@@ -0,0 +1,108 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <pthread.h>
+#include <functional>
+#include <ostream>
+
+// Runs body on a thread with exactly stack_bytes of stack, so a walk
+// that recursed once per level would overflow instead of passing on a
+// host with a generous default stack
+void run_with_stack(size_t stack_bytes, std::function<void()> body, int * utest_result) {
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    ASSERT_EQ(0, pthread_attr_init(&attr));
+    ASSERT_EQ(0, pthread_attr_setstacksize(&attr, stack_bytes));
+    ASSERT_EQ(0, pthread_create(&thread, &attr, [](void * arg) -> void * {
+        (*static_cast<std::function<void()> *>(arg))();
+        return nullptr;
+    }, &body));
+    ASSERT_EQ(0, pthread_join(thread, nullptr));
+    pthread_attr_destroy(&attr);
+}
+
+// Increasing keys make every splay insert O(1): the new key becomes the
+// root with the old root as its left child, leaving a chain of n nodes
+void check_chain(size_t n, int * utest_result) {
+    using SplayTree = BinarySearchTree<int, int, std::less<int>, balance::splay, storage::pool>;
+
+    SplayTree chain;
+    for(size_t i = 0; i < n; i++)
+        chain.insert({ (int) i, (int) i });
+    ASSERT_EQ(n, chain.size());
+
+    {
+        SplayTree copy(chain);
+        ASSERT_EQ(n, copy.size());
+
+        // Const lookups leave the shape alone, so each of these walks
+        // the whole chain
+        const SplayTree & view = copy;
+        ASSERT_TRUE(view.contains(0));
+        ASSERT_FALSE(view.contains(-1));
+        ASSERT_EQ(0, view.find(0));
+        ASSERT_EQ(0, view.min().first);
+        ASSERT_EQ((int) n - 1, view.max().first);
+
+        std::ostream null(nullptr);
+        vizTree(view, null);
+    }
+
+    chain.clear();
+    ASSERT_TRUE(chain.empty());
+}
+
+TEST(deep_chain_under_default_stack) {
+    bool completed = false;
+
+    run_with_stack(8 << 20, [&]() {
+        check_chain(10'000'000, utest_result);
+        completed = true;
+    }, utest_result);
+
+    ASSERT_TRUE(completed);
+}
+
+// The unbalanced tree built from sorted input is the degenerate case
+// the iterative insert, erase, copy, print and clear exist for
+void check_sorted_input(int n, int * utest_result) {
+    using Tree = BinarySearchTree<int, int>;
+
+    Memhook mh;
+    {
+        Tree tree;
+        for(int i = 0; i < n; i++)
+            tree.insert({ i, -i });
+        ASSERT_EQ((size_t) n, tree.size());
+
+        {
+            Memhook copy_mh;
+            Tree copy(tree);
+            ASSERT_EQ((size_t) n, copy_mh.n_allocs());
+            ASSERT_EQ(-(n - 1), copy.find(n - 1));
+
+            std::ostream null(nullptr);
+            printTree(copy, null);
+            vizTree(copy, null);
+        }
+
+        for(int i = n - 1; i >= 0; i -= 2)
+            tree.erase(i);
+        ASSERT_EQ((size_t) n / 2, tree.size());
+        ASSERT_FALSE(tree.contains(n - 1));
+        ASSERT_TRUE(tree.contains(n - 2));
+    }
+    ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+}
+
+// A 64KB stack holds a few hundred frames of a recursive walk
+TEST(sorted_input_under_small_stack) {
+    bool completed = false;
+
+    run_with_stack(64 << 10, [&]() {
+        check_sorted_input(4000, utest_result);
+        completed = true;
+    }, utest_result);
+
+    ASSERT_TRUE(completed);
+}
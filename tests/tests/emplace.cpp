@@ -0,0 +1,116 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include "box.h"
+#include <map>
+#include <tuple>
+#include <vector>
+
+template<typename Balance>
+using RankedTree = BinarySearchTree<int, Box<int>, std::less<int>, Balance, storage::heap,
+                                    std::allocator<std::pair<int, Box<int>>>, augment::order_statistics>;
+
+// try_emplace builds the value only in a new node: an absent key costs
+// the node and the Box, a present one allocates nothing and leaves the old
+// value in place. emplace builds the whole pair in a node up front and
+// frees it again on a duplicate. Both agree with std::map::try_emplace.
+template<typename Tree>
+void check_emplace(Typegen & t, int * utest_result) {
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(1, 256);
+        int key_range = static_cast<int>(2 * sz);
+
+        Tree tree;
+        std::map<int, int> expected;
+        for(size_t j = 0; j < sz; j++) {
+            int key = t.range(0, key_range);
+            int value = t.get<int>();
+            bool absent = expected.find(key) == expected.end();
+
+            Memhook mh;
+            auto [it, inserted] = t.get<bool>()
+                ? tree.try_emplace(key, value)
+                : tree.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value));
+            size_t allocs = mh.n_allocs();
+            ASSERT_EQ(absent, inserted);
+            ASSERT_EQ(key, it->first);
+            // Pooled nodes come from a slab allocated earlier
+            if(inserted && std::is_same_v<typename Tree::storage_policy, storage::heap>)
+                ASSERT_EQ(2ULL, allocs);
+
+            auto [expected_it, expected_inserted] = expected.try_emplace(key, value);
+            ASSERT_EQ(expected_inserted, inserted);
+            ASSERT_EQ(expected_it->second, *it->second);
+        }
+
+        for(int key = 0; key < key_range; key++) {
+            if(expected.find(key) == expected.end())
+                continue;
+            Memhook mh;
+            auto [it, inserted] = tree.try_emplace(key, -1);
+            ASSERT_EQ(0ULL, mh.n_allocs());
+            ASSERT_FALSE(inserted);
+            ASSERT_EQ(expected[key], *it->second);
+        }
+
+        ASSERT_EQ(expected.size(), tree.size());
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+            return a.first == b.first && *a.second == b.second;
+        }));
+        ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend(), [](auto const & a, auto const & b) {
+            return a.first == b.first;
+        }));
+        if constexpr (std::is_same_v<typename Tree::augment_policy, augment::order_statistics>) {
+            size_t rank = 0;
+            for(auto const & [key, value] : expected)
+                ASSERT_EQ(rank++, tree.rank(key));
+        }
+
+        // The tree carries on as usual afterwards
+        for(auto const & [key, value] : std::map<int, int>(expected))
+            if(t.get<bool>()) {
+                tree.erase(key);
+                expected.erase(key);
+            }
+        ASSERT_EQ(expected.size(), tree.size());
+    }
+}
+
+TEST(emplace_and_try_emplace) {
+    Typegen t;
+
+    check_emplace<BinarySearchTree<int, Box<int>>>(t, utest_result);
+    check_emplace<RankedTree<balance::none>>(t, utest_result);
+    check_emplace<RankedTree<balance::red_black>>(t, utest_result);
+    check_emplace<RankedTree<balance::avl>>(t, utest_result);
+    check_emplace<RankedTree<balance::treap>>(t, utest_result);
+    check_emplace<RankedTree<balance::splay>>(t, utest_result);
+    check_emplace<RankedTree<balance::scapegoat>>(t, utest_result);
+    check_emplace<BinarySearchTree<int, Box<int>, std::less<int>, balance::red_black, storage::pool>>(t, utest_result);
+}
+
+// An emplaced duplicate is built and freed again; the tree keeps its
+// element either way
+TEST(emplace_duplicate_frees_node) {
+    BinarySearchTree<int, Box<int>, std::less<int>, balance::avl> tree;
+    tree.try_emplace(1, 10);
+
+    Memhook mh;
+    auto [it, inserted] = tree.emplace(1, Box<int>(20));
+    ASSERT_FALSE(inserted);
+    ASSERT_EQ(10, *it->second);
+    ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+}
+
+// A moved-from key is consumed only when the key is inserted
+TEST(try_emplace_moves_key_only_on_insert) {
+    BinarySearchTree<std::string, Box<int>> tree;
+    std::string key(64, 'k');
+    tree.try_emplace(std::move(key), 1);
+    ASSERT_TRUE(key.empty());
+
+    std::string same(64, 'k');
+    auto [it, inserted] = tree.try_emplace(std::move(same), 2);
+    ASSERT_FALSE(inserted);
+    ASSERT_EQ(64ULL, same.size());
+    ASSERT_EQ(1, *it->second);
+}
@@ -1,5 +1,6 @@
 #include "generate_tree_data.h"
 #include "executable.h"
+#include <sstream>
 
 
 TEST(erase) {
@@ -54,3 +55,43 @@ TEST(erase) {
         }
     }
 }
+
+// Like std::map::erase, erase reports how many elements it removed and
+// says nothing when the key is absent
+template <typename Balance>
+void check_erase_count(Typegen & t, int * utest_result) {
+    BinarySearchTree<int, int, std::less<int>, Balance> bst;
+    size_t sz = t.range<size_t>(1, 256);
+    auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+    for(auto const & pair : pairs)
+        bst.insert(pair);
+
+    int absent = 0;
+    while(bst.contains(absent))
+        absent++;
+
+    std::ostringstream captured;
+    std::streambuf * old = std::cout.rdbuf(captured.rdbuf());
+    size_t missing = bst.erase(absent);
+    size_t present = bst.erase(pairs.front().first);
+    size_t again = bst.erase(pairs.front().first);
+    std::cout.rdbuf(old);
+
+    ASSERT_EQ(0ULL, missing);
+    ASSERT_EQ(1ULL, present);
+    ASSERT_EQ(0ULL, again);
+    ASSERT_EQ(sz - 1, bst.size());
+    ASSERT_TRUE(captured.str().empty());
+}
+
+TEST(erase_returns_count) {
+    Typegen t;
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        check_erase_count<balance::none>(t, utest_result);
+        check_erase_count<balance::red_black>(t, utest_result);
+        check_erase_count<balance::avl>(t, utest_result);
+        check_erase_count<balance::treap>(t, utest_result);
+        check_erase_count<balance::splay>(t, utest_result);
+        check_erase_count<balance::scapegoat>(t, utest_result);
+    }
+}
@@ -0,0 +1,79 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include "box.h"
+#include <algorithm>
+
+TEST(freeze_matches_tree) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 2048);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        BinarySearchTree<int, int, std::less<int>, balance::red_black> bst;
+        for(auto const & pair : pairs)
+            bst.insert(pair);
+
+        auto frozen = bst.freeze();
+
+        // Copying leaves the live tree intact
+        ASSERT_EQ(sz, bst.size());
+        ASSERT_EQ(sz, frozen.size());
+        ASSERT_FALSE(frozen.empty());
+        ASSERT_EQ(bst.min().first, frozen.min().first);
+        ASSERT_EQ(bst.min().second, frozen.min().second);
+        ASSERT_EQ(bst.max().first, frozen.max().first);
+        ASSERT_EQ(bst.max().second, frozen.max().second);
+
+        for(auto const & [key, value] : pairs) {
+            ASSERT_TRUE(frozen.contains(key));
+            ASSERT_EQ(value, frozen.find(key));
+        }
+
+        // Keys between and around the stored ones are absent
+        std::sort(pairs.begin(), pairs.end());
+        ASSERT_FALSE(frozen.contains(pairs.front().first - 1));
+        ASSERT_FALSE(frozen.contains(pairs.back().first + 1));
+        for(size_t j = 1; j < sz; j++) {
+            if(pairs[j].first - pairs[j - 1].first > 1)
+                ASSERT_FALSE(frozen.contains(pairs[j].first - 1));
+        }
+    }
+}
+
+TEST(freeze_empty) {
+    BinarySearchTree<int, int> bst;
+    auto frozen = bst.freeze();
+
+    ASSERT_TRUE(frozen.empty());
+    ASSERT_EQ(0ULL, frozen.size());
+    ASSERT_FALSE(frozen.contains(0));
+}
+
+TEST(freeze_moves_elements) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 256);
+        auto keys = generate_kv_pairs<int, int>(t, sz, true);
+
+        BinarySearchTree<int, Box<int>> bst;
+        for(auto const & [key, value] : keys)
+            bst.insert({ key, Box<int>(value) });
+
+        size_t copies;
+        {
+            Memhook mh;
+            auto frozen = std::move(bst).freeze();
+
+            // Only the snapshot's arrays are allocated; no Box is copied
+            copies = mh.n_allocs();
+            ASSERT_TRUE(bst.empty());
+            ASSERT_EQ(sz, frozen.size());
+
+            for(auto const & [key, value] : keys)
+                ASSERT_EQ(value, *frozen.find(key));
+        }
+        ASSERT_LE(copies, 4ULL + 2 * static_cast<size_t>(std::log2(sz + 1)));
+    }
+}
@@ -0,0 +1,218 @@
+#include <cstddef>
+
+// Steps down the right spine taken looking for the largest node
+static std::size_t spine_steps = 0;
+#define BINARY_SEARCH_TREE_SPINE_STEP() (spine_steps++)
+
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+template<typename Balance>
+using RankedTree = BinarySearchTree<int, int, std::less<int>, Balance, storage::heap,
+                                    std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+// Good hints, bad hints and end() all end up the same as insert: an
+// equal key is overwritten and the returned iterator is at the key
+template<typename Balance>
+void check_insert_hint(Typegen & t, size_t max_height_factor_x100, int * utest_result) {
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        int key_range = static_cast<int>(2 * sz + 1);
+
+        RankedTree<Balance> tree;
+        std::map<int, int> expected;
+        auto hint = tree.end();
+        for(size_t j = 0; j < sz; j++) {
+            int key = t.range(0, key_range);
+            int value = static_cast<int>(j);
+
+            switch(t.range(0, 4)) {
+            case 0:
+                hint = tree.insert(hint, { key, value });
+                break;
+            case 1:
+                hint = tree.insert(tree.lower_bound(key + t.range(-2, 3)), { key, value });
+                break;
+            case 2:
+                hint = tree.insert(tree.begin(), { key, value });
+                break;
+            default:
+                hint = tree.append_max({ key, value });
+                break;
+            }
+            expected[key] = value;
+            ASSERT_EQ(key, hint->first);
+            ASSERT_EQ(value, hint->second);
+        }
+
+        size_t n = expected.size();
+        size_t bound = max_height_factor_x100 > 0
+            ? static_cast<size_t>(max_height_factor_x100 * std::log2(n + 2) / 100) + 1
+            : n;
+        ASSERT_TREE_SIZE_AND_HEIGHT(n, bound, tree);
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+            return a.first == b.first && a.second == b.second;
+        }));
+        ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend(), [](auto const & a, auto const & b) {
+            return a.first == b.first;
+        }));
+        size_t rank = 0;
+        for(auto const & [key, value] : expected)
+            ASSERT_EQ(rank++, tree.rank(key));
+
+        // The tree carries on as usual afterwards
+        for(auto const & [key, value] : std::map<int, int>(expected))
+            if(t.get<bool>()) {
+                tree.erase(key);
+                expected.erase(key);
+            }
+        ASSERT_EQ(expected.size(), tree.size());
+    }
+}
+
+TEST(insert_hint_matches_insert) {
+    Typegen t;
+
+    check_insert_hint<balance::none>(t, 0, utest_result);
+    check_insert_hint<balance::red_black>(t, 200, utest_result);
+    check_insert_hint<balance::avl>(t, 144, utest_result);
+    check_insert_hint<balance::treap>(t, 0, utest_result);
+    check_insert_hint<balance::splay>(t, 0, utest_result);
+    check_insert_hint<balance::scapegoat>(t, 0, utest_result);
+}
+
+// Increasing keys cost one comparison each through append_max or an
+// end() hint, and two through the previous insert's iterator, where a
+// plain insert compares its way down the whole tree. Without parent
+// links (scapegoat) stepping to the hint's neighbour is a search, so
+// only append_max and end() save anything.
+template<typename Balance>
+void check_sorted_comparisons(Typegen & t, int * utest_result) {
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, Balance>;
+
+    for(size_t i = 0; i < TEST_ITER / 10; i++) {
+        size_t sz = t.range<size_t>(1024, 8192);
+
+        Tree appended, end_hinted, hinted, looped;
+        comparisons = spine_steps = 0;
+        for(size_t j = 0; j < sz; j++)
+            appended.append_max({ static_cast<int>(j), 0 });
+        ASSERT_LE(comparisons, sz);
+        // Trees without parent links walk the spine for the fixup path
+        if(Tree::parent_linked)
+            ASSERT_EQ(0ULL, spine_steps);
+
+        comparisons = 0;
+        for(size_t j = 0; j < sz; j++)
+            end_hinted.insert(end_hinted.end(), { static_cast<int>(j), 0 });
+        ASSERT_LE(comparisons, sz);
+
+        comparisons = 0;
+        auto hint = hinted.end();
+        for(size_t j = 0; j < sz; j++)
+            hint = hinted.insert(hint, { static_cast<int>(j), 0 });
+        if(Tree::parent_linked)
+            ASSERT_LE(comparisons, 2 * sz);
+
+        comparisons = 0;
+        for(size_t j = 0; j < sz; j++)
+            looped.insert({ static_cast<int>(j), 0 });
+        ASSERT_LT(4 * sz, comparisons);
+
+        ASSERT_EQ(sz, appended.size());
+        ASSERT_TRUE(std::equal(appended.begin(), appended.end(), looped.begin(), looped.end()));
+        ASSERT_TRUE(std::equal(end_hinted.begin(), end_hinted.end(), looped.begin(), looped.end()));
+        ASSERT_TRUE(std::equal(hinted.begin(), hinted.end(), looped.begin(), looped.end()));
+    }
+}
+
+TEST(insert_hint_sorted_comparisons) {
+    Typegen t;
+
+    check_sorted_comparisons<balance::red_black>(t, utest_result);
+    check_sorted_comparisons<balance::avl>(t, utest_result);
+    check_sorted_comparisons<balance::treap>(t, utest_result);
+    check_sorted_comparisons<balance::scapegoat>(t, utest_result);
+}
+
+// Nearly sorted keys, each at most one place from its sorted position,
+// mostly land next to the previous one. The few that do not fall back
+// to a search, but the hint still saves over half the comparisons.
+TEST(insert_hint_nearly_sorted) {
+    Typegen t;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::red_black>;
+
+    for(size_t i = 0; i < TEST_ITER / 10; i++) {
+        size_t sz = t.range<size_t>(1024, 8192);
+        std::vector<int> keys(sz);
+        for(size_t j = 0; j < sz; j++)
+            keys[j] = static_cast<int>(j);
+        for(size_t j = 0; j + 1 < sz; j++)
+            if(t.range(0, 8) == 0)
+                std::swap(keys[j], keys[j + 1]);
+
+        Tree tree, looped;
+        comparisons = 0;
+        auto hint = tree.end();
+        for(int key : keys)
+            hint = tree.insert(hint, { key, key });
+        size_t hinted = comparisons;
+
+        comparisons = 0;
+        for(int key : keys)
+            looped.insert({ key, key });
+
+        ASSERT_EQ(sz, tree.size());
+        ASSERT_LT(2 * hinted, comparisons);
+        int expected = 0;
+        for(auto const & [key, value] : tree)
+            ASSERT_EQ(expected++, key);
+    }
+}
+
+// append_max keeps the largest node at hand instead of walking down to
+// it. Sorted keys build an unbalanced tree into a chain as tall as it is
+// large, yet the appends take no step down it, only one comparison
+// each. Erasing the largest key makes the next append walk down once to
+// find the new one.
+TEST(append_max_unbalanced_chain) {
+    Typegen t;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor>;
+
+    for(size_t i = 0; i < TEST_ITER / 10; i++) {
+        int sz = t.range(1024, 8192);
+
+        Tree chain;
+        comparisons = spine_steps = 0;
+        for(int key = 0; key < sz; key++)
+            chain.append_max({ key, key });
+        ASSERT_EQ(0ULL, spine_steps);
+        ASSERT_LE(comparisons, static_cast<size_t>(sz));
+        ASSERT_EQ(chain.size(), chain.height());
+
+        chain.erase(sz - 1);
+        spine_steps = 0;
+        chain.append_max({ sz, sz });
+        ASSERT_EQ(static_cast<size_t>(sz - 2), spine_steps);
+
+        comparisons = spine_steps = 0;
+        for(int key = sz + 1; key < 2 * sz; key++)
+            chain.append_max({ key, key });
+        ASSERT_EQ(0ULL, spine_steps);
+        ASSERT_LE(comparisons, static_cast<size_t>(sz));
+
+        ASSERT_EQ(static_cast<size_t>(2 * sz - 1), chain.size());
+        int expected = 0;
+        for(auto const & [key, value] : chain) {
+            ASSERT_EQ(expected, key);
+            expected += expected == sz - 2 ? 2 : 1;
+        }
+    }
+}
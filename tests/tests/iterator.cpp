@@ -0,0 +1,131 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+// Walks tree forwards, backwards from end() and through the reverse
+// iterators, checking each against the reference map. None of the walks
+// may allocate.
+template<typename Tree>
+void check_matches(Tree const & tree, std::map<int, int> const & expected, int * utest_result) {
+    Memhook mh;
+
+    auto e = expected.begin();
+    for(auto const & [key, value] : tree) {
+        ASSERT_TRUE(e != expected.end());
+        ASSERT_EQ(e->first, key);
+        ASSERT_EQ(e->second, value);
+        ++e;
+    }
+    ASSERT_TRUE(e == expected.end());
+
+    auto it = tree.end();
+    for(auto r = expected.rbegin(); r != expected.rend(); ++r) {
+        ASSERT_TRUE(it != tree.begin());
+        --it;
+        ASSERT_EQ(r->first, it->first);
+    }
+    ASSERT_TRUE(it == tree.begin());
+
+    auto r = expected.rbegin();
+    for(auto tr = tree.rbegin(); tr != tree.rend(); tr++, r++)
+        ASSERT_EQ(r->first, tr->first);
+    ASSERT_TRUE(r == expected.rend());
+
+    ASSERT_EQ(0ULL, mh.n_allocs());
+}
+
+// Mixed inserts, overwrites and erases exercise every path that relinks
+// nodes, so the parent pointers the iterators follow must survive all of
+// them
+template<typename Balance, typename Storage = storage::heap>
+void check_iteration(Typegen & t, int * utest_result) {
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        int key_range = static_cast<int>(2 * sz + 1);
+
+        Memhook mh;
+        {
+            BinarySearchTree<int, int, std::less<int>, Balance, Storage> tree;
+            std::map<int, int> expected;
+
+            for(size_t j = 0; j < 3 * sz; j++) {
+                int key = t.range(0, key_range);
+                // Erase only present keys; the unbalanced erase reports misses
+                if(t.range(3) == 0 && expected.count(key)) {
+                    tree.erase(key);
+                    expected.erase(key);
+                } else {
+                    int value = t.get<int>();
+                    tree.insert({ key, value });
+                    expected[key] = value;
+                }
+
+                // Non-const lookups reshape a splay tree
+                if(t.range(4) == 0)
+                    tree.contains(t.range(0, key_range));
+            }
+
+            ASSERT_EQ(expected.size(), tree.size());
+            check_matches(tree, expected, utest_result);
+
+            auto copy = tree;
+            check_matches(copy, expected, utest_result);
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(iterate_in_key_order) {
+    Typegen t;
+
+    check_iteration<balance::none>(t, utest_result);
+    check_iteration<balance::red_black>(t, utest_result);
+    check_iteration<balance::avl>(t, utest_result);
+    check_iteration<balance::treap>(t, utest_result);
+    check_iteration<balance::splay>(t, utest_result);
+    check_iteration<balance::scapegoat>(t, utest_result);
+    check_iteration<balance::red_black, storage::pool>(t, utest_result);
+}
+
+TEST(iterator_interface) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 512);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        Memhook mh;
+        {
+            BinarySearchTree<int, int> tree;
+            ASSERT_TRUE(tree.begin() == tree.end());
+            ASSERT_TRUE(tree.rbegin() == tree.rend());
+
+            for(auto const & pair : pairs)
+                tree.insert(pair);
+
+            ASSERT_EQ(static_cast<ptrdiff_t>(sz), std::distance(tree.begin(), tree.end()));
+            ASSERT_TRUE(std::is_sorted(tree.cbegin(), tree.cend(), [](auto const & a, auto const & b) {
+                return a.first < b.first;
+            }));
+            ASSERT_EQ(tree.min().first, tree.begin()->first);
+            ASSERT_EQ(tree.max().first, tree.rbegin()->first);
+            ASSERT_EQ(tree.max().first, std::prev(tree.end())->first);
+
+            // Values are writable through iterator, and iterator converts
+            // to const_iterator
+            for(auto & [key, value] : tree)
+                value = -key;
+            BinarySearchTree<int, int>::const_iterator c = tree.begin();
+            ASSERT_TRUE(c == tree.cbegin());
+            ASSERT_EQ(-c->first, c->second);
+
+            int key = pairs[t.range(sz)].first;
+            auto found = std::find_if(tree.begin(), tree.end(), [&](auto const & p) { return p.first == key; });
+            ASSERT_TRUE(found != tree.end());
+            ASSERT_EQ(-key, found->second);
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
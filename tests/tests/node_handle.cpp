@@ -0,0 +1,176 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include "box.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory_resource>
+#include <vector>
+
+template<typename Balance>
+using RankedTree = BinarySearchTree<int, int, std::less<int>, Balance, storage::heap,
+                                    std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+template<typename Tree>
+void check_contents(Tree const & tree, std::map<int, int> const & expected, size_t max_height, int * utest_result) {
+    ASSERT_TREE_SIZE_AND_HEIGHT(expected.size(), max_height, tree);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+        return a.first == b.first && a.second == b.second;
+    }));
+    ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend(), [](auto const & a, auto const & b) {
+        return a.first == b.first;
+    }));
+    size_t rank = 0;
+    for(auto const & [key, value] : expected)
+        ASSERT_EQ(rank++, tree.rank(key));
+}
+
+// Moving nodes between two trees by extract and insert, and by merge,
+// matches std::map and allocates nothing; both trees stay valid trees
+// of their policy
+template<typename Balance>
+void check_node_handles(Typegen & t, size_t max_height_factor_x100, int * utest_result) {
+    using Tree = RankedTree<Balance>;
+    auto bound = [&](size_t n) {
+        return max_height_factor_x100 > 0
+            ? static_cast<size_t>(max_height_factor_x100 * std::log2(n + 2) / 100) + 1
+            : n;
+    };
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        int key_range = static_cast<int>(2 * sz + 1);
+
+        Tree staging, live;
+        std::map<int, int> expected_staging, expected_live;
+        for(size_t j = 0; j < sz; j++) {
+            int key = t.range(0, key_range);
+            staging.insert({ key, 1 });
+            expected_staging[key] = 1;
+            key = t.range(0, key_range);
+            live.insert({ key, 2 });
+            expected_live[key] = 2;
+        }
+
+        {
+            Memhook mh;
+            for(size_t j = 0; j < sz / 2; j++) {
+                int key = t.range(0, key_range);
+                auto nh = staging.extract(key);
+                auto expected_nh = expected_staging.extract(key);
+                ASSERT_EQ(expected_nh.empty(), nh.empty());
+                if(nh.empty())
+                    continue;
+                ASSERT_EQ(key, nh.key());
+                ASSERT_EQ(1, nh.mapped());
+
+                {
+                    mh.disable();
+                    auto expected_result = expected_live.insert(std::move(expected_nh));
+                    mh.enable();
+                    auto result = live.insert(std::move(nh));
+                    ASSERT_EQ(expected_result.inserted, result.inserted);
+                    ASSERT_EQ(key, result.position->first);
+                    ASSERT_EQ(result.inserted, result.node.empty());
+                    ASSERT_TRUE(nh.empty());
+
+                    // A refused node goes back where it came from
+                    if(!result.inserted) {
+                        mh.disable();
+                        expected_staging.insert(std::move(expected_result.node));
+                        mh.enable();
+                        ASSERT_TRUE(staging.insert(std::move(result.node)).inserted);
+                    }
+                }
+            }
+
+            mh.disable();
+            std::map<int, int> expected_merged = expected_live;
+            expected_merged.merge(expected_staging);
+            mh.enable();
+            live.merge(staging);
+
+            check_contents(live, expected_merged, bound(expected_merged.size()), utest_result);
+            check_contents(staging, expected_staging, bound(expected_staging.size()), utest_result);
+            ASSERT_EQ(0ULL, mh.n_allocs());
+            ASSERT_EQ(0ULL, mh.n_frees());
+            mh.disable();
+            expected_live = std::move(expected_merged);
+        }
+
+        // Both trees carry on as usual afterwards
+        for(auto * pair : { &expected_live, &expected_staging })
+            for(auto const & [key, value] : std::map<int, int>(*pair))
+                if(t.get<bool>()) {
+                    (pair == &expected_live ? live : staging).erase(key);
+                    pair->erase(key);
+                }
+        ASSERT_EQ(expected_live.size(), live.size());
+        ASSERT_EQ(expected_staging.size(), staging.size());
+        for(int key = 0; key < key_range; key++)
+            live.insert({ key, key });
+        ASSERT_EQ(static_cast<size_t>(key_range), live.size());
+    }
+}
+
+TEST(node_handles_move_nodes) {
+    Typegen t;
+
+    check_node_handles<balance::none>(t, 0, utest_result);
+    check_node_handles<balance::red_black>(t, 200, utest_result);
+    check_node_handles<balance::avl>(t, 144, utest_result);
+    check_node_handles<balance::treap>(t, 0, utest_result);
+    check_node_handles<balance::splay>(t, 0, utest_result);
+    check_node_handles<balance::scapegoat>(t, 0, utest_result);
+}
+
+// The element itself moves: the value a Box points to stays where it
+// is, and a dropped handle frees its node and the element with it
+TEST(node_handle_keeps_element) {
+    BinarySearchTree<int, Box<int>, std::less<int>, balance::red_black> from, to;
+    for(int key = 0; key < 64; key++)
+        from.try_emplace(key, key);
+
+    int const * boxed = &*from.find(7);
+    {
+        Memhook mh;
+        auto nh = from.extract(7);
+        nh.key() = 1007;
+        to.insert(std::move(nh));
+        ASSERT_EQ(0ULL, mh.n_allocs());
+    }
+    ASSERT_FALSE(from.contains(7));
+    ASSERT_EQ(boxed, &*to.find(1007));
+
+    Memhook mh;
+    auto dropped = from.extract(from.begin());
+    ASSERT_EQ(0, dropped.key());
+    dropped = {};
+    ASSERT_EQ(2ULL, mh.n_frees());
+    ASSERT_TRUE(from.extract(7).empty());
+    ASSERT_EQ(62ULL, from.size());
+}
+
+// Trees on different memory resources cannot share nodes; merge and
+// insert move the elements into nodes from the receiving resource
+TEST(node_handle_unequal_allocators) {
+    std::pmr::unsynchronized_pool_resource first, second;
+    pmr::BinarySearchTree<int, int, std::less<int>, balance::avl> a { &first }, b { &second };
+    for(int key = 0; key < 100; key++) {
+        a.insert({ 2 * key, 0 });
+        b.insert({ 3 * key, 1 });
+    }
+
+    auto nh = b.extract(3);
+    ASSERT_TRUE(nh.get_allocator().resource() == &second);
+    ASSERT_TRUE(a.insert(std::move(nh)).inserted);
+    a.merge(b);
+
+    // Multiples of 6 up to 198 were in both and stay behind in b
+    ASSERT_EQ(34ULL, b.size());
+    ASSERT_EQ(100ULL + 66ULL, a.size());
+    for(int key = 0; key < 300; key += 3) {
+        ASSERT_EQ(key % 6 == 0 && key <= 198, b.contains(key));
+        ASSERT_TRUE(a.contains(key));
+    }
+}
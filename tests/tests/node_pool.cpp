@@ -0,0 +1,145 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include "box.h"
+#include <vector>
+
+template<typename Balance>
+using pooled_tree = BinarySearchTree<int, int, std::less<int>, Balance, storage::pool>;
+
+// Once the pool has grown to the working size of the tree, insert and
+// erase churn never reaches the global heap
+template<typename Balance>
+void check_churn_without_allocation(Typegen & t, size_t sz, int * utest_result) {
+    int key_range = static_cast<int>(4 * sz);
+
+    // Keys in the tree, and the value stored under each key (-1 if absent),
+    // kept in preallocated vectors so checking does not allocate either
+    std::vector<int> keys;
+    std::vector<int> values(key_range + 1, -1);
+    keys.reserve(sz);
+
+    pooled_tree<Balance> bst;
+
+    // Warm up: grow the tree to its working size
+    while(keys.size() < sz) {
+        int key = t.range(0, key_range);
+        if(values[key] == -1)
+            keys.push_back(key);
+        values[key] = key;
+        bst.insert({ key, key });
+    }
+
+    Memhook mh;
+    for(size_t j = 0; j < 20 * sz; j++) {
+        // Erase one key and insert another, keeping the size steady
+        size_t victim = t.range(keys.size());
+        bst.erase(keys[victim]);
+        values[keys[victim]] = -1;
+        keys[victim] = keys.back();
+        keys.pop_back();
+
+        int key = t.range(0, key_range);
+        if(values[key] == -1)
+            keys.push_back(key);
+        values[key] = static_cast<int>(j);
+        bst.insert({ key, static_cast<int>(j) });
+        ASSERT_EQ(keys.size(), bst.size());
+    }
+
+    for(int key : keys)
+        ASSERT_EQ(values[key], bst.find(key));
+
+    ASSERT_EQ(0ULL, mh.n_allocs());
+    ASSERT_EQ(0ULL, mh.n_frees());
+}
+
+TEST(pool_churn_does_not_allocate) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1000);
+        check_churn_without_allocation<balance::none>(t, sz, utest_result);
+        check_churn_without_allocation<balance::red_black>(t, sz, utest_result);
+        check_churn_without_allocation<balance::avl>(t, sz, utest_result);
+        check_churn_without_allocation<balance::treap>(t, sz, utest_result);
+        check_churn_without_allocation<balance::splay>(t, sz, utest_result);
+        check_churn_without_allocation<balance::scapegoat>(t, sz, utest_result);
+    }
+}
+
+TEST(pool_clear_frees_slabs) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 20000);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        pooled_tree<balance::red_black> bst;
+        Memhook mh;
+        for(auto const & pair : pairs)
+            bst.insert(pair);
+
+        // Slabs double from 4KB to 64KB, so the count grows slowly
+        size_t slabs = mh.n_allocs();
+        ASSERT_LE(slabs, 5 + sz * pooled_tree<balance::red_black>::node_size / 65536);
+
+        bst.clear();
+        ASSERT_TRUE(bst.empty());
+        ASSERT_EQ(slabs, mh.n_frees());
+
+        // The tree is usable again after clear
+        for(auto const & pair : pairs)
+            bst.insert(pair);
+        for(auto const & [key, value] : pairs)
+            ASSERT_EQ(value, bst.find(key));
+    }
+}
+
+TEST(pool_destroys_elements) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1000);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        Memhook mh;
+        {
+            BinarySearchTree<int, Box<int>, std::less<int>, balance::avl, storage::pool> bst;
+            for(auto const & [key, value] : pairs)
+                bst.insert({ key, Box<int>(value) });
+            for(size_t j = 0; j < sz / 2; j++)
+                bst.erase(pairs[j].first);
+
+            BinarySearchTree<int, Box<int>, std::less<int>, balance::avl, storage::pool> cpy { bst };
+            bst.clear();
+            for(size_t j = sz / 2; j < sz; j++)
+                ASSERT_EQ(pairs[j].second, *cpy.find(pairs[j].first));
+
+            BinarySearchTree<int, Box<int>, std::less<int>, balance::avl, storage::pool> moved { std::move(cpy) };
+            ASSERT_TRUE(cpy.empty());
+            ASSERT_EQ(sz - sz / 2, moved.size());
+            for(size_t j = sz / 2; j < sz; j++)
+                ASSERT_EQ(pairs[j].second, *moved.find(pairs[j].first));
+        }
+        // Boxes and slabs alike are all freed
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(pool_huge_pages) {
+    Typegen t;
+    size_t sz = 200000;
+    auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+    Memhook mh;
+    {
+        pooled_tree<balance::red_black> bst;
+        bst.use_huge_pages();
+        for(auto const & pair : pairs)
+            bst.insert(pair);
+        ASSERT_EQ(sz, bst.size());
+        for(auto const & [key, value] : pairs)
+            ASSERT_EQ(value, bst.find(key));
+    }
+    ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+}
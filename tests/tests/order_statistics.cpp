@@ -0,0 +1,126 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <map>
+#include <memory>
+
+template<typename Balance, typename Storage = storage::heap, typename Comparator = std::less<int>>
+using RankedTree = BinarySearchTree<int, int, Comparator, Balance, Storage,
+                                    std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+static_assert(
+    BinarySearchTree<int, int>::node_size == sizeof(std::pair<int, int>) + 3 * sizeof(void *),
+    "Without the augmentation a node holds only its element and links"
+);
+static_assert(
+    RankedTree<balance::none>::node_size == BinarySearchTree<int, int>::node_size + sizeof(size_t),
+    "The augmentation adds one count per node"
+);
+
+// Keys are ranked against a sorted copy of the reference map
+template<typename Tree>
+void check_ranks(Typegen & t, Tree const & tree, std::map<int, int> const & expected, int key_range, int * utest_result) {
+    std::vector<std::pair<int, int>> sorted(expected.begin(), expected.end());
+    ASSERT_EQ(sorted.size(), tree.size());
+
+    Memhook mh;
+    for(size_t i = 0; i < sorted.size(); i++) {
+        ASSERT_EQ(sorted[i].first, tree.select(i).first);
+        ASSERT_EQ(sorted[i].second, tree.nth(i)->second);
+        ASSERT_EQ(i, tree.rank(sorted[i].first));
+    }
+    ASSERT_TRUE(tree.nth(sorted.size()) == tree.end());
+
+    for(size_t i = 0; i < 32; i++) {
+        int key = t.range(-1, key_range + 1);
+        size_t below = std::lower_bound(sorted.begin(), sorted.end(), std::pair { key, INT_MIN }) - sorted.begin();
+        ASSERT_EQ(below, tree.rank(key));
+
+        int lo = t.range(-1, key_range + 1);
+        int hi = t.range(-1, key_range + 1);
+        size_t in_range = 0;
+        for(auto const & [k, v] : sorted)
+            in_range += lo <= k && k < hi;
+        ASSERT_EQ(in_range, tree.count_range(lo, hi));
+    }
+    ASSERT_EQ(0ULL, mh.n_allocs());
+}
+
+// Counts must survive every relinking path of each policy: inserts,
+// overwrites, erases, splaying lookups, treap splits and scapegoat
+// rebuilds
+template<typename Balance, typename Storage = storage::heap>
+void check_order_statistics(Typegen & t, int * utest_result) {
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        int key_range = static_cast<int>(2 * sz + 1);
+
+        Memhook mh;
+        {
+            RankedTree<Balance, Storage> tree;
+            std::map<int, int> expected;
+
+            for(size_t j = 0; j < 3 * sz; j++) {
+                int key = t.range(0, key_range);
+                // Erase only present keys; the unbalanced erase reports misses
+                if(t.range(3) == 0 && expected.count(key)) {
+                    tree.erase(key);
+                    expected.erase(key);
+                } else {
+                    int value = t.get<int>();
+                    tree.insert({ key, value });
+                    expected[key] = value;
+                }
+
+                if(t.range(4) == 0)
+                    tree.contains(t.range(0, key_range));
+            }
+
+            check_ranks(t, tree, expected, key_range, utest_result);
+
+            auto copy = tree;
+            check_ranks(t, copy, expected, key_range, utest_result);
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(order_statistics_match_sorted_order) {
+    Typegen t;
+
+    check_order_statistics<balance::none>(t, utest_result);
+    check_order_statistics<balance::red_black>(t, utest_result);
+    check_order_statistics<balance::avl>(t, utest_result);
+    check_order_statistics<balance::treap>(t, utest_result);
+    check_order_statistics<balance::splay>(t, utest_result);
+    check_order_statistics<balance::scapegoat>(t, utest_result);
+    check_order_statistics<balance::red_black, storage::pool>(t, utest_result);
+}
+
+// On a red-black tree rank makes one comparison per level
+TEST(rank_is_logarithmic) {
+    Typegen t;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 4096);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        RankedTree<balance::red_black, storage::heap, comparison_tracking_comparitor> tree;
+        for(auto const & pair : pairs)
+            tree.insert(pair);
+
+        size_t height = static_cast<size_t>(2 * std::log2(sz + 1));
+        for(size_t j = 0; j < 16; j++) {
+            comparisons = 0;
+            tree.rank(t.get<int>());
+            ASSERT_LE(comparisons, height);
+
+            comparisons = 0;
+            tree.count_range(t.get<int>(), t.get<int>());
+            ASSERT_LE(comparisons, 2 * height + 1);
+        }
+    }
+}
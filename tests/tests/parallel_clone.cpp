@@ -0,0 +1,151 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+
+template<typename Balance>
+using RankedTree = BinarySearchTree<int, int, std::less<int>, Balance, storage::heap,
+                                    std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+template<typename Tree>
+std::string level_by_level(Tree const & tree) {
+    std::stringstream ss;
+    printLevelByLevel(tree, ss);
+    return ss.str();
+}
+
+template<typename Tree>
+std::string sideways(Tree const & tree) {
+    std::stringstream ss;
+    printTree(tree, ss);
+    return ss.str();
+}
+
+// A parallel copy has the shape and elements of the original, printed
+// level by level (for the shallow red-black and AVL trees) and
+// sideways. Applying the same updates to both afterwards must keep
+// them identical, which also checks the copied colours, heights,
+// priorities and counts.
+template<typename Tree>
+void check_parallel_clone(Typegen & t, ThreadPool & pool, bool level_order, int * utest_result) {
+    for(size_t i = 0; i < TEST_ITER / 10; i++) {
+        size_t sz = t.range<size_t>(1, 4096);
+        size_t grain = t.range<size_t>(0, 512);
+
+        Tree tree;
+        for(size_t j = 0; j < sz; j++) {
+            int key = t.range(0, static_cast<int>(4 * sz));
+            tree.insert({ key, t.get<int>() });
+        }
+
+        Tree copy(tree, pool, grain);
+        ASSERT_EQ(tree.size(), copy.size());
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), copy.begin(), copy.end()));
+        ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), copy.rbegin(), copy.rend()));
+        if(level_order)
+            ASSERT_TRUE(level_by_level(tree) == level_by_level(copy));
+        ASSERT_TRUE(sideways(tree) == sideways(copy));
+
+        for(size_t j = 0; j < sz; j++) {
+            int key = t.range(0, static_cast<int>(4 * sz));
+            if(t.get<bool>()) {
+                tree.insert({ key, key });
+                copy.insert({ key, key });
+            } else {
+                // Lookups reshape splay trees, so both trees look
+                bool present = tree.contains(key);
+                ASSERT_EQ(present, copy.contains(key));
+                if(present) {
+                    tree.erase(key);
+                    copy.erase(key);
+                }
+            }
+        }
+        if(level_order)
+            ASSERT_TRUE(level_by_level(tree) == level_by_level(copy));
+        ASSERT_TRUE(sideways(tree) == sideways(copy));
+        if constexpr (std::is_same_v<typename Tree::augment_policy, augment::order_statistics>) {
+            for(size_t j = 0; j < copy.size(); j++)
+                ASSERT_EQ(tree.select(j).first, copy.select(j).first);
+        }
+    }
+}
+
+TEST(parallel_clone_copies_exactly) {
+    Typegen t;
+    ThreadPool pool(4);
+
+    check_parallel_clone<BinarySearchTree<int, int>>(t, pool, false, utest_result);
+    check_parallel_clone<BinarySearchTree<int, int, std::less<int>, balance::red_black>>(t, pool, true, utest_result);
+    check_parallel_clone<BinarySearchTree<int, int, std::less<int>, balance::avl>>(t, pool, true, utest_result);
+    check_parallel_clone<RankedTree<balance::treap>>(t, pool, false, utest_result);
+    check_parallel_clone<RankedTree<balance::splay>>(t, pool, false, utest_result);
+    check_parallel_clone<RankedTree<balance::scapegoat>>(t, pool, false, utest_result);
+}
+
+// Above the grain the plain copy constructor and copy assignment take
+// the shared pool
+TEST(parallel_clone_large_tree) {
+    using Tree = BinarySearchTree<int, int, std::less<int>, balance::red_black>;
+    Typegen t;
+
+    Tree tree;
+    for(size_t j = 0; j < 4 * Tree::parallel_clone_grain; j++)
+        tree.insert({ t.get<int>(), static_cast<int>(j) });
+
+    Tree copy(tree);
+    ASSERT_TRUE(level_by_level(tree) == level_by_level(copy));
+
+    Tree assigned;
+    assigned.insert({ 1, 1 });
+    assigned = tree;
+    ASSERT_TRUE(level_by_level(tree) == level_by_level(assigned));
+}
+
+// Counts live values; the copy constructor throws once armed and the
+// countdown runs out
+struct fragile {
+    static std::atomic<long> live;
+    static std::atomic<long> countdown;
+
+    int v = 0;
+
+    fragile(int x = 0) : v(x) { live++; }
+    fragile(fragile const & other) : v(other.v) {
+        if(countdown-- == 0)
+            throw std::runtime_error("copy failed");
+        live++;
+    }
+    ~fragile() { live--; }
+};
+std::atomic<long> fragile::live { 0 };
+std::atomic<long> fragile::countdown { -1 };
+
+// A copy that throws on some thread frees everything the other threads
+// copied and leaves the original alone
+TEST(parallel_clone_exception_safety) {
+    using Tree = BinarySearchTree<int, fragile, std::less<int>, balance::avl>;
+    Typegen t;
+    ThreadPool pool(4);
+
+    Tree tree;
+    for(int key = 0; key < 2048; key++)
+        tree.insert({ key, fragile(key) });
+    long before = fragile::live;
+
+    for(size_t i = 0; i < TEST_ITER / 10; i++) {
+        fragile::countdown = t.range(0, 2048);
+        bool thrown = false;
+        try {
+            Tree copy(tree, pool, 16);
+        } catch(std::runtime_error const &) {
+            thrown = true;
+        }
+        fragile::countdown = -1;
+        ASSERT_TRUE(thrown);
+        ASSERT_EQ(before, fragile::live.load());
+    }
+    ASSERT_EQ(2048ULL, tree.size());
+    ASSERT_EQ(7, tree.find(7).v);
+}
@@ -0,0 +1,190 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include "PersistentSearchTree.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <thread>
+#include <vector>
+
+using Persistent = PersistentSearchTree<int, int>;
+
+static bool same_elements(const Persistent & tree, const std::map<int, int> & expected) {
+    std::vector<std::pair<int, int>> elements;
+    tree.for_each([&](auto const & e) { elements.push_back(e); });
+    return tree.size() == expected.size()
+        && std::equal(elements.begin(), elements.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+               return a.first == b.first && a.second == b.second;
+           });
+}
+
+// Every version keeps the contents it had when it was taken, however the
+// tree is updated afterwards, and stays AVL-balanced
+TEST(persistent_versions_are_unaffected_by_updates) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t ops = t.range<size_t>(0, 1024);
+        int key_range = static_cast<int>(ops / 2 + 1);
+
+        Persistent tree;
+        std::map<int, int> expected;
+        std::vector<std::pair<Persistent, std::map<int, int>>> versions;
+
+        for(size_t j = 0; j < ops; j++) {
+            int key = t.range(0, key_range);
+            if(t.range(0, 3) > 0) {
+                tree.insert({ key, static_cast<int>(j) });
+                expected[key] = static_cast<int>(j);
+            } else {
+                tree.erase(key);
+                expected.erase(key);
+            }
+
+            size_t n = expected.size();
+            ASSERT_LE(tree.height(), static_cast<size_t>(1.44 * std::log2(n + 2)));
+            if(j % 64 == 0)
+                versions.emplace_back(tree.snapshot(), expected);
+        }
+        ASSERT_TRUE(same_elements(tree, expected));
+
+        for(auto const & [version, contents] : versions) {
+            ASSERT_TRUE(same_elements(version, contents));
+            for(auto const & [key, value] : contents) {
+                ASSERT_TRUE(version.contains(key));
+                ASSERT_EQ(value, version.find(key));
+            }
+            if(!contents.empty()) {
+                ASSERT_EQ(contents.begin()->first, version.min().first);
+                ASSERT_EQ(contents.rbegin()->first, version.max().first);
+            }
+        }
+    }
+}
+
+// A snapshot allocates nothing, an update allocates at most a few nodes
+// per level, and old versions are freed with the last handle to them
+TEST(persistent_memory) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(1, 2048);
+        std::vector<Persistent> versions;
+        versions.reserve(sz + 1);
+
+        Memhook mh;
+        {
+            versions.emplace_back();
+            for(size_t j = 0; j < sz; j++) {
+                int key = t.range(0, static_cast<int>(2 * sz));
+
+                size_t before = mh.n_allocs();
+                Persistent copy = versions.back();
+                ASSERT_EQ(before, mh.n_allocs());
+                ASSERT_TRUE(copy.shares_root(versions.back()));
+
+                size_t bound = 2 * copy.height() + 3;
+                if(t.range(0, 3) > 0)
+                    copy.insert({ key, key });
+                else
+                    copy.erase(key);
+                ASSERT_LE(mh.n_allocs() - before, bound);
+                versions.push_back(std::move(copy));
+            }
+
+            // Dropping versions in any order frees only what nobody shares
+            t.shuffle(versions.begin(), versions.end());
+            while(!versions.empty()) {
+                Persistent kept = versions.back();
+                versions.pop_back();
+                kept.for_each([](auto const &) { });
+            }
+        }
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(persistent_from_freeze) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(0, 2048);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        BinarySearchTree<int, int> bst;
+        std::map<int, int> expected;
+        for(auto const & pair : pairs) {
+            bst.insert(pair);
+            expected.insert(pair);
+        }
+
+        auto persistent = bst.freeze<Persistent>();
+        ASSERT_EQ(sz, bst.size());
+        ASSERT_TRUE(same_elements(persistent, expected));
+        ASSERT_LE(persistent.height(), static_cast<size_t>(std::log2(sz + 1)) + 1);
+
+        // The frozen copy keeps taking updates
+        persistent.insert({ -1, -1 });
+        persistent.erase(pairs.empty() ? 0 : pairs.front().first);
+        ASSERT_EQ(sz, persistent.size());
+        ASSERT_TRUE(persistent.contains(-1));
+    }
+}
+
+// Readers work on their own snapshots while the writer keeps updating and
+// dropping versions that share nodes with them
+TEST(persistent_snapshots_across_threads) {
+    constexpr int keys = 4096;
+    constexpr int readers = 3;
+
+    Persistent tree;
+    for(int key = 0; key < keys; key++)
+        tree.insert({ key, 0 });
+
+    std::vector<Persistent> published(readers, tree);
+    std::vector<std::atomic<bool>> taken(readers);
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+
+    std::vector<std::thread> threads;
+    for(int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            while(!done.load()) {
+                if(taken[r].load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                Persistent version = published[r];
+                taken[r].store(true, std::memory_order_release);
+
+                // Each version was written with a single value throughout
+                int value = version.find(0);
+                int count = 0;
+                version.for_each([&](auto const & e) {
+                    count++;
+                    if(e.second != value)
+                        bad++;
+                });
+                if(count != keys)
+                    bad++;
+            }
+        });
+    }
+
+    for(int round = 1; round <= 64; round++) {
+        for(int key = 0; key < keys; key++)
+            tree.insert({ key, round });
+        for(int r = 0; r < readers; r++) {
+            while(!taken[r].load(std::memory_order_acquire))
+                std::this_thread::yield();
+            published[r] = tree;
+            taken[r].store(false, std::memory_order_release);
+        }
+    }
+    done = true;
+    for(auto & thread : threads)
+        thread.join();
+
+    ASSERT_EQ(0, bad.load());
+}
@@ -0,0 +1,140 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <cmath>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// lower_bound, upper_bound and equal_range agree with std::map for keys
+// in the tree, between them and past either end
+template<typename Balance>
+void check_bounds(Typegen & t, int * utest_result) {
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        int key_range = static_cast<int>(4 * sz + 4);
+
+        BinarySearchTree<int, int, std::less<int>, Balance> tree;
+        std::map<int, int> expected;
+        for(size_t j = 0; j < sz; j++) {
+            int key = t.range(0, key_range);
+            tree.insert({ key, j });
+            expected[key] = j;
+        }
+
+        Memhook mh;
+        for(size_t j = 0; j < 64; j++) {
+            int key = t.range(-1, key_range + 1);
+
+            auto lb = tree.lower_bound(key);
+            auto e_lb = expected.lower_bound(key);
+            ASSERT_EQ(e_lb == expected.end(), lb == tree.end());
+            if(lb != tree.end())
+                ASSERT_EQ(e_lb->first, lb->first);
+
+            auto const & view = tree;
+            auto ub = view.upper_bound(key);
+            auto e_ub = expected.upper_bound(key);
+            ASSERT_EQ(e_ub == expected.end(), ub == view.end());
+            if(ub != view.end())
+                ASSERT_EQ(e_ub->first, ub->first);
+
+            auto [first, last] = tree.equal_range(key);
+            ASSERT_EQ(static_cast<ptrdiff_t>(expected.count(key)), std::distance(first, last));
+        }
+        ASSERT_EQ(0ULL, mh.n_allocs());
+    }
+}
+
+TEST(lower_and_upper_bound) {
+    Typegen t;
+
+    check_bounds<balance::none>(t, utest_result);
+    check_bounds<balance::red_black>(t, utest_result);
+    check_bounds<balance::splay>(t, utest_result);
+}
+
+TEST(for_each_in_range_prunes) {
+    Typegen t;
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::red_black>;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 4096);
+
+        Tree tree;
+        for(size_t j = 0; j < sz; j++)
+            tree.insert({ static_cast<int>(2 * j), static_cast<int>(j) });
+
+        int lo = t.range(-2, static_cast<int>(2 * sz + 2));
+        int hi = lo + t.range(0, 64);
+
+        std::vector<int> visited;
+        visited.reserve(64);
+        comparisons = 0;
+        {
+            Memhook mh;
+            tree.for_each_in_range(lo, hi, [&](auto const & p) { visited.push_back(p.first); });
+            ASSERT_EQ(0ULL, mh.n_allocs());
+        }
+
+        // One comparison per level on the way down, then one per
+        // visited element and one for the key that ends the walk
+        double height = 2 * std::log2(sz + 1);
+        ASSERT_LE(comparisons, static_cast<size_t>(height) + visited.size() + 1);
+
+        std::vector<int> expected;
+        for(int key = std::max(lo, 0); key < hi && key < static_cast<int>(2 * sz); key++)
+            if(key % 2 == 0)
+                expected.push_back(key);
+        ASSERT_TRUE(visited == expected);
+    }
+}
+
+// Every lookup navigates with the comparator, so a tree ordered by
+// std::greater is searched in descending order
+TEST(range_queries_honor_comparator) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 256);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        BinarySearchTree<int, int, std::greater<int>, balance::avl> tree;
+        std::map<int, int, std::greater<int>> expected;
+        for(auto const & pair : pairs) {
+            tree.insert(pair);
+            expected.insert(pair);
+        }
+
+        for(auto const & [key, value] : pairs) {
+            ASSERT_TRUE(tree.contains(key));
+            ASSERT_EQ(value, tree.lower_bound(key)->second);
+        }
+        ASSERT_EQ(expected.begin()->first, tree.begin()->first);
+
+        int lo = t.get<int>(), hi = t.get<int>();
+        if(lo < hi)
+            std::swap(lo, hi);
+
+        std::vector<int> visited;
+        tree.for_each_in_range(lo, hi, [&](auto const & p) { visited.push_back(p.first); });
+
+        std::vector<int> in_range;
+        for(auto it = expected.lower_bound(lo); it != expected.lower_bound(hi); ++it)
+            in_range.push_back(it->first);
+        ASSERT_TRUE(visited == in_range);
+    }
+
+    // A key the comparator considers equal to a stored one is found even
+    // though the two differ under operator<
+    struct by_length {
+        bool operator()(std::string const & a, std::string const & b) const { return a.size() < b.size(); }
+    };
+    BinarySearchTree<std::string, int, by_length> tree;
+    tree.insert({ "abc", 3 });
+    tree.insert({ "a", 1 });
+    ASSERT_TRUE(tree.contains("xyz"));
+    ASSERT_FALSE(tree.contains("xy"));
+    ASSERT_EQ(3, tree.lower_bound("xy")->second);
+}
@@ -0,0 +1,129 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+
+using RBTree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::red_black>;
+
+// A red-black tree with n nodes is at most 2 * log2(n + 1) nodes tall
+// and insert makes at most two comparisons per node on its path
+size_t rb_insert_bound(size_t n) {
+    return 2 * static_cast<size_t>(std::ceil(2 * std::log2(n + 1)));
+}
+
+TEST(red_black_sorted_insert) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 2048);
+        bool descending = t.get<bool>();
+
+        Memhook mh;
+        {
+            RBTree tree;
+            std::vector<std::pair<int, int>> pairs;
+
+            for(size_t j = 0; j < sz; j++) {
+                int key = descending ? static_cast<int>(sz - j) : static_cast<int>(j);
+                std::pair<int, int> p { key, t.get<int>() };
+
+                {
+                    Memhook mh;
+                    INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                        0, rb_insert_bound(tree.size() + 1),
+                        tree, p
+                    );
+                    ASSERT_EQ(1ULL, mh.n_allocs());
+                }
+
+                pairs.push_back(p);
+            }
+
+            ASSERT_EQ(sz, tree.size());
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+
+            ASSERT_EQ(descending ? 1 : 0, tree.min().first);
+            ASSERT_EQ(descending ? static_cast<int>(sz) : static_cast<int>(sz - 1), tree.max().first);
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(red_black_erase) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1024);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        if(t.get<bool>())
+            std::sort(pairs.begin(), pairs.end());
+
+        Memhook mh;
+        {
+            RBTree tree;
+
+            for(auto const & pair : pairs)
+                tree.insert(pair);
+
+            while(!pairs.empty()) {
+                size_t idx = t.range(pairs.size());
+
+                {
+                    Memhook mh;
+                    tree.erase(pairs[idx].first);
+                    ASSERT_EQ(1ULL, mh.n_frees());
+                    ASSERT_EQ(0ULL, mh.n_allocs());
+                }
+
+                ASSERT_FALSE(tree.contains(pairs[idx].first));
+                pairs.erase(pairs.begin() + idx);
+                ASSERT_EQ(pairs.size(), tree.size());
+
+                // Reinserting an erased key walks a path of balanced length
+                if(!pairs.empty() && t.get<bool>()) {
+                    auto const & pair = pairs[t.range(pairs.size())];
+                    INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                        1, rb_insert_bound(tree.size()),
+                        tree, pair
+                    );
+                }
+            }
+
+            ASSERT_TRUE(tree.empty());
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(red_black_copy_and_move) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+        std::sort(pairs.begin(), pairs.end());
+
+        RBTree src;
+        for(auto const & pair : pairs)
+            src.insert(pair);
+
+        RBTree cpy { src };
+        ASSERT_EQ(sz, cpy.size());
+        ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, cpy);
+
+        // The copy keeps its colors and so stays balanced under insertion
+        if(sz) {
+            cpy.erase(pairs.back().first);
+            INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                1, rb_insert_bound(sz), cpy, pairs.back()
+            );
+        }
+
+        RBTree moved { std::move(cpy) };
+        ASSERT_EQ(sz, moved.size());
+        ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, moved);
+    }
+}
@@ -0,0 +1,176 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using ScapegoatTree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::scapegoat>;
+
+// No parent pointer either: a node is its element and two child pointers
+static_assert(
+    BinarySearchTree<int, int, std::less<int>, balance::scapegoat>::node_size
+        == sizeof(std::pair<int, int>) + 2 * sizeof(void *),
+    "Scapegoat nodes carry no per-node bookkeeping"
+);
+static_assert(!BinarySearchTree<int, int, std::less<int>, balance::scapegoat>::parent_linked);
+
+// A scapegoat tree is at most log_{3/2}(n) + 1 nodes tall and insert
+// makes at most two comparisons per node on its path
+size_t scapegoat_insert_bound(size_t n) {
+    return 2 * (static_cast<size_t>(std::log(n + 1) / std::log(1.5)) + 2);
+}
+
+TEST(scapegoat_sorted_insert) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 2048);
+        bool descending = t.get<bool>();
+
+        Memhook mh;
+        {
+            ScapegoatTree tree;
+            std::vector<std::pair<int, int>> pairs;
+
+            for(size_t j = 0; j < sz; j++) {
+                int key = descending ? static_cast<int>(sz - j) : static_cast<int>(j);
+                std::pair<int, int> p { key, t.get<int>() };
+
+                {
+                    Memhook mh;
+                    INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                        0, scapegoat_insert_bound(tree.size() + 1),
+                        tree, p
+                    );
+                    // Rebuilding relinks existing nodes
+                    ASSERT_EQ(1ULL, mh.n_allocs());
+                    ASSERT_EQ(0ULL, mh.n_frees());
+                }
+
+                pairs.push_back(p);
+            }
+
+            ASSERT_EQ(sz, tree.size());
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(scapegoat_erase) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 1024);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        if(t.get<bool>())
+            std::sort(pairs.begin(), pairs.end());
+
+        Memhook mh;
+        {
+            ScapegoatTree tree;
+
+            for(auto const & pair : pairs)
+                tree.insert(pair);
+
+            while(!pairs.empty()) {
+                size_t idx = t.range(pairs.size());
+
+                {
+                    Memhook mh;
+                    tree.erase(pairs[idx].first);
+                    ASSERT_EQ(1ULL, mh.n_frees());
+                    ASSERT_EQ(0ULL, mh.n_allocs());
+                }
+
+                ASSERT_FALSE(tree.contains(pairs[idx].first));
+                pairs.erase(pairs.begin() + idx);
+                ASSERT_EQ(pairs.size(), tree.size());
+
+                if(!pairs.empty() && t.get<bool>()) {
+                    auto const & pair = pairs[t.range(pairs.size())];
+                    INSERT_AND_ASSERT_COMPARISONS_BETWEEN(
+                        1, scapegoat_insert_bound(tree.size()),
+                        tree, pair
+                    );
+                }
+            }
+
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(scapegoat_large_sorted_insert) {
+    size_t const sz = 1 << 18;
+
+    BinarySearchTree<int, int, std::less<int>, balance::scapegoat> tree;
+    for(size_t i = 0; i < sz; i++)
+        tree.insert({ static_cast<int>(i), static_cast<int>(i) });
+
+    ASSERT_EQ(sz, tree.size());
+    ASSERT_EQ(0, tree.min().first);
+    ASSERT_EQ(static_cast<int>(sz - 1), tree.max().first);
+
+    for(size_t i = 0; i < sz; i += 97)
+        ASSERT_EQ(static_cast<int>(i), tree.find(static_cast<int>(i)));
+}
+
+// Without parent links the const walks (height, freeze, iteration and
+// printing) only read the tree, so several threads may run them on one
+// const tree at once and all see it whole
+TEST(scapegoat_const_walks_from_threads) {
+    using Tree = BinarySearchTree<int, int, std::less<int>, balance::scapegoat>;
+    constexpr int sz = 1 << 14;
+    constexpr int readers = 4;
+
+    Tree tree;
+    Typegen t;
+    std::vector<int> keys(sz);
+    for(int i = 0; i < sz; i++)
+        keys[i] = i;
+    t.shuffle(keys.begin(), keys.end());
+    for(int key : keys)
+        tree.insert({ key, -key });
+
+    const Tree & view = tree;
+    size_t const height = view.height();
+    std::ostringstream expected_print;
+    printTree(view, expected_print);
+
+    std::atomic<int> bad{0};
+    std::vector<std::thread> threads;
+    for(int r = 0; r < readers; r++) {
+        threads.emplace_back([&] {
+            for(int round = 0; round < 8; round++) {
+                if(view.height() != height)
+                    bad++;
+                auto frozen = view.freeze();
+                if(frozen.size() != view.size())
+                    bad++;
+                int expected = 0;
+                for(auto const & [key, value] : view)
+                    if(key != expected++ || value != -key)
+                        bad++;
+                if(expected != sz)
+                    bad++;
+                std::ostringstream printed;
+                printTree(view, printed);
+                if(printed.str() != expected_print.str())
+                    bad++;
+            }
+        });
+    }
+    for(auto & thread : threads)
+        thread.join();
+
+    ASSERT_EQ(0, bad.load());
+    ASSERT_EQ(height, tree.height());
+}
@@ -0,0 +1,154 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+template<typename Balance>
+using RankedTree = BinarySearchTree<int, int, std::less<int>, Balance, storage::heap,
+                                    std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+using Pairs = std::vector<std::pair<int, int>>;
+
+// Sorted, unique keys; a tree of them is built by repeated insert
+Pairs random_set(Typegen & t, size_t sz, int key_range, int value) {
+    std::map<int, int> m;
+    for(size_t i = 0; i < sz; i++)
+        m[t.range(0, key_range)] = value;
+    return Pairs(m.begin(), m.end());
+}
+
+template<typename Tree>
+Tree make_tree(Pairs const & pairs) {
+    Tree tree;
+    for(auto const & pair : pairs)
+        tree.insert(pair);
+    return tree;
+}
+
+template<typename Tree>
+void check_result(Tree const & tree, Pairs const & expected, size_t max_height_factor_x100, int * utest_result) {
+    size_t n = expected.size();
+    size_t bound = max_height_factor_x100 > 0
+        ? static_cast<size_t>(max_height_factor_x100 * std::log2(n + 2) / 100) + 1
+        : n;
+    ASSERT_TREE_SIZE_AND_HEIGHT(n, bound, tree);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+    ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend()));
+    if constexpr (std::is_same_v<typename Tree::augment_policy, augment::order_statistics>) {
+        for(size_t i = 0; i < n; i++)
+            ASSERT_EQ(i, tree.rank(expected[i].first));
+    }
+}
+
+// Each operation agrees with the std:: algorithm on sorted ranges, which
+// also copy equal keys from the first range. Both inputs end up empty,
+// every node is either kept or freed, and the result keeps working.
+template<typename Tree>
+void check_set_algebra(Typegen & t, ThreadPool & pool, size_t max_height_factor_x100, int * utest_result) {
+    auto by_key = [](auto const & x, auto const & y) { return x.first < y.first; };
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        // Sizes from equal to very uneven
+        size_t m = t.range<size_t>(0, 256);
+        size_t n = t.get<bool>() ? t.range<size_t>(0, 256) : t.range<size_t>(0, 8);
+        int key_range = static_cast<int>(m + n + 1);
+        Pairs a = random_set(t, m, key_range, 1);
+        Pairs b = random_set(t, n, key_range, 2);
+
+        Pairs united, common, only_a;
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(united), by_key);
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(common), by_key);
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(only_a), by_key);
+
+        // Memhook counts from one thread only
+        std::optional<Memhook> mh;
+        if(pool.size() == 1)
+            mh.emplace();
+
+        Tree ta = make_tree<Tree>(a), tb = make_tree<Tree>(b);
+        Tree u = Tree::merge_union(std::move(ta), std::move(tb), pool);
+        ASSERT_EQ(0ULL, ta.size());
+        ASSERT_EQ(0ULL, tb.size());
+        check_result(u, united, max_height_factor_x100, utest_result);
+
+        ta = make_tree<Tree>(a), tb = make_tree<Tree>(b);
+        Tree x = Tree::intersect(std::move(ta), std::move(tb), pool);
+        check_result(x, common, max_height_factor_x100, utest_result);
+
+        ta = make_tree<Tree>(a), tb = make_tree<Tree>(b);
+        Tree d = Tree::difference(std::move(ta), std::move(tb), pool);
+        check_result(d, only_a, max_height_factor_x100, utest_result);
+
+        // The results are ordinary trees
+        u.insert({ -1, 0 });
+        u.erase(-1);
+        if(!common.empty())
+            x.erase(common.front().first);
+        check_result(u, united, max_height_factor_x100, utest_result);
+
+        u.clear(), x.clear(), d.clear();
+        if(mh)
+            ASSERT_EQ(mh->n_allocs(), mh->n_frees());
+    }
+}
+
+template<typename Balance>
+void check_all_trees(Typegen & t, ThreadPool & pool, size_t max_height_factor_x100, int * utest_result) {
+    check_set_algebra<BinarySearchTree<int, int, std::less<int>, Balance>>(t, pool, max_height_factor_x100, utest_result);
+    check_set_algebra<RankedTree<Balance>>(t, pool, max_height_factor_x100, utest_result);
+}
+
+TEST(set_algebra_matches_std_algorithms) {
+    Typegen t;
+    ThreadPool serial(1);
+
+    check_all_trees<balance::none>(t, serial, 0, utest_result);
+    check_all_trees<balance::red_black>(t, serial, 200, utest_result);
+    check_all_trees<balance::avl>(t, serial, 144, utest_result);
+    check_all_trees<balance::treap>(t, serial, 0, utest_result);
+    check_all_trees<balance::splay>(t, serial, 0, utest_result);
+    check_all_trees<balance::scapegoat>(t, serial, 0, utest_result);
+}
+
+// Forked tasks run on the pool's workers however many cores there are
+TEST(set_algebra_on_a_thread_pool) {
+    Typegen t;
+    ThreadPool pool(4);
+
+    check_all_trees<balance::red_black>(t, pool, 200, utest_result);
+    check_all_trees<balance::avl>(t, pool, 144, utest_result);
+    check_all_trees<balance::treap>(t, pool, 0, utest_result);
+    check_all_trees<balance::none>(t, pool, 0, utest_result);
+}
+
+// Merging a few keys into a large tree touches only their paths: on a
+// red-black tree the comparisons grow with m log(n / m), far below one
+// lookup per key of the large tree
+TEST(merge_union_of_uneven_trees) {
+    Typegen t;
+    size_t & comparisons = comparison_tracking_comparitor::comparisons;
+    using Tree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::red_black>;
+    ThreadPool serial(1);
+
+    for(size_t i = 0; i < TEST_ITER / 10; i++) {
+        size_t n = t.range<size_t>(4096, 16384);
+        size_t m = t.range<size_t>(1, 16);
+
+        Tree large, small;
+        for(size_t j = 0; j < n; j++)
+            large.insert({ static_cast<int>(2 * j), 0 });
+        for(size_t j = 0; j < m; j++)
+            small.insert({ 2 * t.range(0, static_cast<int>(n)) + 1, 1 });
+        size_t expected = n + small.size();
+
+        comparisons = 0;
+        Tree merged = Tree::merge_union(std::move(large), std::move(small), serial);
+        ASSERT_EQ(expected, merged.size());
+        ASSERT_LE(comparisons, static_cast<size_t>(8 * m * (std::log2(static_cast<double>(n) / m) + 2)));
+    }
+}
@@ -0,0 +1,105 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+
+using SplayTree = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::splay>;
+
+TEST(splay_access_moves_to_root) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 512);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        Memhook mh;
+        {
+            SplayTree tree;
+
+            for(auto const & pair : pairs) {
+                tree.insert(pair);
+                ASSERT_EQ(pair.first, tree.root().first);
+            }
+
+            ASSERT_EQ(sz, tree.size());
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+
+            for(size_t j = 0; j < sz; j++) {
+                auto const & [key, value] = pairs[t.range(sz)];
+
+                if(t.get<bool>()) {
+                    ASSERT_EQ(value, tree.find(key));
+                } else {
+                    ASSERT_TRUE(tree.contains(key));
+                }
+                ASSERT_EQ(key, tree.root().first);
+
+                // A hot key is found at the root with two comparisons
+                size_t & comparisons = comparison_tracking_comparitor::comparisons;
+                comparisons = 0;
+                ASSERT_EQ(value, tree.find(key));
+                ASSERT_EQ(2ULL, comparisons);
+            }
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(splay_const_access_keeps_shape) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 512);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        SplayTree tree;
+        for(auto const & pair : pairs)
+            tree.insert(pair);
+
+        SplayTree const & view = tree;
+        int root_key = view.root().first;
+
+        for(auto const & [key, value] : pairs) {
+            ASSERT_EQ(value, view.find(key));
+            ASSERT_TRUE(view.contains(key));
+            ASSERT_EQ(root_key, view.root().first);
+        }
+    }
+}
+
+TEST(splay_erase) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 512);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        if(t.get<bool>())
+            std::sort(pairs.begin(), pairs.end());
+
+        Memhook mh;
+        {
+            SplayTree tree;
+            for(auto const & pair : pairs)
+                tree.insert(pair);
+
+            while(!pairs.empty()) {
+                size_t idx = t.range(pairs.size());
+
+                {
+                    Memhook mh;
+                    tree.erase(pairs[idx].first);
+                    ASSERT_EQ(1ULL, mh.n_frees());
+                }
+
+                ASSERT_FALSE(tree.contains(pairs[idx].first));
+                pairs.erase(pairs.begin() + idx);
+                ASSERT_EQ(pairs.size(), tree.size());
+            }
+
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
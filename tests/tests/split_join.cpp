@@ -0,0 +1,185 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <vector>
+
+template<typename Balance>
+using RankedTree = BinarySearchTree<int, int, std::less<int>, Balance, storage::heap,
+                                    std::allocator<std::pair<int, int>>, augment::order_statistics>;
+
+template<typename Tree>
+void check_contents(Tree const & tree, std::map<int, int> const & expected, size_t max_height, int * utest_result) {
+    ASSERT_TREE_SIZE_AND_HEIGHT(expected.size(), max_height, tree);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end(), [](auto const & a, auto const & b) {
+        return a.first == b.first && a.second == b.second;
+    }));
+    ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), expected.rbegin(), expected.rend(), [](auto const & a, auto const & b) {
+        return a.first == b.first;
+    }));
+    if constexpr (std::is_same_v<typename Tree::augment_policy, augment::order_statistics>) {
+        size_t rank = 0;
+        for(auto const & [key, value] : expected)
+            ASSERT_EQ(rank++, tree.rank(key));
+    }
+}
+
+// Splitting at a key and joining the halves back relinks nodes only;
+// each half, and the rejoined tree, is a valid tree of its policy that
+// later inserts and erases keep working on
+template<typename Tree>
+void check_split_join(Typegen & t, size_t max_height_factor_x100, int * utest_result) {
+    auto bound = [&](size_t n) {
+        return max_height_factor_x100 > 0
+            ? static_cast<size_t>(max_height_factor_x100 * std::log2(n + 2) / 100) + 1
+            : n;
+    };
+
+    for(size_t i = 0; i < TEST_ITER / 4; i++) {
+        size_t sz = t.range<size_t>(0, 512);
+        int key_range = static_cast<int>(2 * sz + 1);
+
+        Memhook outer;
+        {
+            Tree tree;
+            std::map<int, int> expected;
+            for(size_t j = 0; j < sz; j++) {
+                int key = t.range(0, key_range);
+                tree.insert({ key, static_cast<int>(j) });
+                expected[key] = static_cast<int>(j);
+            }
+
+            for(size_t round = 0; round < 4; round++) {
+                int key = t.range(-1, key_range + 1);
+                std::map<int, int> below(expected.begin(), expected.lower_bound(key));
+                std::map<int, int> above(expected.lower_bound(key), expected.end());
+
+                Memhook mh;
+                auto [left, right] = tree.split(key);
+                ASSERT_EQ(0ULL, mh.n_allocs());
+                ASSERT_EQ(0ULL, tree.size());
+                check_contents(left, below, bound(below.size()), utest_result);
+                check_contents(right, above, bound(above.size()), utest_result);
+
+                // Both halves carry on independently
+                if(!below.empty()) {
+                    int victim = below.begin()->first;
+                    left.erase(victim);
+                    expected.erase(victim);
+                }
+                if(key > 0) {
+                    left.insert({ key - 1, -1 });
+                    expected[key - 1] = -1;
+                }
+                right.insert({ key, -2 });
+                expected[key] = -2;
+
+                Memhook rejoin;
+                tree = Tree::join(std::move(left), std::move(right));
+                ASSERT_EQ(0ULL, rejoin.n_allocs());
+                ASSERT_EQ(0ULL, rejoin.n_frees());
+                ASSERT_EQ(0ULL, left.size());
+                ASSERT_EQ(0ULL, right.size());
+                check_contents(tree, expected, bound(expected.size()), utest_result);
+            }
+        }
+        ASSERT_EQ(outer.n_allocs(), outer.n_frees());
+    }
+}
+
+TEST(split_and_join_relink_nodes) {
+    Typegen t;
+
+    check_split_join<BinarySearchTree<int, int>>(t, 0, utest_result);
+    check_split_join<BinarySearchTree<int, int, std::less<int>, balance::red_black>>(t, 200, utest_result);
+    check_split_join<BinarySearchTree<int, int, std::less<int>, balance::avl>>(t, 144, utest_result);
+    check_split_join<BinarySearchTree<int, int, std::less<int>, balance::treap>>(t, 0, utest_result);
+    check_split_join<BinarySearchTree<int, int, std::less<int>, balance::splay>>(t, 0, utest_result);
+    check_split_join<BinarySearchTree<int, int, std::less<int>, balance::scapegoat>>(t, 0, utest_result);
+
+    check_split_join<RankedTree<balance::none>>(t, 0, utest_result);
+    check_split_join<RankedTree<balance::red_black>>(t, 200, utest_result);
+    check_split_join<RankedTree<balance::avl>>(t, 144, utest_result);
+    check_split_join<RankedTree<balance::treap>>(t, 0, utest_result);
+    check_split_join<RankedTree<balance::splay>>(t, 0, utest_result);
+    check_split_join<RankedTree<balance::scapegoat>>(t, 0, utest_result);
+}
+
+// Joining trees of very different sizes: the small one is linked in
+// near the top or bottom of the inner spine of the large one
+TEST(join_uneven_trees) {
+    Typegen t;
+    using Tree = BinarySearchTree<int, int, std::less<int>, balance::red_black>;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t small = t.range<size_t>(0, 8);
+        size_t large = t.range<size_t>(0, 2048);
+        bool small_first = t.get<bool>();
+
+        Tree a, b;
+        std::map<int, int> expected;
+        for(size_t j = 0; j < small + large; j++) {
+            int key = static_cast<int>(j);
+            bool in_a = small_first ? j < small : j < large;
+            (in_a ? a : b).insert({ key, key });
+            expected[key] = key;
+        }
+
+        Memhook mh;
+        Tree joined = Tree::join(std::move(a), std::move(b));
+        ASSERT_EQ(0ULL, mh.n_allocs());
+        check_contents(joined, expected, static_cast<size_t>(2 * std::log2(expected.size() + 2)) + 1, utest_result);
+    }
+}
+
+// A tree emptied by split or join keeps nothing of the nodes it handed
+// over: appending to it afterwards builds a tree of its own and leaves
+// the trees that took the nodes alone
+template<typename Tree>
+void check_emptied_tree_appends(int * utest_result) {
+    for(int key : { -1, 2, 5 }) {
+        Tree tree;
+        for(int j = 0; j < 5; j++)
+            tree.append_max({ j, j });
+
+        auto [below, above] = tree.split(key);
+        size_t n_below = below.size(), n_above = above.size();
+        tree.append_max({ 100, 0 });
+        ASSERT_EQ(1ULL, tree.size());
+        ASSERT_TRUE(tree.contains(100));
+        ASSERT_EQ(100, tree.max().first);
+        ASSERT_EQ(n_below, below.size());
+        ASSERT_EQ(n_above, above.size());
+        ASSERT_FALSE(below.contains(100));
+        ASSERT_FALSE(above.contains(100));
+
+        Tree left, right;
+        for(int j = 0; j < 5; j++) {
+            left.append_max({ j, j });
+            right.append_max({ j + 5, j });
+        }
+        Tree joined = Tree::join(std::move(left), std::move(right));
+        left.append_max({ 100, 0 });
+        right.append_max({ 200, 0 });
+        ASSERT_EQ(1ULL, left.size());
+        ASSERT_EQ(1ULL, right.size());
+        ASSERT_TRUE(left.contains(100));
+        ASSERT_TRUE(right.contains(200));
+        ASSERT_EQ(10ULL, joined.size());
+        ASSERT_FALSE(joined.contains(100));
+        ASSERT_FALSE(joined.contains(200));
+        ASSERT_EQ(9, joined.max().first);
+    }
+}
+
+TEST(split_and_join_leave_emptied_trees_usable) {
+    check_emptied_tree_appends<BinarySearchTree<int, int>>(utest_result);
+    check_emptied_tree_appends<BinarySearchTree<int, int, std::less<int>, balance::red_black>>(utest_result);
+    check_emptied_tree_appends<BinarySearchTree<int, int, std::less<int>, balance::avl>>(utest_result);
+    check_emptied_tree_appends<BinarySearchTree<int, int, std::less<int>, balance::treap>>(utest_result);
+    check_emptied_tree_appends<BinarySearchTree<int, int, std::less<int>, balance::splay>>(utest_result);
+    check_emptied_tree_appends<BinarySearchTree<int, int, std::less<int>, balance::scapegoat>>(utest_result);
+    check_emptied_tree_appends<RankedTree<balance::red_black>>(utest_result);
+}
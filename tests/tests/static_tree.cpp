@@ -0,0 +1,99 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <set>
+
+using isa = instruction_set;
+
+static_assert(StaticSearchTree<int, int>::B == 16, "a block holds 16 32-bit keys");
+static_assert(StaticSearchTree<uint64_t, int>::B == 8, "a block holds 8 64-bit keys");
+
+// Build both trees from the same keys, then check every compare kernel
+// this CPU supports against the live tree for hits, misses and the
+// extremes of the key type
+template<typename K>
+void check_static_tree(Typegen & t, size_t sz, int * utest_result) {
+    using limits = std::numeric_limits<K>;
+
+    // Store the extremes half the time so they are also probed as misses
+    std::set<K> keys;
+    if(t.get<bool>())
+        keys = { limits::min(), limits::max() };
+    while(keys.size() < sz)
+        keys.insert(t.get<K>());
+
+    BinarySearchTree<K, int> bst;
+    for(K key : keys)
+        bst.insert({ key, t.get<int>() });
+    auto fast = bst.template freeze<StaticSearchTree<K, int>>();
+
+    ASSERT_EQ(bst.size(), fast.size());
+    ASSERT_EQ(bst.min().first, fast.min().first);
+    ASSERT_EQ(bst.max().first, fast.max().first);
+
+    std::vector<K> probes(keys.begin(), keys.end());
+    for(K key : keys) {
+        if(key != limits::min()) probes.push_back(key - 1);
+        if(key != limits::max()) probes.push_back(key + 1);
+    }
+    probes.push_back(limits::min());
+    probes.push_back(limits::max());
+    probes.push_back(0);
+
+    for(isa level : { isa::portable, isa::sse4_2, isa::avx2 }) {
+        if(!fast.select(level))
+            continue;
+        ASSERT_TRUE(fast.isa() == level);
+
+        for(K key : probes) {
+            bool present = keys.count(key) == 1;
+            ASSERT_EQ(present, fast.contains(key));
+            if(present)
+                ASSERT_EQ(bst.find(key), fast.find(key));
+        }
+    }
+}
+
+TEST(static_tree_int) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++)
+        check_static_tree<int>(t, t.range<size_t>(1, 3000), utest_result);
+}
+
+TEST(static_tree_uint64) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++)
+        check_static_tree<uint64_t>(t, t.range<size_t>(1, 3000), utest_result);
+}
+
+TEST(static_tree_small_and_empty) {
+    BinarySearchTree<int, int> bst;
+    auto empty = bst.freeze<StaticSearchTree<int, int>>();
+    ASSERT_TRUE(empty.empty());
+    ASSERT_FALSE(empty.contains(0));
+    ASSERT_FALSE(empty.contains(std::numeric_limits<int>::max()));
+
+    // Every size around a block boundary, so padding slots are exercised
+    for(int n = 1; n <= 40; n++) {
+        bst.insert({ 2 * n, n });
+        auto fast = bst.freeze<StaticSearchTree<int, int>>();
+        ASSERT_EQ(static_cast<size_t>(n), fast.size());
+        ASSERT_EQ(2, fast.min().first);
+        ASSERT_EQ(2 * n, fast.max().first);
+        for(int key = 0; key <= 2 * n + 1; key++) {
+            ASSERT_EQ(key % 2 == 0 && key > 0, fast.contains(key));
+            if(key % 2 == 0 && key > 0)
+                ASSERT_EQ(key / 2, fast.find(key));
+        }
+    }
+}
+
+TEST(static_tree_detects_cpu) {
+    ASSERT_TRUE((StaticSearchTree<int, int>::supported(isa::portable)));
+    StaticSearchTree<int, int> fast;
+    ASSERT_TRUE((fast.isa() == StaticSearchTree<int, int>::detect()));
+}
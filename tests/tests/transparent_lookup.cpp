@@ -0,0 +1,108 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Keys past the small-string buffer, so a std::string temporary allocates
+std::string long_key(size_t i) {
+    return "a key long enough to live on the heap #" + std::to_string(i);
+}
+
+// With std::less<> lookups by std::string_view and const char * compare
+// against the stored strings directly, so nothing is allocated
+template<typename Balance>
+void check_transparent(int * utest_result) {
+    BinarySearchTree<std::string, int, std::less<>, Balance> tree;
+    std::vector<std::string> keys;
+    for(size_t i = 0; i < 256; i++) {
+        keys.push_back(long_key(i));
+        tree.insert({ keys.back(), static_cast<int>(i) });
+    }
+    std::string missing = long_key(1000);
+
+    {
+        Memhook mh;
+        auto const & view = tree;
+        for(size_t i = 0; i < keys.size(); i++) {
+            std::string_view sv = keys[i];
+            char const * cs = keys[i].c_str();
+
+            ASSERT_TRUE(tree.contains(sv));
+            ASSERT_TRUE(view.contains(cs));
+            ASSERT_EQ(static_cast<int>(i), tree.find(sv));
+            ASSERT_EQ(static_cast<int>(i), view.find(cs));
+            ASSERT_EQ(static_cast<int>(i), tree.lower_bound(sv)->second);
+            ASSERT_EQ(static_cast<int>(i), view.lower_bound(cs)->second);
+            ASSERT_TRUE(tree.upper_bound(sv) == std::next(tree.lower_bound(sv)));
+
+            auto [first, last] = view.equal_range(sv);
+            ASSERT_EQ(1, std::distance(first, last));
+        }
+        ASSERT_FALSE(tree.contains(std::string_view(missing)));
+        ASSERT_FALSE(view.contains(missing.c_str()));
+        ASSERT_EQ(0ULL, mh.n_allocs());
+    }
+
+    for(size_t i = 0; i < keys.size(); i += 2) {
+        Memhook mh;
+        tree.erase(std::string_view(keys[i]));
+        ASSERT_EQ(0ULL, mh.n_allocs());
+    }
+    ASSERT_EQ(keys.size() / 2, tree.size());
+    for(size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(i % 2 == 1, tree.contains(keys[i].c_str()));
+}
+
+TEST(transparent_lookup_does_not_allocate) {
+    check_transparent<balance::none>(utest_result);
+    check_transparent<balance::red_black>(utest_result);
+    check_transparent<balance::avl>(utest_result);
+    check_transparent<balance::treap>(utest_result);
+    check_transparent<balance::splay>(utest_result);
+    check_transparent<balance::scapegoat>(utest_result);
+}
+
+// With the default std::less<std::string> the same call converts its
+// argument to a std::string first
+TEST(opaque_comparator_builds_key_temporaries) {
+    BinarySearchTree<std::string, int> tree;
+    std::string key = long_key(0);
+    tree.insert({ key, 0 });
+
+    Memhook mh;
+    ASSERT_TRUE(tree.contains(key.c_str()));
+    ASSERT_EQ(1ULL, mh.n_allocs());
+}
+
+// Any type the comparator orders against the key works, such as an id
+// for keys that are whole records
+struct employee {
+    int id;
+    std::string name;
+};
+
+struct by_id {
+    using is_transparent = void;
+    bool operator()(employee const & a, employee const & b) const { return a.id < b.id; }
+    bool operator()(employee const & a, int b) const { return a.id < b; }
+    bool operator()(int a, employee const & b) const { return a < b.id; }
+};
+
+TEST(transparent_lookup_by_member) {
+    BinarySearchTree<employee, int, by_id, balance::red_black> tree;
+    for(int id = 0; id < 64; id++)
+        tree.insert({ employee { 3 * id, long_key(id) }, id });
+
+    Memhook mh;
+    for(int id = 0; id < 190; id++) {
+        ASSERT_EQ(id % 3 == 0, tree.contains(id));
+        auto lb = tree.lower_bound(id);
+        ASSERT_EQ((id + 2) / 3 * 3, lb->first.id);
+    }
+    ASSERT_EQ(21, tree.find(63));
+    tree.erase(63);
+    ASSERT_FALSE(tree.contains(63));
+    ASSERT_EQ(0ULL, mh.n_allocs());
+}
@@ -0,0 +1,135 @@
+#include "generate_tree_data.h"
+#include "executable.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using Treap = BinarySearchTree<int, int, comparison_tracking_comparitor, balance::treap>;
+
+// The expected depth of a node in a treap is about 2 ln(n), roughly
+// 1.39 log2(n). Leave generous headroom so the bound is not flaky
+// across seeds while still failing for a linear chain.
+double treap_average_find_bound(size_t n) {
+    return 3 * std::log2(n + 1) + 2;
+}
+
+TEST(treap_sorted_input_depth) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(64, 2048);
+
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+        std::sort(pairs.begin(), pairs.end());
+
+        if(t.get<bool>())
+            std::reverse(pairs.begin(), pairs.end());
+
+        Memhook mh;
+        {
+            Treap tree;
+            tree.seed(t.get<uint64_t>());
+
+            for(auto const & pair : pairs) {
+                Memhook mh;
+                tree.insert(pair);
+                ASSERT_EQ(1ULL, mh.n_allocs());
+            }
+
+            ASSERT_EQ(sz, tree.size());
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+
+            size_t & comparisons = comparison_tracking_comparitor::comparisons;
+            size_t total = 0;
+
+            for(auto const & [key, value] : pairs) {
+                comparisons = 0;
+                ASSERT_EQ(value, tree.find(key));
+                total += comparisons;
+            }
+
+            ASSERT_LT(static_cast<double>(total) / sz, treap_average_find_bound(sz));
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(treap_insert_overwrite_and_erase) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(1, 512);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+
+        Memhook mh;
+        {
+            Treap tree;
+
+            for(auto const & pair : pairs)
+                tree.insert(pair);
+
+            // Overwriting an existing key never allocates, even when the
+            // node is relocated to the position of its fresh priority
+            for(auto & [key, value] : pairs) {
+                value = t.get<int>();
+                Memhook mh;
+                tree.insert({ key, value });
+                ASSERT_EQ(0ULL, mh.n_allocs());
+                ASSERT_EQ(0ULL, mh.n_frees());
+            }
+
+            ASSERT_EQ(sz, tree.size());
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+
+            while(!pairs.empty()) {
+                size_t idx = t.range(pairs.size());
+
+                {
+                    Memhook mh;
+                    tree.erase(pairs[idx].first);
+                    ASSERT_EQ(1ULL, mh.n_frees());
+                }
+
+                ASSERT_FALSE(tree.contains(pairs[idx].first));
+                pairs.erase(pairs.begin() + idx);
+                ASSERT_EQ(pairs.size(), tree.size());
+            }
+
+            ASSERT_TREE_PAIRS_CONTAINED_AND_FOUND(pairs, tree);
+        }
+
+        ASSERT_EQ(mh.n_allocs(), mh.n_frees());
+    }
+}
+
+TEST(treap_reproducible_from_seed) {
+    Typegen t;
+
+    for(size_t i = 0; i < TEST_ITER; i++) {
+        size_t sz = t.range<size_t>(64, 256);
+        auto pairs = generate_kv_pairs<int, int>(t, sz, true);
+        uint64_t seed = t.get<uint64_t>();
+
+        BinarySearchTree<int, int, std::less<int>, balance::treap> a, b, c;
+        a.seed(seed);
+        b.seed(seed);
+        c.seed(seed + 1);
+
+        for(auto const & pair : pairs) {
+            a.insert(pair);
+            b.insert(pair);
+            c.insert(pair);
+        }
+
+        std::stringstream sa, sb, sc;
+        // printTree indents each node by its depth so equal output means
+        // equal shape
+        printTree(a, sa);
+        printTree(b, sb);
+        printTree(c, sc);
+
+        ASSERT_TRUE(sa.str() == sb.str());
+        ASSERT_FALSE(sa.str() == sc.str());
+    }
+}